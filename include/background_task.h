@@ -0,0 +1,49 @@
+/* Background task declarations for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __BACKGROUND_TASK_H__
+#define __BACKGROUND_TASK_H__
+
+#include <cstdint>
+#include <Arduino.h>
+
+// Only relies on FreeRTOS, so it is built and tested on the host too, over
+// threads (test/test_wake_pipeline).
+
+/*
+ * Work run once on the core that is not running setup().
+ *
+ * What the work uses belongs to the task from startBackgroundTask() until
+ * awaitBackgroundTask() returns, even once the work is done. Until then only
+ * the task itself may touch it, see backgroundTaskHandedBack().
+ */
+typedef struct background_task
+{
+  void (*run)(void *arg);
+  void *arg;
+  SemaphoreHandle_t done;
+  TaskHandle_t handle;  // NULL unless started and not yet awaited
+  int64_t runUs;        // how long run took, once awaited
+} background_task_t;
+
+bool startBackgroundTask(background_task_t &task, void (*run)(void *arg),
+                         void *arg, const char *name, uint32_t stackSize);
+int64_t awaitBackgroundTask(background_task_t &task);
+bool backgroundTaskPending(const background_task_t &task);
+bool backgroundTaskHandedBack(const background_task_t &task);
+
+#endif
@@ -46,6 +46,15 @@ bool printLocalTime(tm *timeInfo);
 #else
   int getDomoticzcall_GRAPH(WiFiClientSecure &client, requested_data_t &r);
 #endif
+#ifdef USE_HTTP
+  int getDomoticzcalls(WiFiClient &client, requested_data_t &r);
+#else
+  int getDomoticzcalls(WiFiClientSecure &client, requested_data_t &r);
+#endif
+int getApiData(requested_data_t &r, int status[API_ENDPOINT_COUNT]);
+#if DOWNLOAD_THEN_PARSE
+int parseApiData(requested_data_t &r, int status[API_ENDPOINT_COUNT]);
+#endif
 
 #endif
 
@@ -0,0 +1,54 @@
+/* Clock model declarations for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __CLOCK_MODEL_H__
+#define __CLOCK_MODEL_H__
+
+#include <cstdint>
+
+// The clock model and date parsing do not depend on the hardware, so they are
+// built and tested on the host too (test/test_clock_model).
+
+/*
+ * Model of the drift of the esp32's RTC, learned from successive NTP
+ * synchronizations. Kept in RTC memory across deep sleep.
+ *
+ * All times are in microseconds since the Unix epoch. Drift is positive when
+ * the RTC gains time.
+ */
+typedef struct clock_model
+{
+  uint32_t magic;          // CLOCK_MODEL_MAGIC once synchronized
+  int64_t  syncUs;         // true time of the last NTP synchronization
+  int64_t  correctionUs;   // correction applied to the clock since syncUs
+  float    driftPpm;       // learned drift rate
+  float    driftErrorPpm;  // mean error of the learned drift rate
+  uint16_t samples;        // number of drift measurements
+  uint16_t wakesSinceSync;
+} clock_model_t;
+
+void clockModelReset(clock_model_t &m);
+bool clockModelValid(const clock_model_t &m);
+float clockModelDriftPpm(const clock_model_t &m);
+int64_t clockModelCorrectionUs(const clock_model_t &m, int64_t clockUs);
+int64_t clockModelPredictedErrorUs(const clock_model_t &m, int64_t clockUs);
+bool clockModelNeedsSync(const clock_model_t &m, int64_t clockUs,
+                         int syncInterval, int64_t maxErrorUs);
+void clockModelSynced(clock_model_t &m, int64_t clockUs, int64_t trueUs);
+bool parseHttpDate(const char *date, int64_t &epochS);
+
+#endif
@@ -227,6 +227,162 @@
 //   If you wish to disable battery monitoring set this macro to 0.
 #define BATTERY_MONITORING 1
 
+// PIPELINED WAKE
+//   If set to 1, the e-paper panel is powered on and initialized on the second
+//   core while WiFi associates and the API requests are in flight. When the
+//   selected panel buffers the whole frame in a single page, the static layout
+//   (boxes, fixed labels and icons) is drawn there as well. With
+//   DIRECT_PAGE_BUFFER, it is recorded there whatever the panel.
+//   With SKIP_UNCHANGED_REFRESH, the panel is only powered on once the content
+//   is known to have changed, and initialized on the second core while the
+//   frame is recorded instead (see SKIP UNCHANGED REFRESH).
+//   Set to 0 to initialize the display only once all data has been fetched.
+#define PIPELINED_DISPLAY_INIT 1
+
+// WIFI FAST RECONNECT
+//   If set to 1, the access point (BSSID), channel and DHCP lease of the last
+//   successful connection are kept in RTC memory. Following wakes reconnect
+//   directly with a static configuration, skipping the channel scan and DHCP,
+//   and fall back to a full connection if that fails within WIFI_FAST_TIMEOUT.
+//   The lease is renewed with a full connection once it is WIFI_CACHE_MAX_AGE
+//   old.
+#define WIFI_FAST_RECONNECT 1
+
+// CONCURRENT FETCH
+//   If set to 1, the Open-Meteo and Domoticz requests are all kept in flight at
+//   once, each from its own task and socket, so the total network time is
+//   about that of the slowest endpoint rather than the sum of all of them.
+//   This needs more heap while fetching (one HTTP client and JSON document per
+//   request, and one TLS session per request when using HTTPS).
+//   With DEBUG_LEVEL >= 1 the time of each request and of all of them is
+//   printed, the same way for 0 and 1, so both can be compared, e.g. against
+//   tools/mock_api_server.py, which serves each endpoint with a set latency.
+#define CONCURRENT_FETCH 1
+
+// DOMOTICZ KEEP-ALIVE
+//   If set to 1, both Domoticz requests are sent over a single persistent
+//   HTTP/1.1 connection, instead of one HTTP/1.0 connection per request.
+//   These requests are written and their responses read without HTTPClient,
+//   so they can accept gzip encoded responses too (see HTTP GZIP).
+#define DOMOTICZ_KEEP_ALIVE 1
+
+// API RESPONSE CACHE
+//   If set to 1, the values decoded from the Open-Meteo forecast and the
+//   Domoticz graph are kept in RTC memory. The requests are made conditional
+//   on the validators (ETag, Last-Modified) of the last response, and a body
+//   identical to the last one is recognized by its hash, so an unchanged
+//   response is not deserialized again.
+#define API_RESPONSE_CACHE 1
+
+// SKIP UNCHANGED REFRESH
+//   If set to 1, a digest of the content drawn on the panel is kept in RTC
+//   memory, and the panel is not refreshed when the content is unchanged. The
+//   refresh time in the status bar is not part of the content, so it then
+//   shows the time of the last actual refresh.
+//   The panel is only powered on once the digests show the content changed, so
+//   a wake without refresh never powers it. The initialization of the panel
+//   then only overlaps with the recording of the frame, not with WiFi and the
+//   API requests (see PIPELINED WAKE).
+#define SKIP_UNCHANGED_REFRESH 1
+
+// PARTIAL REFRESH
+//   If set to 1, only the regions of the dashboard whose content changed are
+//   sent to the panel and refreshed, through a partial window enclosing them,
+//   with a full refresh every FULL_REFRESH_INTERVAL refreshes. Panels that do
+//   not support partial refresh always get a full refresh, and so do panels
+//   with fast partial update (DISP_BW_V2): their differential update needs the
+//   previous frame in the controller, which is lost when the panel is powered
+//   off between wakes.
+//   Requires SKIP_UNCHANGED_REFRESH.
+#define PARTIAL_REFRESH 1
+
+// JSON FILTERS
+//   If set to 1, the API responses are deserialized through ArduinoJson
+//   filters, so only the fields that are read are stored. Set to 0 to compare
+//   the parse time and peak JSON memory use reported with DEBUG_LEVEL >= 1.
+//   May also be set from build_flags, the host tests are run both ways (see
+//   [env:native_unfiltered] in platformio.ini).
+#ifndef JSON_FILTERS
+  #define JSON_FILTERS 1
+#endif
+
+// HTTP GZIP
+//   If set to 1, every request accepts gzip encoded responses, which are
+//   inflated as they are parsed. Fewer bytes are received, so the radio is on
+//   for less time. A 32 KiB window and about 11 KiB of inflater state are taken
+//   from the heap while a gzip encoded response is parsed, and only then.
+#define HTTP_GZIP 1
+
+// METEO CSV
+//   If set to 1, the Open-Meteo forecast is requested as CSV, which is a
+//   fraction of the size of the JSON response and is decoded line by line.
+//   If the CSV response is rejected or cannot be decoded, the request falls
+//   back to JSON.
+#define METEO_CSV 1
+
+// DOWNLOAD THEN PARSE
+//   If set to 1, every response body is first read whole into memory, WiFi is
+//   turned off, and only then are the bodies decoded, so the radio is not kept
+//   on while the CPU parses. The time WiFi was on is printed with
+//   DEBUG_LEVEL >= 1. Until they are decoded, the bodies are held in one
+//   statically reserved buffer per endpoint (see RESPONSE_BUFFER_SIZE), 36 KiB
+//   in all instead of the 24 KiB the response cache needs alone.
+//   A CSV forecast that cannot be decoded can then no longer fall back to
+//   JSON (see METEO CSV); a request rejected by the server still does.
+//   Off by default, as decoding while reading keeps the radio on for little
+//   longer: the decoders take 39 us for the month graph and 18 us for the CSV
+//   forecast on a desktop CPU (test/test_graph_decode, test/test_meteo_decode),
+//   likely a few milliseconds on the esp32, against the hundreds of
+//   milliseconds WiFi is on per wake. With CONCURRENT_FETCH, a response is
+//   also decoded while the others are still in flight, at no radio cost.
+#define DOWNLOAD_THEN_PARSE 0
+
+// STALE DATA FALLBACK
+//   If set to 1, the data last received from each endpoint is kept in RTC
+//   memory. When a request fails, that data is drawn instead of the error
+//   screen, with a "stale" notice in the status bar, as long as it is no older
+//   than STALE_DATA_MAX_AGE (see config.cpp). The response cache keeps its
+//   decoded values there too, whatever this is set to.
+#define STALE_DATA_FALLBACK 1
+
+// DIRECT PAGE BUFFER
+//   If set to 1, pages are drawn in a buffer of our own and GxEPD2 only drives
+//   the panel, so shaded areas and rectangles are filled a byte at a time
+//   rather than a pixel at a time. The buffer takes the place of GxEPD2's.
+//   Not supported by the 7-color panel (DISP_7C_F).
+#define DIRECT_PAGE_BUFFER 1
+
+// JSON ARENA SIZE
+//   Size in bytes of the statically reserved memory the API responses are
+//   deserialized into. It is reused for each response, so JSON documents never
+//   allocate from the heap. A response that does not fit fails with NoMemory;
+//   the peak use is printed with DEBUG_LEVEL >= 1.
+//   Without JSON_FILTERS, every field of every Domoticz device is stored, over
+//   1 KB per device, so the arena is then sized for the unfiltered documents.
+#if JSON_FILTERS
+  #define JSON_ARENA_SIZE 16384
+#else
+  #define JSON_ARENA_SIZE 32768
+#endif
+
+// RESPONSE BUFFER SIZE
+//   Size in bytes of the statically reserved buffer a response body is read
+//   into when it has to be held whole before it is decoded: by the response
+//   cache, to recognize an unchanged body, and by DOWNLOAD_THEN_PARSE. There is
+//   one per endpoint that needs it, so the heap is never used. The buffers hold
+//   the body as received, i.e. still compressed with HTTP_GZIP. A body that
+//   does not fit fails with NoMemory. The largest is the Domoticz month graph,
+//   about 9.5 KB uncompressed.
+#define RESPONSE_BUFFER_SIZE 12288
+
+// WAKE PROFILER
+//   If set to 1, the duration of each phase of a wake (battery, NVS, WiFi,
+//   SNTP, each request and its parsing, each rendered page, panel refresh and
+//   sleep entry) is recorded in RTC memory, for the last few wakes. The record
+//   survives a reset, and is printed to the serial monitor as a Chrome trace
+//   (JSON) when the esp32 boots from one, e.g. when the reset button is pressed.
+#define WAKE_PROFILER 1
+
 // NON-VOLATILE STORAGE (NVS) NAMESPACE
 #define NVS_NAMESPACE "weather_epd"
 
@@ -250,6 +406,8 @@ extern const uint8_t PIN_EPD_PWR;
 extern const char *WIFI_SSID;
 extern const char *WIFI_PASSWORD;
 extern const unsigned long WIFI_TIMEOUT;
+extern const unsigned long WIFI_FAST_TIMEOUT;
+extern const unsigned long WIFI_CACHE_MAX_AGE;
 extern const unsigned HTTP_CLIENT_TCP_TIMEOUT;
 extern const String APIKEY;
 extern const String METEO_API_ENDPOINT;
@@ -266,9 +424,13 @@ extern const char *REFRESH_TIME_FORMAT;
 extern const char *NTP_SERVER_1;
 extern const char *NTP_SERVER_2;
 extern const unsigned long NTP_TIMEOUT;
+extern const int NTP_SYNC_INTERVAL;
+extern const unsigned long NTP_MAX_PREDICTED_ERROR;
 extern const int SLEEP_DURATION;
 extern const int BED_TIME;
 extern const int WAKE_TIME;
+extern const int FULL_REFRESH_INTERVAL;
+extern const int STALE_DATA_MAX_AGE;
 extern const int HOURLY_GRAPH_MAX;
 extern const int DAILY_GRAPH_MAX;
 extern const uint32_t WARN_BATTERY_VOLTAGE;
@@ -357,6 +519,60 @@ extern const uint32_t MIN_BATTERY_VOLTAGE;
 #if !(defined(BATTERY_MONITORING))
   #error Invalid configuration. BATTERY_MONITORING not defined.
 #endif
+#if !(defined(PIPELINED_DISPLAY_INIT))
+  #error Invalid configuration. PIPELINED_DISPLAY_INIT not defined.
+#endif
+#if !(defined(CONCURRENT_FETCH))
+  #error Invalid configuration. CONCURRENT_FETCH not defined.
+#endif
+#if !(defined(DOMOTICZ_KEEP_ALIVE))
+  #error Invalid configuration. DOMOTICZ_KEEP_ALIVE not defined.
+#endif
+#if !(defined(WIFI_FAST_RECONNECT))
+  #error Invalid configuration. WIFI_FAST_RECONNECT not defined.
+#endif
+#if !(defined(API_RESPONSE_CACHE))
+  #error Invalid configuration. API_RESPONSE_CACHE not defined.
+#endif
+#if !(defined(SKIP_UNCHANGED_REFRESH))
+  #error Invalid configuration. SKIP_UNCHANGED_REFRESH not defined.
+#endif
+#if !(defined(PARTIAL_REFRESH))
+  #error Invalid configuration. PARTIAL_REFRESH not defined.
+#endif
+#if PARTIAL_REFRESH && !SKIP_UNCHANGED_REFRESH
+  #error Invalid configuration. PARTIAL_REFRESH requires SKIP_UNCHANGED_REFRESH.
+#endif
+#if !(defined(JSON_FILTERS))
+  #error Invalid configuration. JSON_FILTERS not defined.
+#endif
+#if !(defined(HTTP_GZIP))
+  #error Invalid configuration. HTTP_GZIP not defined.
+#endif
+#if !(defined(METEO_CSV))
+  #error Invalid configuration. METEO_CSV not defined.
+#endif
+#if !(defined(DOWNLOAD_THEN_PARSE))
+  #error Invalid configuration. DOWNLOAD_THEN_PARSE not defined.
+#endif
+#if !(defined(STALE_DATA_FALLBACK))
+  #error Invalid configuration. STALE_DATA_FALLBACK not defined.
+#endif
+#if !(defined(DIRECT_PAGE_BUFFER))
+  #error Invalid configuration. DIRECT_PAGE_BUFFER not defined.
+#endif
+#if DIRECT_PAGE_BUFFER && defined(DISP_7C_F)
+  #error Invalid configuration. DIRECT_PAGE_BUFFER is not supported by DISP_7C_F.
+#endif
+#if !(defined(JSON_ARENA_SIZE))
+  #error Invalid configuration. JSON_ARENA_SIZE not defined.
+#endif
+#if !(defined(RESPONSE_BUFFER_SIZE))
+  #error Invalid configuration. RESPONSE_BUFFER_SIZE not defined.
+#endif
+#if !(defined(WAKE_PROFILER))
+  #error Invalid configuration. WAKE_PROFILER not defined.
+#endif
 #if !(defined(DEBUG_LEVEL))
   #error Invalid configuration. DEBUG_LEVEL not defined.
 #endif
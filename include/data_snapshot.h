@@ -0,0 +1,39 @@
+/* Decoded data snapshot declarations for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DATA_SNAPSHOT_H__
+#define __DATA_SNAPSHOT_H__
+
+#include <time.h>
+#include "api_data.h"
+
+/*
+ * The values last decoded from each API endpoint are kept in RTC memory, in a
+ * compact binary encoding with a version and a CRC, along with the time they
+ * were received. They survive deep sleep, but not a reset.
+ *
+ * The encoding itself is in snapshot_codec.h.
+ */
+void saveSnapshot(api_endpoint_t endpoint, const requested_data_t &r,
+                  time_t fetched);
+bool loadSnapshot(api_endpoint_t endpoint, requested_data_t &r,
+                  time_t *fetched);
+
+extern const char *API_ENDPOINT_NAMES[API_ENDPOINT_COUNT];
+
+#endif
+
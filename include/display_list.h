@@ -0,0 +1,202 @@
+/* Display list declarations for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DISPLAY_LIST_H__
+#define __DISPLAY_LIST_H__
+
+#include <vector>
+#include <Arduino.h>
+#include <Adafruit_GFX.h>
+
+typedef enum dl_command_type
+{
+  DL_PIXEL,
+  DL_HLINE,
+  DL_VLINE,
+  DL_LINE,             // arg: x0, y0, x1, y1
+  DL_FILL_RECT,
+  DL_ROUND_RECT,       // arg: radius
+  DL_FILL_ROUND_RECT,  // arg: radius
+  DL_INVERTED_BITMAP,  // data: bitmap
+  DL_ALPHA_BAR,
+  DL_DOTTED_HLINE,     // arg: step
+  DL_TEXT              // arg: cursor x, y, text offset, length; data: font
+} dl_command_type_t;
+
+/*
+ * A recorded drawing command. Most commands are fully described by their
+ * bounding box, the others keep what they need in arg and data.
+ */
+typedef struct dl_command
+{
+  uint8_t     type;           // dl_command_type_t
+  uint16_t    color;
+  int16_t     x0, y0, x1, y1; // bounding box, x1 and y1 excluded
+  int16_t     arg[4];
+  const void *data;
+} dl_command_t;
+
+/*
+ * Records what is drawn on it instead of rasterizing it, so a frame can be
+ * composed once and then replayed on each page of a paged display, skipping
+ * the commands that fall outside of the page.
+ *
+ * Text is recorded one run at a time, with the font, color and cursor it was
+ * written with. The cursor advances as it would on the display, so text can be
+ * measured and aligned on the recorder as usual. Text size must be 1.
+ * Rectangles and lines with a width or height of 0 or less are not recorded.
+ */
+class DisplayList : public Adafruit_GFX
+{
+public:
+  DisplayList(int16_t w, int16_t h);
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override;
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override;
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override;
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                uint16_t color) override;
+  void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                uint16_t color) override;
+  void drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r,
+                     uint16_t color);
+  void fillRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r,
+                     uint16_t color);
+  // bitmap must outlive the record, as it is not copied
+  void drawInvertedBitmap(int16_t x, int16_t y, const uint8_t bitmap[],
+                          int16_t w, int16_t h, uint16_t color);
+  void drawAlphaBar(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                    uint16_t color);
+  // One pixel every step pixels, from x0 to x1 included.
+  void drawDottedHLine(int16_t x0, int16_t x1, int16_t y, int16_t step,
+                       uint16_t color);
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+  using Print::write;
+  // The font text is written with, NULL for the built-in font.
+  const GFXfont *getFont() const;
+
+  void clear();
+  size_t size() const;
+  const dl_command_t &operator[](size_t i) const;
+  const char *text(const dl_command_t &command) const;
+
+private:
+  dl_command_t &add(dl_command_type_t type, uint16_t color,
+                    int16_t x0, int16_t y0, int16_t x1, int16_t y1);
+
+  std::vector<dl_command_t> _commands;
+  std::vector<char> _text;
+};
+
+// The record is replayed on any GFX that draws what DisplayList records: the
+// display, the page buffer, or the frame of test/test_display_list.
+
+/* Draws a recorded alpha bar a pixel at a time.
+ */
+template <typename GFX>
+void replayAlphaBar(GFX &gfx, const dl_command_t &c)
+{
+  for (int y = c.y1 - 1; y >= c.y0; y -= 2)
+  {
+    for (int x = c.x0; x < c.x1; x += 2)
+    {
+      gfx.drawPixel(x, y, c.color);
+    }
+  }
+  return;
+} // end replayAlphaBar
+
+/* Draws a command recorded on list on gfx, the display or the page buffer.
+ */
+template <typename GFX>
+void replayCommand(GFX &gfx, const DisplayList &list, const dl_command_t &c)
+{
+  switch (c.type)
+  {
+    case DL_PIXEL:
+      gfx.drawPixel(c.x0, c.y0, c.color);
+      break;
+    case DL_HLINE:
+      gfx.drawFastHLine(c.x0, c.y0, c.x1 - c.x0, c.color);
+      break;
+    case DL_VLINE:
+      gfx.drawFastVLine(c.x0, c.y0, c.y1 - c.y0, c.color);
+      break;
+    case DL_LINE:
+      gfx.drawLine(c.arg[0], c.arg[1], c.arg[2], c.arg[3], c.color);
+      break;
+    case DL_FILL_RECT:
+      gfx.fillRect(c.x0, c.y0, c.x1 - c.x0, c.y1 - c.y0, c.color);
+      break;
+    case DL_ROUND_RECT:
+      gfx.drawRoundRect(c.x0, c.y0, c.x1 - c.x0, c.y1 - c.y0, c.arg[0],
+                        c.color);
+      break;
+    case DL_FILL_ROUND_RECT:
+      gfx.fillRoundRect(c.x0, c.y0, c.x1 - c.x0, c.y1 - c.y0, c.arg[0],
+                        c.color);
+      break;
+    case DL_INVERTED_BITMAP:
+      gfx.drawInvertedBitmap(c.x0, c.y0,
+                             static_cast<const uint8_t *>(c.data),
+                             c.x1 - c.x0, c.y1 - c.y0, c.color);
+      break;
+    case DL_ALPHA_BAR:
+      replayAlphaBar(gfx, c);
+      break;
+    case DL_DOTTED_HLINE:
+      for (int x = c.x0; x < c.x1; x += c.arg[0])
+      {
+        gfx.drawPixel(x, c.y0, c.color);
+      }
+      break;
+    case DL_TEXT:
+      gfx.setFont(static_cast<const GFXfont *>(c.data));
+      gfx.setTextColor(c.color);
+      gfx.setCursor(c.arg[0], c.arg[1]);
+      // Adafruit_GFX hides the buffered overload of Print::write()
+      static_cast<Print &>(gfx).write(
+        reinterpret_cast<const uint8_t *>(list.text(c)),
+        static_cast<uint16_t>(c.arg[3]));
+      break;
+  }
+  return;
+} // end replayCommand
+
+/* Draws the commands recorded on list that intersect x0 <= x < x1,
+ * y0 <= y < y1 on gfx. Returns the number of commands drawn.
+ */
+template <typename GFX>
+size_t replayPage(GFX &gfx, const DisplayList &list,
+                  int16_t x0, int16_t y0, int16_t x1, int16_t y1)
+{
+  size_t drawn = 0;
+  for (size_t i = 0; i < list.size(); ++i)
+  {
+    const dl_command_t &c = list[i];
+    if (c.x1 <= x0 || c.x0 >= x1 || c.y1 <= y0 || c.y0 >= y1)
+    {
+      continue;
+    }
+    replayCommand(gfx, list, c);
+    ++drawn;
+  }
+  return drawn;
+} // end replayPage
+
+#endif
@@ -0,0 +1,154 @@
+/* Fixed-capacity string for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __FIXED_STRING_H__
+#define __FIXED_STRING_H__
+
+#include <cstdarg>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+/*
+ * String stored inline, in a buffer of N bytes including the terminating null,
+ * so it never allocates. Text that does not fit is truncated, without cutting
+ * a UTF-8 sequence in two.
+ *
+ * Being trivially copyable, structures holding FixedStrings can be copied as
+ * plain memory.
+ */
+template <size_t N>
+class FixedString
+{
+public:
+  FixedString()
+  {
+    clear();
+  }
+
+  FixedString(const char *s)
+  {
+    assign(s);
+  }
+
+  FixedString &operator=(const char *s)
+  {
+    assign(s);
+    return *this;
+  }
+
+  // s may be NULL, which is stored as ""
+  void assign(const char *s)
+  {
+    assign(s, s == NULL ? 0 : strlen(s));
+  }
+
+  void assign(const char *s, size_t len)
+  {
+    _len = fit(s, len);
+    memmove(_buf, s, _len);
+    _buf[_len] = '\0';
+  }
+
+  // printf-style assignment, truncated like assign()
+  void format(const char *fmt, ...) __attribute__((format(printf, 2, 3)))
+  {
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(_buf, N, fmt, args);
+    va_end(args);
+    _len = len < 0 ? 0 : fit(_buf, static_cast<size_t>(len));
+    _buf[_len] = '\0';
+  }
+
+  void clear()
+  {
+    _len = 0;
+    _buf[0] = '\0';
+  }
+
+  // Removes count characters from index, like String::remove().
+  void remove(size_t index, size_t count)
+  {
+    if (index >= _len)
+    {
+      return;
+    }
+    if (count > _len - index)
+    {
+      count = _len - index;
+    }
+    memmove(_buf + index, _buf + index + count, _len - index - count + 1);
+    _len -= count;
+  }
+
+  bool startsWith(const char *prefix) const
+  {
+    return strncmp(_buf, prefix, strlen(prefix)) == 0;
+  }
+
+  const char *c_str() const
+  {
+    return _buf;
+  }
+
+  size_t length() const
+  {
+    return _len;
+  }
+
+  bool isEmpty() const
+  {
+    return _len == 0;
+  }
+
+  static constexpr size_t capacity()
+  {
+    return N - 1;
+  }
+
+private:
+  // Returns how many of the len bytes of s fit, dropping a UTF-8 sequence
+  // that would be cut.
+  static size_t fit(const char *s, size_t len)
+  {
+    if (len <= N - 1)
+    {
+      return len;
+    }
+    len = N - 1;
+    size_t lead = len;
+    while (lead > 0 && (static_cast<unsigned char>(s[lead - 1]) & 0xC0) == 0x80)
+    {
+      --lead;
+    }
+    if (lead == 0)
+    {
+      return len;
+    }
+    --lead;
+    unsigned char c = s[lead];
+    size_t seqLen = c >= 0xF0 ? 4 : c >= 0xE0 ? 3 : c >= 0xC0 ? 2 : 1;
+    return len - lead < seqLen ? lead : len;
+  }
+
+  char _buf[N];
+  size_t _len;
+};
+
+#endif
+
@@ -0,0 +1,189 @@
+/* HTTP body stream declarations for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __HTTP_STREAM_H__
+#define __HTTP_STREAM_H__
+
+#include <Arduino.h>
+#include <HTTPClient.h>
+#include <ArduinoJson.h>
+#include "api_response.h"
+#include "config.h"
+#if HTTP_GZIP
+  #include <esp32/rom/miniz.h>
+#endif
+
+/*
+ * Reads exactly one HTTP/1.1 response body from the connection stream, so a
+ * parser can read from it directly and the connection can be reused for the
+ * next request afterwards.
+ *
+ * The body is delimited either by "Transfer-Encoding: chunked", which is
+ * decoded on the fly, or by its Content-Length.
+ */
+class HttpBodyStream : public Stream
+{
+public:
+  // contentLength is ignored for chunked bodies, -1 if unknown
+  HttpBodyStream(Stream &src, bool chunked, int contentLength);
+
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t readBytes(char *buffer, size_t length) override;
+  size_t write(uint8_t) override;
+
+  // Consumes what is left of the body, including the chunked trailer.
+  // Returns true if the whole body was received and the framing was valid.
+  bool finish();
+  bool failed() const;
+
+private:
+  int srcRead();
+  int readLine(char *buf, size_t size);
+  bool beginChunk();
+  int nextByte();
+
+  Stream &_src;
+  bool _chunked;
+  int32_t _remaining; // bytes left in the current chunk or body, -1 unknown
+  int _peeked;
+  bool _eof;
+  bool _error;
+};
+
+/*
+ * Stream over a response body buffered in memory, so it can be inspected
+ * before it is parsed. Bytes written are appended, bytes read are consumed
+ * from the start.
+ *
+ * The memory is a fixed buffer given by the caller, statically reserved (see
+ * RESPONSE_BUFFER_SIZE), so buffering a body never allocates from the heap.
+ * Bytes that do not fit are dropped, and overflowed() is then true.
+ */
+class MemoryStream : public Stream
+{
+public:
+  MemoryStream();
+  MemoryStream(uint8_t *buf, size_t capacity);
+
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t readBytes(char *buffer, size_t length) override;
+  size_t write(uint8_t c) override;
+  size_t write(const uint8_t *buffer, size_t size) override;
+
+  void clear(); // empties it
+  void rewind(); // reads again from the start
+  const uint8_t *data() const;
+  size_t size() const;
+  bool overflowed() const;
+
+private:
+  uint8_t *_buf;
+  size_t _capacity;
+  size_t _size;
+  size_t _pos;
+  bool _overflow;
+};
+
+#if HTTP_GZIP
+/*
+ * Inflates a gzip (RFC 1952) body as it is read, with the inflater in the
+ * esp32's ROM. The whole body is never held: only the deflate window (32 KiB,
+ * which gzip requires) and the inflater state, which are allocated while the
+ * stream exists. Constructing a GzipStream waits until no other one exists, so
+ * they are only ever allocated once. If they cannot be, failed() is true.
+ *
+ * read() returns -1 at the end of the compressed data, or on error.
+ */
+class GzipStream : public Stream
+{
+public:
+  explicit GzipStream(Stream &src);
+  ~GzipStream();
+
+  int available() override;
+  int read() override;
+  int peek() override;
+  size_t readBytes(char *buffer, size_t length) override;
+  size_t write(uint8_t) override;
+
+  // True if the body is not valid gzip or is truncated.
+  bool failed() const;
+
+private:
+  GzipStream(const GzipStream &) = delete;
+  GzipStream &operator=(const GzipStream &) = delete;
+
+  int srcRead();
+  bool readHeader();
+  bool readTrailer();
+  bool inflateMore();
+
+  Stream &_src;
+  tinfl_decompressor *_inflator;
+  uint8_t *_window;   // TINFL_LZ_DICT_SIZE bytes, wrapped around
+  size_t _windowPos;  // where the next inflated bytes are written
+  size_t _outPos;     // next inflated byte to read
+  size_t _outEnd;     // end of the inflated bytes not read yet
+  uint32_t _outTotal; // inflated size, modulo 2^32
+  uint8_t _in[256];
+  size_t _inPos;
+  size_t _inLen;
+  bool _started;
+  bool _done;
+  bool _error;
+};
+#endif
+
+/*
+ * Response headers needed to decode a body and to cache it. They are copied
+ * from the HTTPClient, so a buffered body can still be decoded once the
+ * connection is closed.
+ */
+typedef struct response_headers
+{
+  String contentEncoding;
+  String etag;
+  String lastModified;
+} response_headers_t;
+
+/*
+ * Status line and headers of a response read from the connection by
+ * readResponseHead(), for requests written without HTTPClient.
+ */
+typedef struct response_head
+{
+  int status;        // HTTP status code, or an HTTPC_ERROR_* code
+  bool chunked;      // Transfer-Encoding: chunked
+  int contentLength; // -1 if not given
+  bool keepAlive;    // the server leaves the connection open
+  String date;
+  response_headers_t headers;
+} response_head_t;
+
+response_headers_t getResponseHeaders(HTTPClient &http);
+void readResponseHead(Stream &src, response_head_t &head);
+DeserializationError deserializeBody(const response_headers_t &headers,
+  Stream &body,
+  DeserializationError (*deserialize)(Stream &body, requested_data_t &r),
+  requested_data_t &r);
+
+#endif
+
@@ -0,0 +1,76 @@
+/* Streaming JSON pull parser declarations for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __JSON_PULL_H__
+#define __JSON_PULL_H__
+
+#include <cstddef>
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+/*
+ * Pulls the values of a JSON document from a stream one at a time, without
+ * building the document in memory. Memory use does not depend on the size of
+ * the document.
+ *
+ * The caller walks the document it expects, for example:
+ *   beginObject(), then nextKey() until it returns false, reading or skipping
+ *   the value of each key.
+ * Once a call fails, error() holds the reason and every later call fails.
+ */
+class JsonPullParser
+{
+public:
+  explicit JsonPullParser(Stream &in);
+
+  // Returns true if the next value starts with c ('{', '[', '"', ...).
+  bool nextIs(char c);
+  bool beginObject();
+  // Reads the next key of the current object into key, truncated to fit.
+  // Returns false at the end of the object.
+  bool nextKey(char *key, size_t size);
+  bool beginArray();
+  // Returns false at the end of the current array.
+  bool nextElement();
+
+  // Reads a string into buf, truncated to fit. null reads as "".
+  bool readString(char *buf, size_t size);
+  // Reads a number, or a string holding a number. null reads as 0.
+  bool readFloat(float &value);
+  // Skips the next value, including nested objects and arrays.
+  bool skipValue();
+
+  DeserializationError error() const;
+
+private:
+  int peekChar();
+  int readChar();
+  int skipSpace();
+  bool expect(char c);
+  bool fail(DeserializationError::Code code);
+  bool readToken(char *buf, size_t size);
+
+  Stream &_in;
+  char _buf[64];
+  size_t _len;
+  size_t _pos;
+  bool _started;
+  DeserializationError::Code _error;
+};
+
+#endif
+
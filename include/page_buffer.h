@@ -0,0 +1,94 @@
+/* Page buffer declarations for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __PAGE_BUFFER_H__
+#define __PAGE_BUFFER_H__
+
+#include <Arduino.h>
+#include <Adafruit_GFX.h>
+#include "config.h"
+#include "renderer.h"
+
+#if DIRECT_PAGE_BUFFER
+
+#ifdef DISP_3C_B
+  #define PAGE_BUFFER_PLANES 2 // black, then accent color
+  #define PAGE_BUFFER_SIZE   (DISP_WIDTH / 8 * DISP_HEIGHT / 2)
+#else
+  #define PAGE_BUFFER_PLANES 1
+  #define PAGE_BUFFER_SIZE   (DISP_WIDTH / 8 * DISP_HEIGHT)
+#endif
+
+/*
+ * Frame buffer for one page of a window of the display, in the layout of the
+ * panel controller, so pages can be sent to it with epd2.writeImage(). Pages
+ * are bands of panel rows, as many as fit in PAGE_BUFFER_SIZE bytes per plane.
+ *
+ * Each plane holds one bit per pixel, the most significant bit on the left, 1
+ * for white. Rectangles and patterns are filled, and bitmaps copied, a byte at
+ * a time.
+ */
+class PageBuffer : public Adafruit_GFX
+{
+public:
+  PageBuffer();
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override;
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) override;
+  void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color) override;
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                uint16_t color) override;
+  void fillScreen(uint16_t color) override;
+  // Sets the pixels of x, y, w, h whose bit is set in pattern to color.
+  // pattern is 8 rows of 8 pixels, the most significant bit on the left,
+  // tiled from (0, 0).
+  void fillPattern(int16_t x, int16_t y, int16_t w, int16_t h,
+                   const uint8_t pattern[8], uint16_t color);
+  void drawInvertedBitmap(int16_t x, int16_t y, const uint8_t bitmap[],
+                          int16_t w, int16_t h, uint16_t color);
+
+  // Sets the window the pages cover, widened to whole bytes of the panel, and
+  // whether it gets a partial refresh. Returns the number of pages.
+  int setWindow(int16_t x, int16_t y, int16_t w, int16_t h, bool partial);
+  // Selects a page of the window and clears it.
+  void setPage(int page);
+  // Gets the part of the display the selected page covers.
+  void getPageBounds(int16_t &x0, int16_t &y0, int16_t &x1, int16_t &y1) const;
+  // Sends the selected page to the panel controller. again writes it as the
+  // previous content, after a refresh of a panel with fast partial update.
+  void writePage(bool again = false);
+  void refresh();
+
+private:
+  void toPanelRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                   int16_t &px0, int16_t &py0,
+                   int16_t &px1, int16_t &py1) const;
+  void fillPanelRect(int16_t px0, int16_t py0, int16_t px1, int16_t py1,
+                     const uint8_t pattern[8], uint16_t color);
+  void blitPanelRow(int16_t px, int16_t py, const uint8_t *bits, int16_t n,
+                    uint16_t color);
+
+  uint8_t *_planes[PAGE_BUFFER_PLANES];
+  bool     _partial;
+  int16_t  _winX, _winY, _winW, _winH; // panel coordinates, x and w aligned
+  uint16_t _stride;                    // bytes per row
+  int16_t  _pageRows;                  // rows per page
+  int16_t  _row0, _rows;               // the selected page
+};
+
+#endif
+#endif
@@ -0,0 +1,56 @@
+/* Wake profiler declarations for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __PROFILER_H__
+#define __PROFILER_H__
+
+#include <cstdint>
+#include <Arduino.h>
+
+/*
+ * Phases of a wake, as they appear in the trace.
+ */
+typedef enum profile_phase
+{
+  PHASE_BATTERY,
+  PHASE_NVS,
+  PHASE_DISPLAY_INIT,
+  PHASE_WIFI,
+  PHASE_SNTP,
+  PHASE_FETCH_METEO,
+  PHASE_PARSE_METEO,
+  PHASE_FETCH_DOMOTICZ_IDX,
+  PHASE_PARSE_DOMOTICZ_IDX,
+  PHASE_FETCH_DOMOTICZ_GRAPH,
+  PHASE_PARSE_DOMOTICZ_GRAPH,
+  PHASE_RECORD_FRAME,
+  PHASE_RENDER_PAGE,
+  PHASE_PAGE_TRANSFER,
+  PHASE_PANEL_REFRESH,
+  PHASE_SLEEP,
+  PHASE_COUNT
+} profile_phase_t;
+
+void profileWakeBegin();
+void profileWakeEnd();
+int64_t profileStart();
+void profileEnd(profile_phase_t phase, int64_t startUs);
+void profileEvent(profile_phase_t phase, int64_t startUs, int64_t endUs);
+void profileDump(Print &out);
+
+#endif
+
@@ -23,18 +23,27 @@
 #include <time.h>
 #include "api_response.h"
 #include "config.h"
+#include "display_list.h"
+
+// With DIRECT_PAGE_BUFFER, pages are drawn in page_buffer.cpp and GxEPD2 only
+// drives the panel, so its own buffer is kept to a single row.
+#if DIRECT_PAGE_BUFFER
+  #define GXEPD2_PAGE_HEIGHT(h) 1
+#else
+  #define GXEPD2_PAGE_HEIGHT(h) (h)
+#endif
 
 #ifdef DISP_BW_V2
   #define DISP_WIDTH  800
   #define DISP_HEIGHT 480
   #include <GxEPD2_BW.h>
-  extern GxEPD2_BW<GxEPD2_750_T7, GxEPD2_750_T7::HEIGHT> display;
+  extern GxEPD2_BW<GxEPD2_750_T7, GXEPD2_PAGE_HEIGHT(GxEPD2_750_T7::HEIGHT)> display;
 #endif
 #ifdef DISP_3C_B
   #define DISP_WIDTH  800
   #define DISP_HEIGHT 480
   #include <GxEPD2_3C.h>
-  extern GxEPD2_3C<GxEPD2_750c_Z08, GxEPD2_750c_Z08::HEIGHT / 2> display;
+  extern GxEPD2_3C<GxEPD2_750c_Z08, GXEPD2_PAGE_HEIGHT(GxEPD2_750c_Z08::HEIGHT / 2)> display;
 #endif
 #ifdef DISP_7C_F
   #define DISP_WIDTH  800
@@ -46,9 +55,12 @@
   #define DISP_WIDTH  640
   #define DISP_HEIGHT 384
   #include <GxEPD2_BW.h>
-  extern GxEPD2_BW<GxEPD2_750, GxEPD2_750::HEIGHT> display;
+  extern GxEPD2_BW<GxEPD2_750, GXEPD2_PAGE_HEIGHT(GxEPD2_750::HEIGHT)> display;
 #endif
 
+// Everything is drawn on the canvas, then drawn on the display by drawFrame().
+extern DisplayList canvas;
+
 //Define usable zone
 #define X_OFFSET 36
 #define Y_OFFSET 61
@@ -64,20 +76,48 @@ typedef enum alignment
   CENTER
 } alignment_t;
 
+/*
+ * Regions of the dashboard that can be refreshed separately.
+ */
+typedef enum display_region
+{
+  REGION_CURRENT_CONDITIONS,
+  REGION_FORECAST,
+  REGION_DOMOTICZ,
+  REGION_GRAPH,
+  REGION_MEMO,
+  REGION_STATUS_BAR,
+  REGION_COUNT
+} display_region_t;
+
+uint16_t getStringWidth(const char *text);
 uint16_t getStringWidth(const String &text);
 uint16_t getStringHeight(const String &text);
 void drawAlphaBar(int16_t x0_t, int16_t y0_t, int16_t x1_t, int16_t y1_t, uint16_t c);
 void drawBox(int16_t x, int16_t y, int16_t w, int16_t h);
+void drawString(int16_t x, int16_t y, const char *text, alignment_t alignment, uint16_t color=GxEPD_BLACK);
 void drawString(int16_t x, int16_t y, const String &text, alignment_t alignment, uint16_t color=GxEPD_BLACK);
 void drawMultiLnString(int16_t x, int16_t y, const String &text, alignment_t alignment, uint16_t max_width, uint16_t max_lines, int16_t line_spacing, uint16_t color=GxEPD_BLACK);
-void initDisplay();
+void initDisplay(bool initial = true);
 void powerOffDisplay();
+void beginDisplayInit(bool initial = true);
+void beginPanelInit(bool initial = true);
+bool awaitDisplay(bool keepLayout, bool initial = true);
+void drawStaticLayout();
 void drawCurrentConditions(const meteo_current_t &current, const meteo_daily_t &today, float inTemp, float inHumidity, const String &date);
 void drawForecast(const meteo_daily_t *daily, tm timeInfo);
-void drawDomoticz(const domoticz_t *data, String memo);
+void drawDomoticz(const domoticz_t *data, const char *memo);
 void drawOutlookGraph(const meteo_hourly_t *hourly, tm timeInfo);
 void drawConsumptionGraph(const domoticz_graph_t *graph , tm timeInfo);
 void drawStatusBar(const String &statusStr, const String &refreshTimeStr, int rssi, uint32_t batVoltage);
+void getRegionDigests(uint32_t digests[REGION_COUNT],
+                      const requested_data_t &r, const tm &timeInfo,
+                      const String &date, const String &statusStr,
+                      int rssi, uint32_t batVoltage);
+void getRegionBounds(display_region_t region,
+                     int16_t &x, int16_t &y, int16_t &w, int16_t &h);
+void drawFrame();
+void drawFrame(int16_t x, int16_t y, int16_t w, int16_t h);
 void drawError(const uint8_t *bitmap_196x196, const String &errMsgLn1, const String &errMsgLn2="");
 
 const unsigned char * alert_icon(int v);
@@ -0,0 +1,50 @@
+/* API response cache declarations for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __RESPONSE_CACHE_H__
+#define __RESPONSE_CACHE_H__
+
+#include <cstdint>
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <HTTPClient.h>
+#include "api_response.h"
+#include "http_stream.h"
+
+/*
+ * Endpoints whose responses rarely change between wakes, and whose decoded
+ * values are kept in RTC memory.
+ */
+typedef enum api_cache_id
+{
+  API_CACHE_METEO,
+  API_CACHE_DOMOTICZ_GRAPH,
+  API_CACHE_COUNT,
+  API_CACHE_NONE = API_CACHE_COUNT
+} api_cache_id_t;
+
+uint32_t fnv1a32(const uint8_t *data, size_t len, uint32_t hash = 2166136261u);
+void addCacheValidators(api_cache_id_t id, const String &uri,
+                        HTTPClient &http);
+String cacheValidatorHeaders(api_cache_id_t id, const String &uri);
+DeserializationError deserializeCached(api_cache_id_t id, const String &uri,
+  const response_headers_t &headers, int httpCode, MemoryStream &body,
+  DeserializationError (*deserialize)(Stream &json, requested_data_t &r),
+  requested_data_t &r);
+
+#endif
+
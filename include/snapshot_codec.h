@@ -0,0 +1,73 @@
+/* Snapshot encoding for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SNAPSHOT_CODEC_H__
+#define __SNAPSHOT_CODEC_H__
+
+#include <cstddef>
+#include <cstdint>
+#include "api_data.h"
+
+// The encoding does not depend on the hardware, so it is built and tested on
+// the host too (test/test_snapshot_codec).
+
+/*
+ * CRC-32 (IEEE 802.3, reflected) continuing from crc, e.g. the esp32's ROM
+ * crc32_le(). Takes 0 to start.
+ */
+typedef uint32_t (*snapshot_crc_t)(uint32_t crc, const uint8_t *buf,
+                                   size_t len);
+
+/*
+ * Header of the snapshot of an endpoint, followed by its encoded data. The CRC
+ * covers the rest of the header and the encoded data.
+ */
+typedef struct snapshot_header
+{
+  uint32_t crc;
+  uint16_t version;  // SNAPSHOT_VERSION, 0 if nothing is kept
+  uint16_t length;   // bytes of encoded data
+  int64_t  fetched;  // when the data was received, Unix, UTC
+} snapshot_header_t;
+
+// Strings are encoded with a one byte length, followed by their text.
+template <typename S>
+constexpr size_t snapshotStringSize()
+{
+  return 1 + S::capacity();
+}
+
+// largest snapshot of each endpoint, header included
+constexpr size_t METEO_SNAPSHOT_SIZE
+  = sizeof(snapshot_header_t)
+  + sizeof(meteo_current_t) + sizeof(meteo_daily_t) * METEO_NUM_DAILY;
+constexpr size_t IDX_SNAPSHOT_SIZE
+  = sizeof(snapshot_header_t)
+  + sizeof(requested_data_t::data) / sizeof(domoticz_t)
+    * (sizeof(int32_t) + snapshotStringSize<decltype(domoticz_t::description)>()
+                       + snapshotStringSize<decltype(domoticz_t::value)>())
+  + snapshotStringSize<decltype(requested_data_t::memo)>();
+constexpr size_t GRAPH_SNAPSHOT_SIZE
+  = sizeof(snapshot_header_t) + sizeof(requested_data_t::graph);
+
+size_t encodeSnapshot(api_endpoint_t endpoint, const requested_data_t &r,
+                      int64_t fetched, uint8_t *buf, size_t size,
+                      snapshot_crc_t crc);
+bool decodeSnapshot(api_endpoint_t endpoint, const uint8_t *buf, size_t size,
+                    requested_data_t &r, int64_t *fetched, snapshot_crc_t crc);
+
+#endif
@@ -0,0 +1,66 @@
+/* Text metrics declarations for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TEXT_METRICS_H__
+#define __TEXT_METRICS_H__
+
+#include <cstddef>
+#include <Arduino.h>
+#include <Adafruit_GFX.h>
+
+/*
+ * Horizontal metrics of one character of a font, copied out of its GFXglyph.
+ * Characters the font does not have are not drawn and not measured.
+ */
+typedef struct glyph_metrics
+{
+  uint8_t advance;
+  int8_t  left;    // first column of the glyph, from the cursor
+  uint8_t width;   // may be 0, as for a space
+  bool    drawn;
+} glyph_metrics_t;
+
+/*
+ * Metrics of every character of a font, indexed by the character itself, so
+ * text is measured with one table lookup per character. font is NULL for the
+ * built-in 6x8 font.
+ */
+typedef struct text_metrics
+{
+  const GFXfont  *font;
+  glyph_metrics_t glyph[256];
+} text_metrics_t;
+
+/*
+ * A line of text broken by nextLine(): len characters from text, followed by
+ * an ellipsis ("...") if the text that did not fit was cut. width includes the
+ * ellipsis.
+ */
+typedef struct text_line
+{
+  const char *text;
+  size_t      len;
+  uint16_t    width;
+  bool        ellipsis;
+} text_line_t;
+
+const text_metrics_t &getTextMetrics(const GFXfont *font);
+uint16_t getTextWidth(const GFXfont *font, const char *text, size_t len);
+bool nextLine(const GFXfont *font, const char *&text, const char *end,
+              uint16_t max_width, bool last, text_line_t &line);
+
+#endif
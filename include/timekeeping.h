@@ -0,0 +1,34 @@
+/* Time keeping declarations for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __TIMEKEEPING_H__
+#define __TIMEKEEPING_H__
+
+#include <cstdint>
+#include <time.h>
+#include <Arduino.h>
+
+#include "clock_model.h"
+
+void beginTimeSync();
+void recordHttpDate(const String &date, int64_t sentTimerUs,
+                    int64_t receivedTimerUs);
+bool finishTimeSync(tm *timeInfo);
+float getClockDriftPpm();
+
+#endif
+
@@ -15,98 +15,382 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
 #include <vector>
 #include <ArduinoJson.h>
 #include "api_response.h"
 #include "config.h"
+#include "json_pull.h"
 
 //https://github.com/Zindre17/Motivator/blob/master/Motivator.ino
 
-DeserializationError deserialize_Meteo_API(WiFiClient &json, requested_data_t &r)
+/*
+ * Binding of one Open-Meteo daily variable to the member of meteo_current_t
+ * (for today) and of meteo_daily_t (for the following days) it is stored in.
+ * The request's daily= list, the JSON filter and both decoders are generated
+ * from METEO_DAILY_FIELDS, so a variable is declared there once.
+ */
+typedef enum field_type
 {
-  int i;
+  FIELD_NONE,  // not stored
+  FIELD_INT64,
+  FIELD_INT,
+  FIELD_FLOAT
+} field_type_t;
+
+typedef struct field_binding
+{
+  size_t offset;
+  field_type_t type;
+} field_binding_t;
+
+typedef struct meteo_field
+{
+  const char *key;
+  field_binding_t current; // day 0
+  field_binding_t daily;   // days 1..
+} meteo_field_t;
+
+template <typename T> constexpr field_type_t fieldType();
+template <> constexpr field_type_t fieldType<int64_t>() { return FIELD_INT64; }
+template <> constexpr field_type_t fieldType<int>()     { return FIELD_INT; }
+template <> constexpr field_type_t fieldType<float>()   { return FIELD_FLOAT; }
+
+// The type of a binding is taken from the declaration of its member.
+#define BIND(type, member) \
+  {offsetof(type, member), fieldType<decltype(type::member)>()}
+#define NOT_STORED {0, FIELD_NONE}
+
+static constexpr meteo_field_t METEO_DAILY_FIELDS[] = {
+  {"time",                          BIND(meteo_current_t, dt),
+                                    BIND(meteo_daily_t,   dt)},
+  {"weather_code",                  BIND(meteo_current_t, weather_code),
+                                    BIND(meteo_daily_t,   weather_code)},
+  {"temperature_2m_max",            BIND(meteo_current_t, temp_max),
+                                    BIND(meteo_daily_t,   temp_max)},
+  {"temperature_2m_min",            BIND(meteo_current_t, temp_min),
+                                    BIND(meteo_daily_t,   temp_min)},
+  {"precipitation_probability_max", BIND(meteo_current_t, pop),
+                                    NOT_STORED},
+  {"wind_speed_10m_max",            BIND(meteo_current_t, wind_speed),
+                                    NOT_STORED},
+  {"uv_index_max",                  BIND(meteo_current_t, uvi),
+                                    NOT_STORED},
+};
+static constexpr int METEO_NUM_FIELDS =
+  sizeof(METEO_DAILY_FIELDS) / sizeof(METEO_DAILY_FIELDS[0]);
+
+#undef BIND
+#undef NOT_STORED
+
+/* Returns true if every field is stored somewhere, so none is requested for
+ * nothing.
+ */
+static constexpr bool allFieldsStored()
+{
+  for (const meteo_field_t &field : METEO_DAILY_FIELDS)
+  {
+    if (field.current.type == FIELD_NONE && field.daily.type == FIELD_NONE)
+    {
+      return false;
+    }
+  }
+  return true;
+} // end allFieldsStored
+static_assert(allFieldsStored(),
+              "METEO_DAILY_FIELDS declares a variable that is not stored");
+
+// Keys read from each Domoticz response, the filters are built from these
+// lists. The Domoticz graph is not deserialized into a document, see
+// deserialize_Domoticz_API_GRAPH.
+#if JSON_FILTERS
+static const char *DOMOTICZ_IDX_RESULT_KEYS[] = {
+  "idx", "Type", "Name", "Data"
+};
+#endif
+
+/*
+ * Allocator for JsonDocument backed by one statically reserved arena, so JSON
+ * documents never allocate from the heap. Blocks are carved from the arena in
+ * order and the whole arena is released at once by reset(), before each
+ * response is deserialized. The most recent block can still be grown, shrunk
+ * or released in place, which is how ArduinoJson builds strings and trims its
+ * pools.
+ *
+ * Each block is preceded by an 8-byte header holding its size, which also keeps
+ * the blocks 8-byte aligned.
+ */
+class ArenaAllocator : public ArduinoJson::Allocator
+{
+public:
+  void *allocate(size_t size) override
+  {
+    const size_t offset = _used + HEADER_SIZE;
+    if (size > JSON_ARENA_SIZE || offset + size > JSON_ARENA_SIZE)
+    {
+      return NULL;
+    }
+    *reinterpret_cast<size_t *>(_arena + _used) = size;
+    _last = offset;
+    setUsed(offset + size);
+    return _arena + offset;
+  }
+
+  void deallocate(void *ptr) override
+  {
+    if (ptr != NULL && ptr == _arena + _last)
+    {
+      _used = _last - HEADER_SIZE;
+      _last = 0;
+    }
+    return;
+  }
+
+  void *reallocate(void *ptr, size_t newSize) override
+  {
+    if (ptr == NULL)
+    {
+      return allocate(newSize);
+    }
+    uint8_t *block = static_cast<uint8_t *>(ptr);
+    size_t &size = *reinterpret_cast<size_t *>(block - HEADER_SIZE);
+    if (block == _arena + _last)
+    {
+      if (newSize > JSON_ARENA_SIZE - _last)
+      {
+        return NULL;
+      }
+      size = newSize;
+      setUsed(_last + newSize);
+      return block;
+    }
+    if (newSize <= size)
+    {
+      size = newSize;
+      return block;
+    }
+    void *moved = allocate(newSize);
+    if (moved != NULL)
+    {
+      memcpy(moved, block, size);
+    }
+    return moved;
+  }
+
+  void reset()
+  {
+    _used = 0;
+    _last = 0;
+    _highWater = 0;
+    return;
+  }
+
+  // peak use since the last reset
+  size_t highWater() const
+  {
+    return _highWater;
+  }
+
+private:
+  static const size_t HEADER_SIZE = 8;
+
+  void setUsed(size_t used)
+  {
+    // keep the next header aligned
+    _used = (used + HEADER_SIZE - 1) & ~(HEADER_SIZE - 1);
+    _highWater = std::max(_highWater, _used);
+    return;
+  }
+
+  alignas(8) uint8_t _arena[JSON_ARENA_SIZE];
+  size_t _used = 0;
+  size_t _last = 0; // offset of the most recent block, 0 if none
+  size_t _highWater = 0;
+};
+
+static ArenaAllocator jsonArena;
 
 /*
-  JsonDocument filter;
-  filter["current"]  = true;
-  filter["hourly"]   = true;
-  filter["daily"]    = true;
-  filter["alerts"]   = false;
+ * Exclusive use of jsonArena, reset on entry, for the lifetime of the lock.
+ * With CONCURRENT_FETCH, responses are deserialized from several tasks at once.
+ * Must be declared before the documents using the arena, so they are destroyed
+ * while it is still held.
+ */
+class JsonArenaLock
+{
+public:
+  JsonArenaLock()
+  {
+    xSemaphoreTake(mutex(), portMAX_DELAY);
+    jsonArena.reset();
+  }
 
-  DeserializationError error = deserializeJson(doc, json, DeserializationOption::Filter(filter));
-*/
+  ~JsonArenaLock()
+  {
+    xSemaphoreGive(mutex());
+  }
 
-  JsonDocument doc;
+private:
+  static SemaphoreHandle_t mutex()
+  {
+    static SemaphoreHandle_t m = xSemaphoreCreateMutex();
+    return m;
+  }
+};
 
+/*
+ * Cursor over one of the Open-Meteo daily arrays. The cursors of all the
+ * arrays are advanced together, so the days are decoded in a single pass.
+ * A missing or shorter array reads as null.
+ */
+class DailyColumn
+{
+public:
+  DailyColumn() {}
+
+  DailyColumn(JsonObject daily, const char *key)
+  {
+    JsonArray column = daily[key];
+    _it  = column.begin();
+    _end = column.end();
+  }
+
+  JsonVariant value() const
+  {
+    return _it != _end ? *_it : JsonVariant();
+  }
+
+  void next()
+  {
+    if (_it != _end)
+    {
+      ++_it;
+    }
+  }
+
+  bool done() const
+  {
+    return !(_it != _end);
+  }
+
+private:
+  JsonArray::iterator _it;
+  JsonArray::iterator _end;
+};
+
+#if JSON_FILTERS
+/* Marks every key of keys to be kept by a deserialization filter.
+ */
+template <size_t N>
+static void addFilterKeys(JsonObject filter, const char *(&keys)[N])
+{
+  for (const char *key : keys)
+  {
+    filter[key] = true;
+  }
+  return;
+} // end addFilterKeys
+#endif
+
+/* Deserializes json into doc. With JSON_FILTERS, only the fields kept by
+ * filter are stored in doc.
+ * Parse time and the high-water mark of the JSON arena are printed with
+ * DEBUG_LEVEL >= 1.
+ */
+static DeserializationError parseJson(JsonDocument &doc, Stream &json,
+                                      const JsonDocument &filter,
+                                      const char *name)
+{
+#if DEBUG_LEVEL >= 1
+  unsigned long parseStart = micros();
+#endif
+#if JSON_FILTERS
+  DeserializationError error = deserializeJson(
+    doc, json, DeserializationOption::Filter(filter));
+#else
   DeserializationError error = deserializeJson(doc, json);
+#endif
 
 #if DEBUG_LEVEL >= 1
+  Serial.println(String("[debug] ") + name + " parsed in "
+                 + String(micros() - parseStart) + " us, JSON arena peak "
+                 + String(jsonArena.highWater()) + " of "
+                 + String(JSON_ARENA_SIZE) + " B"
+                 + (JSON_FILTERS ? " (filtered)" : " (unfiltered)"));
   Serial.println("[debug] doc.overflowed() : " + String(doc.overflowed()));  // 0 = false
 #endif
 #if DEBUG_LEVEL >= 2
   serializeJsonPretty(doc, Serial);
 #endif
+  return error;
+} // end parseJson
 
-  if (error) {
-    return error;
-  }
-
+/* Resets what an Open-Meteo response does not provide, before it is decoded.
+ */
+static void beginMeteo(requested_data_t &r)
+{
   //Reset alert
   for (int i = 0; i < 3; ++i)
   {
     r.current.alert[i] = 0;
   }
   r.current.alert[0] = 1; // Alien ^^
+  return;
+} // end beginMeteo
 
-  JsonObject current = doc["current"];
-  r.current.dt         = current["dt"]        .as<int64_t>();
-  r.current.sunrise    = current["sunrise"]   .as<int64_t>();
-  r.current.sunset     = current["sunset"]    .as<int64_t>();
-
-  r.current.pressure   = current["pressure"]  .as<int>();
-  r.current.humidity   = current["humidity"]  .as<int>();
-  r.current.dew_point  = current["dew_point"] .as<float>();
-  r.current.clouds     = current["clouds"]    .as<int>();
-  r.current.uvi        = current["uvi"]       .as<float>();
-  r.current.wind_speed = current["wind_speed"].as<float>();
-
-  JsonArray ListTime = doc["daily"]["time"].as<JsonArray>();
-
-  i = 0;
-  for(JsonVariant v : ListTime)
+/* Stores the value of field for day of an Open-Meteo response, where day 0 is
+ * today. The value is given both as an integer and as a real, the member's type
+ * selects which one is stored.
+ */
+static void storeMeteoField(requested_data_t &r, int day,
+                            const meteo_field_t &field, int64_t integer,
+                            float real)
+{
+  const field_binding_t &binding = day == 0 ? field.current : field.daily;
+  uint8_t *base = day == 0 ? reinterpret_cast<uint8_t *>(&r.current)
+                           : reinterpret_cast<uint8_t *>(&r.daily[day - 1]);
+  switch (binding.type)
   {
+  case FIELD_INT64:
+    memcpy(base + binding.offset, &integer, sizeof(integer));
+    break;
+  case FIELD_INT:
+  {
+    int v = static_cast<int>(integer);
+    memcpy(base + binding.offset, &v, sizeof(v));
+    break;
+  }
+  case FIELD_FLOAT:
+    memcpy(base + binding.offset, &real, sizeof(real));
+    break;
+  case FIELD_NONE:
+    break;
+  }
+  return;
+} // end storeMeteoField
 
-    //Today day
-    if (i == 0)
-    {
-      r.current.dt                        = v.as<int64_t>();
-      //r.current.sunrise    = current["sunrise"]   .as<int64_t>();
-      //r.current.sunset     = current["sunset"]    .as<int64_t>();
-      r.current.temp_max                  = doc["daily"]["temperature_2m_max"][i].as<float>();
-      r.current.temp_min                  = doc["daily"]["temperature_2m_min"][i].as<float>();
-      r.current.wind_speed                = doc["daily"]["wind_speed_10m_max"][i].as<float>();
-      r.current.pop                       = doc["daily"]["precipitation_probability_max"][i].as<float>();
-      r.current.weather_code              = doc["daily"]["weather_code"][i].as<int>();
-      r.current.uvi                       = doc["daily"]["uv_index_max"][i].as<float>();
-    }
-    else
-    {
-      r.daily[i-1].dt                  = v.as<int64_t>();
-      //r.daily[i].weather.icon        = ListWeather_code[i].as<const char *>();
-      //r.daily[i-1].clouds              = 0;//daily["clouds"]    .as<int>();
-      r.daily[i-1].temp_min            = doc["daily"]["temperature_2m_min"][i].as<float>();
-      r.daily[i-1].temp_max            = doc["daily"]["temperature_2m_max"][i].as<float>();
-      r.daily[i-1].weather_code        = doc["daily"]["weather_code"][i].as<int>();
-
-    }
-
-    if (i == METEO_NUM_DAILY - 1)
+/* Returns the daily= list of the Open-Meteo request, for METEO_DAILY_FIELDS.
+ */
+String getMeteoDailyQuery()
+{
+  String query;
+  for (const meteo_field_t &field : METEO_DAILY_FIELDS)
+  {
+    if (!query.isEmpty())
     {
-      break;
+      query += ',';
     }
-    ++i;
+    query += field.key;
   }
+  return query;
+} // end getMeteoDailyQuery
 
+/* Fills in what is derived from an Open-Meteo response, once it is decoded.
+ */
+static void finishMeteo(requested_data_t &r)
+{
   // Use fake value four hourly
   //generate fake data
   for (int i = 1; i < HOURLY_GRAPH_MAX; ++i)
@@ -115,86 +399,327 @@ DeserializationError deserialize_Meteo_API(WiFiClient &json, requested_data_t &r
     r.hourly[i].pop = random(10, 30);
     r.hourly[i].dt  = r.current.dt + i * 3600;
   }
+  return;
+} // end finishMeteo
 
-  return error;
-} // end deserialize_Meteo_API
-
-
-DeserializationError deserialize_Domoticz_API_GRAPH(WiFiClient &json, requested_data_t &r)
+DeserializationError deserialize_Meteo_API(Stream &json, requested_data_t &r)
 {
-  int i;
+  JsonArenaLock arenaLock;
+  // left empty without JSON_FILTERS, so the whole arena is left to doc
+  JsonDocument filter(&jsonArena);
+#if JSON_FILTERS
+  JsonObject dailyFilter = filter["daily"].to<JsonObject>();
+  for (const meteo_field_t &field : METEO_DAILY_FIELDS)
+  {
+    dailyFilter[field.key] = true;
+  }
+#endif
 
-  JsonDocument doc;
-  DeserializationError error = deserializeJson(doc, json);
+  JsonDocument doc(&jsonArena);
 
-#if DEBUG_LEVEL >= 1
-  Serial.println("[debug] doc.overflowed() : " + String(doc.overflowed()));  // 0 = false
-#endif
-#if DEBUG_LEVEL >= 2
-  serializeJsonPretty(doc, Serial);
-#endif
+  DeserializationError error = parseJson(doc, json, filter, "Open-Meteo");
 
   if (error) {
     return error;
   }
 
-  JsonArray result = doc["result"].as<JsonArray>();
+  beginMeteo(r);
 
-  i = 0;
-  float v1,v2;
-  const char * day;
+  // Walk the daily columns together, each array once. Indexing them with [i]
+  // would walk every array from its start for each day.
+  JsonObject daily = doc["daily"];
+  DailyColumn columns[METEO_NUM_FIELDS];
+  for (int k = 0; k < METEO_NUM_FIELDS; ++k)
+  {
+    columns[k] = DailyColumn(daily, METEO_DAILY_FIELDS[k].key);
+  }
 
-  for(JsonVariant v : result)
+  for (int day = 0; day < METEO_NUM_DAILY; ++day)
   {
+    bool any = false;
+    for (int k = 0; k < METEO_NUM_FIELDS; ++k)
+    {
+      any |= !columns[k].done();
+    }
+    if (!any)
+    {
+      break;
+    }
 
-    day = v["d"].as<const char *>();
-    r.graph[i].dt[0] = day[8];
-    r.graph[i].dt[1] = day[9];
+    for (int k = 0; k < METEO_NUM_FIELDS; ++k)
+    {
+      JsonVariant v = columns[k].value();
+      storeMeteoField(r, day, METEO_DAILY_FIELDS[k], v.as<int64_t>(),
+                      v.as<float>());
+      columns[k].next();
+    }
+  }
 
-    v1 = v["v1"].as<float>();
-    v2 = v["v2"].as<float>();
-    r.graph[i].value = v1 + v2;
+  finishMeteo(r);
 
-    i+=1;
+  return error;
+} // end deserialize_Meteo_API
 
-    //Security
-    if (i > 32) { break; }
+/* Splits the next comma-separated cell off line, which is advanced past it.
+ * Returns NULL when there are no more cells.
+ */
+static char *nextCsvCell(char *&line)
+{
+  if (line == NULL)
+  {
+    return NULL;
+  }
+  char *cell = line;
+  char *comma = strchr(line, ',');
+  if (comma != NULL)
+  {
+    *comma = '\0';
+    line = comma + 1;
+  }
+  else
+  {
+    line = NULL;
+  }
+  return cell;
+} // end nextCsvCell
+
+/* Reads one line, without its line ending. Characters that do not fit in buf
+ * are dropped.
+ *
+ * Returns the length of the line, or -1 at the end of the stream.
+ */
+static int readCsvLine(Stream &csv, char *buf, size_t size)
+{
+  size_t len = 0;
+  bool any = false;
+  char c;
+  while (csv.readBytes(&c, 1) == 1)
+  {
+    any = true;
+    if (c == '\n')
+    {
+      break;
+    }
+    if (c != '\r' && len + 1 < size)
+    {
+      buf[len++] = c;
+    }
+  }
+  buf[len] = '\0';
+  return any ? static_cast<int>(len) : -1;
+} // end readCsvLine
 
+/* Returns the value of a cell as an integer, truncated if it is a real, or 0
+ * if the cell is not a number (e.g. an ISO 8601 date), like
+ * JsonVariant::as<int64_t>().
+ */
+static int64_t csvInt64(const char *cell)
+{
+  char *end;
+  long long v = strtoll(cell, &end, 10);
+  if (end != cell && *end == '\0')
+  {
+    return v;
   }
+  double d = strtod(cell, &end);
+  return (end != cell && *end == '\0') ? static_cast<int64_t>(d) : 0;
+} // end csvInt64
 
-  JsonArray resultprev = doc["resultprev"].as<JsonArray>();
-  i = 0;
+/* Decodes the daily section of an Open-Meteo response requested with
+ * format=csv. It is a fraction of the size of the JSON response, and is
+ * decoded line by line without a document.
+ *
+ * The response starts with a location header, followed by a blank line and
+ * the daily table: a header row naming each column (followed by its unit),
+ * then one row per day. The columns are matched by name, so their order does
+ * not matter.
+ */
+DeserializationError deserialize_Meteo_CSV(Stream &csv, requested_data_t &r)
+{
+#if DEBUG_LEVEL >= 1
+  unsigned long parseStart = micros();
+#endif
+  char line[384];
+  int len;
+
+  // find the header row of the daily table
+  while ((len = readCsvLine(csv, line, sizeof(line))) >= 0
+         && strncmp(line, "time,", 5) != 0)
+  {}
+  if (len < 0)
+  {
+    return DeserializationError::InvalidInput;
+  }
 
-  for(JsonVariant v : resultprev)
+  // column index -> index in METEO_DAILY_FIELDS, -1 if not read
+  int8_t columns[16];
+  int numColumns = 0;
+  char *rest = line;
+  char *cell;
+  while ((cell = nextCsvCell(rest)) != NULL && numColumns < 16)
   {
-    v1 = v["v1"].as<float>();
-    v2 = v["v2"].as<float>();
-    r.graph[i].prev_value = v1 + v2;
+    char *unit = strstr(cell, " (");
+    if (unit != NULL)
+    {
+      *unit = '\0';
+    }
+    columns[numColumns] = -1;
+    for (int k = 0; k < METEO_NUM_FIELDS; ++k)
+    {
+      if (strcmp(cell, METEO_DAILY_FIELDS[k].key) == 0)
+      {
+        columns[numColumns] = k;
+      }
+    }
+    ++numColumns;
+  }
 
-    i+=1;
+  beginMeteo(r);
 
-    //Security
-    if (i > 32) { break; }
+  int i = 0;
+  while (i < METEO_NUM_DAILY
+         && (len = readCsvLine(csv, line, sizeof(line))) > 0)
+  {
+    rest = line;
+    for (int c = 0; c < numColumns && (cell = nextCsvCell(rest)) != NULL; ++c)
+    {
+      if (columns[c] >= 0)
+      {
+        storeMeteoField(r, i, METEO_DAILY_FIELDS[columns[c]], csvInt64(cell),
+                        strtof(cell, NULL));
+      }
+    }
+    ++i;
   }
 
-  return error;
-}
+  finishMeteo(r);
+
+#if DEBUG_LEVEL >= 1
+  Serial.println("[debug] Open-Meteo CSV decoded in "
+                 + String(micros() - parseStart) + " us, "
+                 + String(i) + " days");
+#endif
+  return i > 0 ? DeserializationError::Ok
+               : DeserializationError::IncompleteInput;
+} // end deserialize_Meteo_CSV
 
 
-DeserializationError deserialize_Domoticz_API_IDX(WiFiClient &json, requested_data_t &r)
+/* Decodes the records of one of the arrays of a Domoticz graph response into
+ * r.graph, either as the values of the current period or of the previous one.
+ * Records beyond the capacity of r.graph are skipped.
+ */
+static void decodeGraphRecords(JsonPullParser &parser, requested_data_t &r,
+                               bool previous)
 {
-  int i;
+  const int maxRecords = sizeof(r.graph) / sizeof(r.graph[0]) - 2; // 33
+  char key[8];
+  int i = 0;
 
-  JsonDocument doc;
+  if (!parser.nextIs('['))
+  {
+    parser.skipValue(); // null when there is no data for the period
+    return;
+  }
+  parser.beginArray();
+  while (parser.nextElement())
+  {
+    if (i >= maxRecords || !parser.beginObject())
+    {
+      parser.skipValue();
+      continue;
+    }
 
-  DeserializationError error = deserializeJson(doc, json);
+    char day[16] = "";
+    float v1 = 0, v2 = 0;
+    while (parser.nextKey(key, sizeof(key)))
+    {
+      if (!previous && strcmp(key, "d") == 0)
+      {
+        parser.readString(day, sizeof(day));
+      }
+      else if (strcmp(key, "v1") == 0)
+      {
+        parser.readFloat(v1);
+      }
+      else if (strcmp(key, "v2") == 0)
+      {
+        parser.readFloat(v2);
+      }
+      else
+      {
+        parser.skipValue();
+      }
+    }
 
+    if (previous)
+    {
+      r.graph[i].prev_value = v1 + v2;
+    }
+    else
+    {
+      r.graph[i].dt[0] = day[8]; // "YYYY-MM-DD"
+      r.graph[i].dt[1] = day[9];
+      r.graph[i].value = v1 + v2;
+    }
+    ++i;
+  }
+  return;
+} // end decodeGraphRecords
+
+/* Decodes a Domoticz counter graph as it is streamed, without building a
+ * JsonDocument, so memory use stays the same for month and year ranges.
+ */
+DeserializationError deserialize_Domoticz_API_GRAPH(Stream &json, requested_data_t &r)
+{
 #if DEBUG_LEVEL >= 1
-  Serial.println("[debug] doc.overflowed() : " + String(doc.overflowed()));  // 0 = false
+  unsigned long parseStart = micros();
 #endif
-#if DEBUG_LEVEL >= 2
-  serializeJsonPretty(doc, Serial);
+  JsonPullParser parser(json);
+  char key[16];
+
+  if (parser.beginObject())
+  {
+    while (parser.nextKey(key, sizeof(key)))
+    {
+      if (strcmp(key, "result") == 0)
+      {
+        decodeGraphRecords(parser, r, false);
+      }
+      else if (strcmp(key, "resultprev") == 0)
+      {
+        decodeGraphRecords(parser, r, true);
+      }
+      else
+      {
+        parser.skipValue();
+      }
+    }
+  }
+
+#if DEBUG_LEVEL >= 1
+  Serial.println("[debug] Domoticz graph streamed in "
+                 + String(micros() - parseStart) + " us : "
+                 + String(parser.error().c_str()));
 #endif
+  return parser.error();
+} // end deserialize_Domoticz_API_GRAPH
+
+
+DeserializationError deserialize_Domoticz_API_IDX(Stream &json, requested_data_t &r)
+{
+  int i;
+
+  JsonArenaLock arenaLock;
+  // left empty without JSON_FILTERS, so the whole arena is left to doc
+  JsonDocument filter(&jsonArena);
+#if JSON_FILTERS
+  addFilterKeys(filter["result"].add<JsonObject>(), DOMOTICZ_IDX_RESULT_KEYS);
+#endif
+
+  JsonDocument doc(&jsonArena);
+
+  DeserializationError error = parseJson(doc, json, filter,
+                                         "Domoticz devices");
 
   if (error) {
     return error;
@@ -256,7 +781,7 @@ DeserializationError deserialize_Domoticz_API_IDX(WiFiClient &json, requested_da
   uint32_t freeHeapBytes = heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
   uint32_t totalHeapBytes = heap_caps_get_total_size(MALLOC_CAP_DEFAULT);
   int percentageHeapFree = freeHeapBytes * 100.0f / (float)totalHeapBytes;
-  r.data[i].value = String(percentageHeapFree) + " %";
+  r.data[i].value.format("%d %%", percentageHeapFree);
 
   return error;
 }
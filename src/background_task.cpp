@@ -0,0 +1,99 @@
+/* Background task for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <Arduino.h>
+#include <esp_timer.h>
+
+#include "background_task.h"
+
+/* FreeRTOS task that runs the work of a background_task_t, times it, then
+ * deletes itself.
+ */
+static void backgroundTaskMain(void *pvParameters)
+{
+  background_task_t *task = static_cast<background_task_t *>(pvParameters);
+  const int64_t start = esp_timer_get_time();
+  task->run(task->arg);
+  task->runUs = esp_timer_get_time() - start;
+  xSemaphoreGive(task->done);
+  vTaskDelete(NULL);
+} // end backgroundTaskMain
+
+/* Starts run(arg) on the core that is not running the caller. task must
+ * remain valid until it is awaited.
+ *
+ * Returns false if the task could not be created, run was then not called.
+ */
+bool startBackgroundTask(background_task_t &task, void (*run)(void *arg),
+                         void *arg, const char *name, uint32_t stackSize)
+{
+  task.run    = run;
+  task.arg    = arg;
+  task.handle = NULL;
+  task.runUs  = 0;
+  task.done   = xSemaphoreCreateBinary();
+  if (task.done == NULL)
+  {
+    return false;
+  }
+  // The handle is stored before the task can run, so the task can tell it
+  // owns what it works on from its first instruction.
+  const BaseType_t otherCore = xPortGetCoreID() == 0 ? 1 : 0;
+  if (xTaskCreatePinnedToCore(backgroundTaskMain, name, stackSize, &task, 1,
+                              &task.handle, otherCore) != pdPASS)
+  {
+    vSemaphoreDelete(task.done);
+    task.done   = NULL;
+    task.handle = NULL;
+    return false;
+  }
+  return true;
+} // end startBackgroundTask
+
+/* Blocks until the work of task is done, and hands what it used back to the
+ * caller. Does nothing if task is not pending.
+ *
+ * Returns how long the caller waited, in microseconds.
+ */
+int64_t awaitBackgroundTask(background_task_t &task)
+{
+  if (task.handle == NULL)
+  {
+    return 0;
+  }
+  const int64_t waitStart = esp_timer_get_time();
+  xSemaphoreTake(task.done, portMAX_DELAY);
+  vSemaphoreDelete(task.done);
+  task.done   = NULL;
+  task.handle = NULL;
+  return esp_timer_get_time() - waitStart;
+} // end awaitBackgroundTask
+
+/* Returns true if task was started and not yet awaited.
+ */
+bool backgroundTaskPending(const background_task_t &task)
+{
+  return task.handle != NULL;
+} // end backgroundTaskPending
+
+/* Returns true if what task works on may be used by the caller: either task is
+ * not pending, or the caller is task itself.
+ */
+bool backgroundTaskHandedBack(const background_task_t &task)
+{
+  return task.handle == NULL || task.handle == xTaskGetCurrentTaskHandle();
+} // end backgroundTaskHandedBack
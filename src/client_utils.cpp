@@ -16,12 +16,14 @@
  */
 
 // built-in C++ libraries
+#include <algorithm>
 #include <cstring>
 #include <vector>
 
 // arduino/esp32 libraries
 #include <Arduino.h>
 #include <esp_sntp.h>
+#include <esp_timer.h>
 #include <HTTPClient.h>
 #include <SPI.h>
 #include <time.h>
@@ -37,48 +39,201 @@
 #include "client_utils.h"
 #include "config.h"
 #include "display_utils.h"
+#include "http_stream.h"
+#include "profiler.h"
 #include "renderer.h"
+#include "response_cache.h"
+#include "timekeeping.h"
 #ifndef USE_HTTP
   #include <WiFiClientSecure.h>
 #endif
+#ifdef USE_HTTPS_WITH_CERT_VERIF
+  #include "cert.h"
+#endif
 
 #ifdef USE_HTTP
   static const uint16_t METEO_PORT = 80;
+  typedef WiFiClient api_client_t;
+  // stack size of each concurrent fetch task
+  static const uint32_t FETCH_TASK_STACK = 8192;
 #else
   static const uint16_t METEO_PORT = 443;
+  typedef WiFiClientSecure api_client_t;
+  // the TLS handshake needs a larger stack
+  static const uint32_t FETCH_TASK_STACK = 12288;
+#endif
+
+// The Date header of every response is used as a time source, see
+// recordHttpDate(). The validators are used by the response cache, and the
+// content encoding by deserializeBody().
+static const char *RESPONSE_HEADERS[] = {"Date", "ETag", "Last-Modified",
+                                         "Content-Encoding"};
+
+#if HTTP_GZIP
+/* Asks for a gzip encoded response, see HTTP_GZIP. Only for HTTP/1.0 requests:
+ * with HTTP/1.1, HTTPClient always sends its own
+ * "Accept-Encoding: identity;q=1,chunked;q=0.1,*;q=0", and a second header
+ * would contradict it. The HTTP/1.1 keep-alive requests to Domoticz are written
+ * without HTTPClient for that reason, see sendDomoticzRequest().
+ */
+static void acceptGzip(HTTPClient &http)
+{
+  http.addHeader("Accept-Encoding", "gzip");
+  return;
+} // end acceptGzip
+#endif
+
+#if WIFI_FAST_RECONNECT
+/*
+ * Association and DHCP lease of the last successful connection. Kept in RTC
+ * memory, so it survives deep sleep but not a power cycle.
+ */
+typedef struct wifi_cache
+{
+  uint32_t magic;      // WIFI_CACHE_MAGIC once filled
+  uint32_t uses;       // number of reconnects since the lease was obtained
+  time_t   leaseStart; // system time when the lease was obtained
+  uint8_t  bssid[6];
+  int32_t  channel;
+  uint32_t ip;
+  uint32_t gateway;
+  uint32_t subnet;
+  uint32_t dns1;
+  uint32_t dns2;
+} wifi_cache_t;
+
+static const uint32_t WIFI_CACHE_MAGIC = 0x57494649; // "WIFI"
+// The lease is renewed once it is WIFI_CACHE_MAX_AGE old. In case the clock
+// cannot be trusted, it is also renewed after this many reconnects (a day when
+// waking every 30 minutes).
+static const uint32_t WIFI_CACHE_MAX_USES = 48;
+
+RTC_DATA_ATTR static wifi_cache_t wifiCache = {};
+
+/* Returns true if the cached lease can still be used. The system clock keeps
+ * running through deep sleep. A lease obtained before the clock was first set
+ * looks expired once it is, so it is renewed on the next wake.
+ */
+static bool wifiCacheValid()
+{
+  if (wifiCache.magic != WIFI_CACHE_MAGIC
+   || wifiCache.uses >= WIFI_CACHE_MAX_USES)
+  {
+    return false;
+  }
+  const time_t age = time(NULL) - wifiCache.leaseStart;
+  return age >= 0 && age < static_cast<time_t>(WIFI_CACHE_MAX_AGE);
+} // end wifiCacheValid
 #endif
 
+#if DEBUG_LEVEL >= 1
+// when WiFi was powered on, 0 while it is off
+static unsigned long wifiOnSince = 0;
+#endif
+
+/* Waits for WiFi to connect, printing progress to the serial monitor.
+ *
+ * Returns WiFi status.
+ */
+static wl_status_t waitForWiFi(unsigned long timeoutMs)
+{
+  // timeout if WiFi does not connect in timeoutMs from now
+  unsigned long timeout = millis() + timeoutMs;
+  wl_status_t connection_status = WiFi.status();
+
+  while ((connection_status != WL_CONNECTED) && (millis() < timeout))
+  {
+    Serial.print(".");
+    delay(50);
+    connection_status = WiFi.status();
+  }
+  Serial.println();
+  return connection_status;
+} // end waitForWiFi
+
 /* Power-on and connect WiFi.
  * Takes int parameter to store WiFi RSSI, or “Received Signal Strength
  * Indicator"
  *
+ * With WIFI_FAST_RECONNECT, the access point, channel and DHCP lease of the
+ * last connection are reused to skip the channel scan and DHCP. A full
+ * connection is made if that fails.
+ *
  * Returns WiFi status.
  */
 wl_status_t startWiFi(int &wifiRSSI)
 {
+#if DEBUG_LEVEL >= 1
+  wifiOnSince = millis();
+#endif
   WiFi.mode(WIFI_STA);
   Serial.printf("%s '%s'", TXT_CONNECTING_TO, WIFI_SSID);
-  //WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE, INADDR_NONE);
   WiFi.setHostname("Smart_home_TAB");
-  WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
 
-  // timeout if WiFi does not connect in WIFI_TIMEOUT ms from now
-  unsigned long timeout = millis() + WIFI_TIMEOUT;
-  wl_status_t connection_status = WiFi.status();
+  unsigned long connectStart = millis();
+  wl_status_t connection_status = WL_DISCONNECTED;
+  const char *connectPath __attribute__((unused)) = "full scan";
 
-  while ((connection_status != WL_CONNECTED) && (millis() < timeout))
+#if WIFI_FAST_RECONNECT
+  if (wifiCacheValid())
   {
-    Serial.print(".");
-    delay(50);
-    connection_status = WiFi.status();
+    connectPath = "cached";
+    WiFi.config(IPAddress(wifiCache.ip), IPAddress(wifiCache.gateway),
+                IPAddress(wifiCache.subnet), IPAddress(wifiCache.dns1),
+                IPAddress(wifiCache.dns2));
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD, wifiCache.channel, wifiCache.bssid);
+    connection_status = waitForWiFi(WIFI_FAST_TIMEOUT);
+
+    if (connection_status == WL_CONNECTED)
+    {
+      ++wifiCache.uses;
+    }
+    else
+    { // the access point may have moved to another channel, or be replaced
+#if DEBUG_LEVEL >= 1
+      Serial.println("[debug] Cached WiFi connection failed after "
+                     + String(millis() - connectStart) + " ms");
+#endif
+      wifiCache.magic = 0;
+      WiFi.disconnect();
+      WiFi.config(INADDR_NONE, INADDR_NONE, INADDR_NONE); // back to DHCP
+      connectPath = "full scan after cache miss";
+      Serial.printf("%s '%s'", TXT_CONNECTING_TO, WIFI_SSID);
+    }
+  }
+#endif
+
+  if (connection_status != WL_CONNECTED)
+  {
+    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+    connection_status = waitForWiFi(WIFI_TIMEOUT);
+
+#if WIFI_FAST_RECONNECT
+    if (connection_status == WL_CONNECTED)
+    {
+      memcpy(wifiCache.bssid, WiFi.BSSID(), sizeof(wifiCache.bssid));
+      wifiCache.channel = WiFi.channel();
+      wifiCache.ip      = WiFi.localIP();
+      wifiCache.gateway = WiFi.gatewayIP();
+      wifiCache.subnet  = WiFi.subnetMask();
+      wifiCache.dns1    = WiFi.dnsIP(0);
+      wifiCache.dns2    = WiFi.dnsIP(1);
+      wifiCache.uses       = 0;
+      wifiCache.leaseStart = time(NULL);
+      wifiCache.magic      = WIFI_CACHE_MAGIC;
+    }
+#endif
   }
-  Serial.println();
 
   if (connection_status == WL_CONNECTED)
   {
     wifiRSSI = WiFi.RSSI(); // get WiFi signal strength now, because the WiFi
                             // will be turned off to save power!
     Serial.println("IP: " + WiFi.localIP().toString());
+#if DEBUG_LEVEL >= 1
+    Serial.println("[debug] WiFi connected in " + String(millis() - connectStart)
+                   + " ms (" + connectPath + ")");
+#endif
   }
   else
   {
@@ -93,6 +248,14 @@ void killWiFi()
 {
   WiFi.disconnect();
   WiFi.mode(WIFI_OFF);
+#if DEBUG_LEVEL >= 1
+  if (wifiOnSince != 0)
+  {
+    Serial.println("[debug] WiFi was on for "
+                   + String(millis() - wifiOnSince) + " ms");
+    wifiOnSince = 0;
+  }
+#endif
 } // killWiFi
 
 /* Prints the local time to serial monitor.
@@ -141,6 +304,220 @@ bool waitForSNTPSync(tm *timeInfo)
 
 
 
+#if API_RESPONSE_CACHE || DOWNLOAD_THEN_PARSE
+/* Reads the whole body of an HTTP/1.0 response into body, up to its
+ * Content-Length or until the server closes the connection.
+ */
+static void readBody(HTTPClient &http, MemoryStream &body)
+{
+  WiFiClient *stream = http.getStreamPtr();
+  int remaining = http.getSize(); // -1 if unknown
+  uint8_t buf[256];
+  unsigned long timeout = millis() + HTTP_CLIENT_TCP_TIMEOUT;
+
+  while (stream != NULL && remaining != 0 && !body.overflowed()
+      && (stream->connected() || stream->available())
+      && millis() < timeout)
+  {
+    size_t len = stream->available();
+    if (len == 0)
+    {
+      delay(1);
+      continue;
+    }
+    len = std::min(len, sizeof(buf));
+    if (remaining > 0)
+    {
+      len = std::min(len, static_cast<size_t>(remaining));
+    }
+    int count = stream->read(buf, len);
+    if (count > 0)
+    {
+      body.write(buf, count);
+      if (remaining > 0)
+      {
+        remaining -= count;
+      }
+      timeout = millis() + HTTP_CLIENT_TCP_TIMEOUT;
+    }
+  }
+#if DEBUG_LEVEL >= 1
+  Serial.println("[debug] Response body : " + String(body.size()) + " B");
+#endif
+  return;
+} // end readBody
+
+/* Reads what is left of a body stream into body.
+ */
+static void drainBody(Stream &src, MemoryStream &body)
+{
+  char buf[256];
+  size_t len;
+  while ((len = src.readBytes(buf, sizeof(buf))) > 0)
+  {
+    body.write(reinterpret_cast<uint8_t *>(buf), len);
+  }
+  return;
+} // end drainBody
+
+// Bodies held whole before they are decoded, see RESPONSE_BUFFER_SIZE. Each is
+// only used by the requests to one endpoint, so concurrent fetch tasks never
+// share one.
+#if DOWNLOAD_THEN_PARSE
+static uint8_t responseBuffers[API_ENDPOINT_COUNT][RESPONSE_BUFFER_SIZE];
+#else
+// only the cached responses are held, one per cache entry
+static uint8_t responseBuffers[API_CACHE_COUNT][RESPONSE_BUFFER_SIZE];
+#endif
+#endif
+
+// status of the last request to each endpoint, see getApiData()
+static int endpointStatus[API_ENDPOINT_COUNT];
+
+/* Records status as the status of the last request to endpoint.
+ *
+ * Returns status.
+ */
+static int endpointResult(api_endpoint_t endpoint, int status)
+{
+  endpointStatus[endpoint] = status;
+  return status;
+} // end endpointResult
+
+#if DOWNLOAD_THEN_PARSE
+/*
+ * A response read while WiFi is on, to be decoded by parseApiData() once it is
+ * off. There is one per request, so concurrent fetch tasks never share one.
+ */
+typedef struct deferred_response
+{
+  bool pending;
+  api_cache_id_t cache; // ignored without API_RESPONSE_CACHE
+  String uri;
+  int httpCode;
+  response_headers_t headers;
+  MemoryStream body; // over responseBuffers[endpoint], see deferredBody()
+  DeserializationError (*deserialize)(Stream &body, requested_data_t &r);
+  profile_phase_t parsePhase;
+} deferred_response_t;
+
+static deferred_response_t deferredResponses[API_ENDPOINT_COUNT];
+
+/* Returns the buffer the body of the response to endpoint is read into before
+ * deferResponse() is called, emptied.
+ */
+static MemoryStream &deferredBody(api_endpoint_t endpoint)
+{
+  MemoryStream &body = deferredResponses[endpoint].body;
+  body = MemoryStream(responseBuffers[endpoint], RESPONSE_BUFFER_SIZE);
+  return body;
+} // end deferredBody
+
+/* Keeps the response to uri, whose body has been read into
+ * deferredBody(endpoint), with its headers to be decoded later.
+ *
+ * Returns EmptyInput if a 200 response has no body, so it is requested again,
+ * or NoMemory if the body did not fit in its buffer.
+ */
+static DeserializationError deferResponse(api_endpoint_t endpoint,
+  api_cache_id_t cache, const String &uri, const response_headers_t &headers,
+  int httpCode,
+  DeserializationError (*deserialize)(Stream &body, requested_data_t &r),
+  profile_phase_t parsePhase)
+{
+  deferred_response_t &d = deferredResponses[endpoint];
+  if (d.body.overflowed())
+  {
+    d.pending = false;
+    return DeserializationError::NoMemory;
+  }
+  if (httpCode == HTTP_CODE_OK && d.body.size() == 0)
+  {
+    d.pending = false;
+    return DeserializationError::EmptyInput;
+  }
+  d.cache       = cache;
+  d.uri         = uri;
+  d.httpCode    = httpCode;
+  d.headers     = headers;
+  d.deserialize = deserialize;
+  d.parsePhase  = parsePhase;
+  d.pending     = true;
+  return DeserializationError::Ok;
+} // end deferResponse
+
+/* Decodes the responses read by getApiData(), once WiFi is off. Their bodies
+ * are emptied as they are decoded. The status of each endpoint whose response
+ * could not be decoded is updated, offset by -256 like when parsing while
+ * reading.
+ *
+ * Returns HTTP_CODE_OK if the data of every endpoint was received, otherwise
+ * the status of the first that failed.
+ */
+int parseApiData(requested_data_t &r, int status[API_ENDPOINT_COUNT])
+{
+  int rxStatus = HTTP_CODE_OK;
+  for (int i = 0; i < API_ENDPOINT_COUNT; ++i)
+  {
+    deferred_response_t &d = deferredResponses[i];
+    if (d.pending)
+    {
+      int64_t parseStart = profileStart();
+      DeserializationError jsonErr;
+#if API_RESPONSE_CACHE
+      if (d.cache != API_CACHE_NONE)
+      {
+        jsonErr = deserializeCached(d.cache, d.uri, d.headers, d.httpCode,
+                                    d.body, d.deserialize, r);
+      }
+      else
+#endif
+      {
+        jsonErr = deserializeBody(d.headers, d.body, d.deserialize, r);
+      }
+      profileEnd(d.parsePhase, parseStart);
+      d.body.clear();
+      d.pending = false;
+
+      if (jsonErr)
+      {
+        // -256 offset distinguishes these errors from httpClient errors
+        status[i] = -256 - static_cast<int>(jsonErr.code());
+      }
+    }
+    if (rxStatus == HTTP_CODE_OK)
+    {
+      rxStatus = status[i];
+    }
+  }
+  return rxStatus;
+} // end parseApiData
+#endif
+
+#define METEO_STR_(x) #x
+#define METEO_STR(x) METEO_STR_(x)
+
+/*
+ * Formats the Open-Meteo forecast can be requested in, in order of preference.
+ * The next one is used when a response is rejected or cannot be decoded. JSON
+ * comes last, as the fallback.
+ */
+typedef struct meteo_format
+{
+  const char *query; // appended to the request
+  DeserializationError (*deserialize)(Stream &body, requested_data_t &r);
+} meteo_format_t;
+
+static const meteo_format_t METEO_FORMATS[] = {
+#if METEO_CSV
+  // the number of days is given, so the decoder knows the last row without
+  // waiting for the connection to close
+  {"&format=csv&forecast_days=" METEO_STR(METEO_NUM_DAILY),
+   deserialize_Meteo_CSV},
+#endif
+  {"", deserialize_Meteo_API},
+};
+
 /* Perform an HTTP GET request to meteo API
  * If data is received, it will be parsed and stored in the global variable
  * stored_datas.
@@ -156,10 +533,12 @@ bool waitForSNTPSync(tm *timeInfo)
   int attempts = 0;
   bool rxSuccess = false;
   DeserializationError jsonErr = {};
+  size_t format = 0;
 
-  String uri = "/v1/forecast?latitude=" + LAT + "&longitude=" + LON + "&daily=";
-  uri += "weather_code,temperature_2m_max,temperature_2m_min,precipitation_probability_max,wind_speed_10m_max,uv_index_max";
-  uri+= "&timezone=Europe%2FBerlin";
+  String baseUri = "/v1/forecast?latitude=" + LAT + "&longitude=" + LON + "&daily=";
+  baseUri += getMeteoDailyQuery();
+  baseUri+= "&timezone=Europe%2FBerlin";
+  String uri = baseUri + METEO_FORMATS[format].query;
 
   // This string is printed to terminal to help with debugging. The API key is
   // censored to reduce the risk of users exposing their key.
@@ -175,7 +554,8 @@ bool waitForSNTPSync(tm *timeInfo)
     if (connection_status != WL_CONNECTED)
     {
       // -512 offset distinguishes these errors from httpClient errors
-      return -512 - static_cast<int>(connection_status);
+      return endpointResult(API_METEO,
+                            -512 - static_cast<int>(connection_status));
     }
 
     HTTPClient http;
@@ -183,9 +563,22 @@ bool waitForSNTPSync(tm *timeInfo)
     http.useHTTP10(true); 
     http.setTimeout(HTTP_CLIENT_TCP_TIMEOUT); // default 5000ms
     http.begin(client, METEO_API_ENDPOINT, METEO_PORT, uri);
+    http.collectHeaders(RESPONSE_HEADERS,
+                        sizeof(RESPONSE_HEADERS) / sizeof(RESPONSE_HEADERS[0]));
+#if HTTP_GZIP
+    acceptGzip(http);
+#endif
+#if API_RESPONSE_CACHE
+    addCacheValidators(API_CACHE_METEO, uri, http);
+#endif
+    int64_t sentUs = esp_timer_get_time();
     httpResponse = http.GET();
-    if (httpResponse == HTTP_CODE_OK)
+    recordHttpDate(http.header("Date"), sentUs, esp_timer_get_time());
+    profileEnd(PHASE_FETCH_METEO, sentUs);
+    if (httpResponse == HTTP_CODE_OK
+     || httpResponse == HTTP_CODE_NOT_MODIFIED)
     {
+      int64_t parseStart = profileStart();
 
 
 #if 0
@@ -206,7 +599,30 @@ bool waitForSNTPSync(tm *timeInfo)
 
 
 
-      jsonErr = deserialize_Meteo_API(http.getStream(), r);
+#if DOWNLOAD_THEN_PARSE
+      MemoryStream &body = deferredBody(API_METEO);
+      if (httpResponse == HTTP_CODE_OK)
+      {
+        readBody(http, body);
+      }
+      jsonErr = deferResponse(API_METEO, API_CACHE_METEO, uri,
+                              getResponseHeaders(http), httpResponse,
+                              METEO_FORMATS[format].deserialize,
+                              PHASE_PARSE_METEO);
+#elif API_RESPONSE_CACHE
+      MemoryStream body(responseBuffers[API_CACHE_METEO],
+                        RESPONSE_BUFFER_SIZE);
+      if (httpResponse == HTTP_CODE_OK)
+      {
+        readBody(http, body);
+      }
+      jsonErr = deserializeCached(API_CACHE_METEO, uri,
+                                  getResponseHeaders(http), httpResponse,
+                                  body, METEO_FORMATS[format].deserialize, r);
+#else
+      jsonErr = deserializeBody(getResponseHeaders(http), http.getStream(),
+                                METEO_FORMATS[format].deserialize, r);
+#endif
 
 
       if (jsonErr)
@@ -215,14 +631,35 @@ bool waitForSNTPSync(tm *timeInfo)
         httpResponse = -256 - static_cast<int>(jsonErr.code());
       }
       rxSuccess = !jsonErr;
+#if DOWNLOAD_THEN_PARSE
+      // reading the body is part of the request, it is decoded later
+      profileEnd(PHASE_FETCH_METEO, parseStart);
+#else
+      profileEnd(PHASE_PARSE_METEO, parseStart);
+#endif
     }
     client.stop();
     http.end();
     Serial.println("  " + String(httpResponse, DEC) + " " + getHttpResponsePhrase(httpResponse));
     ++attempts;
+
+    // -256 offset: the response could not be decoded
+    bool rejected = httpResponse == HTTP_CODE_BAD_REQUEST
+                 || (httpResponse < -256 && httpResponse > -512);
+    if (rejected
+     && format + 1 < sizeof(METEO_FORMATS) / sizeof(METEO_FORMATS[0]))
+    { // fall back to the next format
+      ++format;
+      uri = baseUri + METEO_FORMATS[format].query;
+      Serial.println("  " + uri);
+    }
   }
 
-  return httpResponse;
+  if (httpResponse == HTTP_CODE_NOT_MODIFIED)
+  { // the values decoded from the previous response were kept
+    httpResponse = HTTP_CODE_OK;
+  }
+  return endpointResult(API_METEO, httpResponse);
 } // getMeteocall
 
 
@@ -278,7 +715,8 @@ void printHeapUsage() {
     if (connection_status != WL_CONNECTED)
     {
       // -512 offset distinguishes these errors from httpClient errors
-      return -512 - static_cast<int>(connection_status);
+      return endpointResult(API_DOMOTICZ_IDX,
+                            -512 - static_cast<int>(connection_status));
     }
 
     HTTPClient http;
@@ -287,11 +725,29 @@ void printHeapUsage() {
     http.setTimeout(HTTP_CLIENT_TCP_TIMEOUT); // default 5000ms
     http.begin(client, DOMOTICZ_API_ENDPOINT, DOMOTICZ_API_PORT, uri);
     //http.begin("http://192.168.1.1:8080" + uri);
+    http.collectHeaders(RESPONSE_HEADERS,
+                        sizeof(RESPONSE_HEADERS) / sizeof(RESPONSE_HEADERS[0]));
+#if HTTP_GZIP
+    acceptGzip(http);
+#endif
+    int64_t sentUs = esp_timer_get_time();
     httpResponse = http.GET();
+    recordHttpDate(http.header("Date"), sentUs, esp_timer_get_time());
+    profileEnd(PHASE_FETCH_DOMOTICZ_IDX, sentUs);
     if (httpResponse == HTTP_CODE_OK)
     {
+      int64_t parseStart = profileStart();
 
-      jsonErr = deserialize_Domoticz_API_IDX(http.getStream(), r);
+#if DOWNLOAD_THEN_PARSE
+      readBody(http, deferredBody(API_DOMOTICZ_IDX));
+      jsonErr = deferResponse(API_DOMOTICZ_IDX, API_CACHE_NONE, uri,
+                              getResponseHeaders(http), httpResponse,
+                              deserialize_Domoticz_API_IDX,
+                              PHASE_PARSE_DOMOTICZ_IDX);
+#else
+      jsonErr = deserializeBody(getResponseHeaders(http), http.getStream(),
+                                deserialize_Domoticz_API_IDX, r);
+#endif
 
       if (jsonErr)
       {
@@ -299,6 +755,12 @@ void printHeapUsage() {
         httpResponse = -256 - static_cast<int>(jsonErr.code());
       }
       rxSuccess = !jsonErr;
+#if DOWNLOAD_THEN_PARSE
+      // reading the body is part of the request, it is decoded later
+      profileEnd(PHASE_FETCH_DOMOTICZ_IDX, parseStart);
+#else
+      profileEnd(PHASE_PARSE_DOMOTICZ_IDX, parseStart);
+#endif
     }
     client.stop();
     http.end();
@@ -306,7 +768,7 @@ void printHeapUsage() {
     ++attempts;
   }
 
-  return httpResponse;
+  return endpointResult(API_DOMOTICZ_IDX, httpResponse);
 }
 
 /* Perform an HTTP GET request to Domoticz API
@@ -336,7 +798,8 @@ void printHeapUsage() {
     if (connection_status != WL_CONNECTED)
     {
       // -512 offset distinguishes these errors from httpClient errors
-      return -512 - static_cast<int>(connection_status);
+      return endpointResult(API_DOMOTICZ_GRAPH,
+                            -512 - static_cast<int>(connection_status));
     }
 
     HTTPClient http;
@@ -345,11 +808,47 @@ void printHeapUsage() {
     http.setTimeout(HTTP_CLIENT_TCP_TIMEOUT); // default 5000ms
     http.begin(client, DOMOTICZ_API_ENDPOINT, DOMOTICZ_API_PORT, uri);
     //http.begin("http://192.168.1.1:8080" + uri);
+    http.collectHeaders(RESPONSE_HEADERS,
+                        sizeof(RESPONSE_HEADERS) / sizeof(RESPONSE_HEADERS[0]));
+#if HTTP_GZIP
+    acceptGzip(http);
+#endif
+#if API_RESPONSE_CACHE
+    addCacheValidators(API_CACHE_DOMOTICZ_GRAPH, uri, http);
+#endif
+    int64_t sentUs = esp_timer_get_time();
     httpResponse = http.GET();
-    if (httpResponse == HTTP_CODE_OK)
+    recordHttpDate(http.header("Date"), sentUs, esp_timer_get_time());
+    profileEnd(PHASE_FETCH_DOMOTICZ_GRAPH, sentUs);
+    if (httpResponse == HTTP_CODE_OK
+     || httpResponse == HTTP_CODE_NOT_MODIFIED)
     {
+      int64_t parseStart = profileStart();
 
-      jsonErr = deserialize_Domoticz_API_GRAPH(http.getStream(), r);
+#if DOWNLOAD_THEN_PARSE
+      MemoryStream &body = deferredBody(API_DOMOTICZ_GRAPH);
+      if (httpResponse == HTTP_CODE_OK)
+      {
+        readBody(http, body);
+      }
+      jsonErr = deferResponse(API_DOMOTICZ_GRAPH, API_CACHE_DOMOTICZ_GRAPH, uri,
+                              getResponseHeaders(http), httpResponse,
+                              deserialize_Domoticz_API_GRAPH,
+                              PHASE_PARSE_DOMOTICZ_GRAPH);
+#elif API_RESPONSE_CACHE
+      MemoryStream body(responseBuffers[API_CACHE_DOMOTICZ_GRAPH],
+                        RESPONSE_BUFFER_SIZE);
+      if (httpResponse == HTTP_CODE_OK)
+      {
+        readBody(http, body);
+      }
+      jsonErr = deserializeCached(API_CACHE_DOMOTICZ_GRAPH, uri,
+                                  getResponseHeaders(http), httpResponse, body,
+                                  deserialize_Domoticz_API_GRAPH, r);
+#else
+      jsonErr = deserializeBody(getResponseHeaders(http), http.getStream(),
+                                deserialize_Domoticz_API_GRAPH, r);
+#endif
 
       if (jsonErr)
       {
@@ -357,6 +856,12 @@ void printHeapUsage() {
         httpResponse = -256 - static_cast<int>(jsonErr.code());
       }
       rxSuccess = !jsonErr;
+#if DOWNLOAD_THEN_PARSE
+      // reading the body is part of the request, it is decoded later
+      profileEnd(PHASE_FETCH_DOMOTICZ_GRAPH, parseStart);
+#else
+      profileEnd(PHASE_PARSE_DOMOTICZ_GRAPH, parseStart);
+#endif
     }
     client.stop();
     http.end();
@@ -364,6 +869,357 @@ void printHeapUsage() {
     ++attempts;
   }
 
-  return httpResponse;
+  if (httpResponse == HTTP_CODE_NOT_MODIFIED)
+  { // the values decoded from the previous response were kept
+    httpResponse = HTTP_CODE_OK;
+  }
+  return endpointResult(API_DOMOTICZ_GRAPH, httpResponse);
 }
 
+#if DOMOTICZ_KEEP_ALIVE
+/* Writes an HTTP/1.1 GET request for uri to Domoticz on client, connecting
+ * first unless the connection of the last request is still open. HTTPClient is
+ * not used for these requests: on HTTP/1.1 it always asks for an identity
+ * encoded response, see acceptGzip(). The request is made conditional with the
+ * validators of the response cache, unless cache is API_CACHE_NONE.
+ *
+ * Returns false if the connection could not be made or the request written.
+ */
+static bool sendDomoticzRequest(api_client_t &client, const String &uri,
+                                api_cache_id_t cache)
+{
+  if (!client.connected())
+  {
+    client.stop();
+    if (!client.connect(DOMOTICZ_API_ENDPOINT.c_str(), DOMOTICZ_API_PORT,
+                        HTTP_CLIENT_TCP_TIMEOUT))
+    {
+      return false;
+    }
+    client.setTimeout((HTTP_CLIENT_TCP_TIMEOUT + 500) / 1000); // seconds
+  }
+#if DEBUG_LEVEL >= 1
+  else
+  {
+    Serial.println("[debug] Reusing connection to " + DOMOTICZ_API_ENDPOINT
+                   + ":" + String(DOMOTICZ_API_PORT));
+  }
+#endif
+
+  String request = "GET " + uri + " HTTP/1.1\r\n"
+                   "Host: " + DOMOTICZ_API_ENDPOINT;
+  if (DOMOTICZ_API_PORT != 80 && DOMOTICZ_API_PORT != 443)
+  {
+    request += ":" + String(DOMOTICZ_API_PORT);
+  }
+  request += "\r\n"
+             "User-Agent: ESP32HTTPClient\r\n"
+             "Connection: keep-alive\r\n";
+#if HTTP_GZIP
+  request += "Accept-Encoding: gzip\r\n";
+#else
+  request += "Accept-Encoding: identity\r\n";
+#endif
+#if API_RESPONSE_CACHE
+  if (cache != API_CACHE_NONE)
+  {
+    request += cacheValidatorHeaders(cache, uri);
+  }
+#endif
+  request += "\r\n";
+  return client.write(reinterpret_cast<const uint8_t *>(request.c_str()),
+                      request.length()) == request.length();
+} // end sendDomoticzRequest
+
+/* Perform an HTTP GET request to Domoticz API over the persistent connection
+ * held by client. The response body is passed to the given deserializer,
+ * through the response cache unless cache is API_CACHE_NONE. The request and
+ * its parsing are profiled as fetchPhase and parsePhase, and its status is
+ * recorded as that of endpoint.
+ *
+ * Returns the HTTP Status Code.
+ */
+static int getDomoticzKeepAlive(api_client_t &client, const String &uri,
+  api_cache_id_t cache,
+  DeserializationError (*deserialize)(Stream &json, requested_data_t &r),
+  requested_data_t &r, profile_phase_t fetchPhase, profile_phase_t parsePhase,
+  api_endpoint_t endpoint)
+{
+  int attempts = 0;
+  bool rxSuccess = false;
+  DeserializationError jsonErr = {};
+
+  Serial.print(TXT_ATTEMPTING_HTTP_REQ);
+  Serial.println(": " + uri);
+  int httpResponse = 0;
+  while (!rxSuccess && attempts < 3)
+  {
+    wl_status_t connection_status = WiFi.status();
+    if (connection_status != WL_CONNECTED)
+    {
+      // -512 offset distinguishes these errors from httpClient errors
+      return endpointResult(endpoint,
+                            -512 - static_cast<int>(connection_status));
+    }
+
+    int64_t sentUs = esp_timer_get_time();
+    response_head_t head = {};
+    head.status = HTTPC_ERROR_CONNECTION_REFUSED;
+    if (sendDomoticzRequest(client, uri, cache))
+    {
+      readResponseHead(client, head);
+    }
+    httpResponse = head.status;
+    recordHttpDate(head.date, sentUs, esp_timer_get_time());
+    profileEnd(fetchPhase, sentUs);
+    bool reusable = false;
+    if (httpResponse == HTTP_CODE_OK
+     || httpResponse == HTTP_CODE_NOT_MODIFIED)
+    {
+      int64_t parseStart = profileStart();
+      // a 304 response never has a body
+      HttpBodyStream body(client, httpResponse == HTTP_CODE_OK && head.chunked,
+                          httpResponse == HTTP_CODE_OK ? head.contentLength : 0);
+
+#if DOWNLOAD_THEN_PARSE
+      drainBody(body, deferredBody(endpoint));
+      jsonErr = deferResponse(endpoint, cache, uri, head.headers, httpResponse,
+                              deserialize, parsePhase);
+#else
+  #if API_RESPONSE_CACHE
+      if (cache != API_CACHE_NONE)
+      {
+        MemoryStream buffered(responseBuffers[cache], RESPONSE_BUFFER_SIZE);
+        drainBody(body, buffered);
+        jsonErr = deserializeCached(cache, uri, head.headers, httpResponse,
+                                    buffered, deserialize, r);
+      }
+      else
+  #endif
+      {
+        jsonErr = deserializeBody(head.headers, body, deserialize, r);
+      }
+#endif
+
+      if (jsonErr)
+      {
+        // -256 offset distinguishes these errors from httpClient errors
+        httpResponse = -256 - static_cast<int>(jsonErr.code());
+      }
+      rxSuccess = !jsonErr;
+#if DOWNLOAD_THEN_PARSE
+      // reading the body is part of the request, it is decoded later
+      profileEnd(fetchPhase, parseStart);
+#else
+      profileEnd(parsePhase, parseStart);
+#endif
+      // the connection can only be reused once the whole body has been read
+      reusable = body.finish() && head.keepAlive;
+    }
+    if (!reusable)
+    {
+      client.stop();
+    }
+    Serial.println("  " + String(httpResponse, DEC) + " " + getHttpResponsePhrase(httpResponse));
+    ++attempts;
+  }
+
+  if (httpResponse == HTTP_CODE_NOT_MODIFIED)
+  { // the values decoded from the previous response were kept
+    httpResponse = HTTP_CODE_OK;
+  }
+  return endpointResult(endpoint, httpResponse);
+} // end getDomoticzKeepAlive
+
+/* Perform both HTTP GET requests to Domoticz API over a single persistent
+ * HTTP/1.1 connection.
+ * If data is received, it will be parsed and stored in the global variable
+ * stored_datas.
+ *
+ * Returns the HTTP Status Code of the first request that failed.
+ */
+int getDomoticzcalls(api_client_t &client, requested_data_t &r)
+{
+  String uriIdx = "/json.htm?type=command&param=getdevices&rid=" + DOMOTICZ_API_IDX;
+  String uriGraph = "/json.htm?type=command&param=graph&sensor=counter&idx=34&range=month";
+
+  int httpResponse = getDomoticzKeepAlive(client, uriIdx, API_CACHE_NONE,
+                                          deserialize_Domoticz_API_IDX, r,
+                                          PHASE_FETCH_DOMOTICZ_IDX,
+                                          PHASE_PARSE_DOMOTICZ_IDX,
+                                          API_DOMOTICZ_IDX);
+  // the graph is requested even if the first request failed, so whatever
+  // can be received is
+  int graphResponse = getDomoticzKeepAlive(client, uriGraph,
+                                           API_CACHE_DOMOTICZ_GRAPH,
+                                           deserialize_Domoticz_API_GRAPH, r,
+                                           PHASE_FETCH_DOMOTICZ_GRAPH,
+                                           PHASE_PARSE_DOMOTICZ_GRAPH,
+                                           API_DOMOTICZ_GRAPH);
+  if (httpResponse == HTTP_CODE_OK)
+  {
+    httpResponse = graphResponse;
+  }
+  client.stop();
+
+  return httpResponse;
+} // end getDomoticzcalls
+#endif
+
+/* Sets up a client according to the HTTP mode selected in config.h.
+ */
+static void initApiClient(api_client_t &client)
+{
+#if defined(USE_HTTPS_NO_CERT_VERIF)
+  client.setInsecure();
+#elif defined(USE_HTTPS_WITH_CERT_VERIF)
+  client.setCACert(cert_Sectigo_RSA_Organization_Validation_Secure_Server_CA);
+#endif
+  return;
+} // end initApiClient
+
+/*
+ * The API requests made by getApiData(), in order.
+ */
+static int (*const apiCalls[])(api_client_t &client, requested_data_t &r) = {
+  getMeteocall,
+#if DOMOTICZ_KEEP_ALIVE
+  getDomoticzcalls,
+#else
+  getDomoticzcall_IDX,
+  getDomoticzcall_GRAPH,
+#endif
+};
+static const int API_CALL_COUNT = sizeof(apiCalls) / sizeof(apiCalls[0]);
+
+/* Makes one API request on client.
+ *
+ * Returns how long the request took, in microseconds.
+ */
+static int64_t timeApiCall(int (*call)(api_client_t &client,
+                                       requested_data_t &r),
+                           api_client_t &client, requested_data_t &r)
+{
+  int64_t start = esp_timer_get_time();
+  call(client, r);
+  return esp_timer_get_time() - start;
+} // end timeApiCall
+
+#if CONCURRENT_FETCH
+/*
+ * One API request to be made from its own task.
+ */
+typedef struct fetch_job
+{
+  int (*call)(api_client_t &client, requested_data_t &r);
+  requested_data_t *data;
+  SemaphoreHandle_t done;
+  int64_t us; // how long the request took
+} fetch_job_t;
+
+/* FreeRTOS task that makes one API request, on its own client and socket,
+ * then deletes itself.
+ *
+ * Each request only writes its own members of requested_data_t, so the jobs
+ * can safely share it.
+ */
+static void fetchTask(void *pvParameters)
+{
+  fetch_job_t *job = static_cast<fetch_job_t *>(pvParameters);
+  {
+    api_client_t client;
+    initApiClient(client);
+    job->us = timeApiCall(job->call, client, *job->data);
+  } // client must be destroyed before the task is deleted
+  xSemaphoreGive(job->done);
+  vTaskDelete(NULL);
+} // end fetchTask
+#endif
+
+#if DEBUG_LEVEL >= 1
+/* Prints how long the API requests took together, wallUs, and one after
+ * another, callUs. The line is the same with and without CONCURRENT_FETCH, so
+ * both builds can be compared against the same servers.
+ */
+static void printFetchTimes(int64_t wallUs, const int64_t callUs[])
+{
+  int64_t sumUs = 0;
+  String calls;
+  for (int i = 0; i < API_CALL_COUNT; ++i)
+  {
+    sumUs += callUs[i];
+    if (i > 0)
+    {
+      calls += ", ";
+    }
+    calls += String(static_cast<long>(callUs[i] / 1000));
+  }
+  Serial.println("[debug] API requests took : "
+                 + String(static_cast<long>(wallUs / 1000)) + " ms, requests "
+                 + calls + " ms (sum " + String(static_cast<long>(sumUs / 1000))
+                 + " ms, concurrent " + String(CONCURRENT_FETCH) + ")");
+  return;
+} // end printFetchTimes
+#endif
+
+/* Performs all API requests, the results are parsed and stored in r.
+ * With CONCURRENT_FETCH the requests are all kept in flight at once, otherwise
+ * they are made one after another. Every endpoint is requested even if another
+ * fails, and the HTTP Status Code of each is stored in status.
+ *
+ * Returns HTTP_CODE_OK if every request succeeded, otherwise the HTTP Status
+ * Code of the first request that failed.
+ */
+int getApiData(requested_data_t &r, int status[API_ENDPOINT_COUNT])
+{
+  int64_t fetchStart __attribute__((unused)) = esp_timer_get_time();
+  int64_t callUs[API_CALL_COUNT] __attribute__((unused));
+  int rxStatus = HTTP_CODE_OK;
+
+#if CONCURRENT_FETCH
+  fetch_job_t jobs[API_CALL_COUNT];
+
+  for (int i = 0; i < API_CALL_COUNT; ++i)
+  {
+    fetch_job_t &job = jobs[i];
+    job = {apiCalls[i], &r, xSemaphoreCreateBinary(), 0};
+    if (xTaskCreate(fetchTask, "fetch", FETCH_TASK_STACK, &job, 1, NULL)
+        != pdPASS)
+    { // not enough memory for another task, make this request now
+      api_client_t client;
+      initApiClient(client);
+      job.us = timeApiCall(job.call, client, r);
+      xSemaphoreGive(job.done);
+    }
+  }
+
+  for (int i = 0; i < API_CALL_COUNT; ++i)
+  {
+    xSemaphoreTake(jobs[i].done, portMAX_DELAY);
+    vSemaphoreDelete(jobs[i].done);
+    callUs[i] = jobs[i].us;
+  }
+#else
+  api_client_t client;
+  initApiClient(client);
+
+  for (int i = 0; i < API_CALL_COUNT; ++i)
+  {
+    callUs[i] = timeApiCall(apiCalls[i], client, r);
+  }
+#endif
+
+  for (int i = 0; i < API_ENDPOINT_COUNT; ++i)
+  {
+    status[i] = endpointStatus[i];
+    if (rxStatus == HTTP_CODE_OK)
+    {
+      rxStatus = status[i];
+    }
+  }
+
+#if DEBUG_LEVEL >= 1
+  printFetchTimes(esp_timer_get_time() - fetchStart, callUs);
+#endif
+  return rxStatus;
+} // end getApiData
@@ -0,0 +1,184 @@
+/* Clock model for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include "clock_model.h"
+
+static const uint32_t CLOCK_MODEL_MAGIC = 0x434C4B31; // "CLK1"
+// Drift assumed until it has been measured. This is the correction that used
+// to be applied to every esp32, as many have fast RTCs.
+static const float DEFAULT_DRIFT_PPM = 1500.f;
+// The drift is never assumed to be known better than this, the frequency of
+// the RTC changes with temperature.
+static const float MIN_DRIFT_ERROR_PPM = 20.f;
+// Measurements over a shorter period, or of a larger drift (i.e. the clock was
+// reset), are discarded.
+static const int64_t MIN_DRIFT_PERIOD_US = 10 * 60 * 1000000LL;
+static const float MAX_DRIFT_PPM = 10000.f;
+// Weight of a new measurement, once the first few have been averaged.
+static const float DRIFT_SMOOTHING = 0.25f;
+
+/* Forgets everything learned about the clock.
+ */
+void clockModelReset(clock_model_t &m)
+{
+  m.magic          = 0;
+  m.syncUs         = 0;
+  m.correctionUs   = 0;
+  m.driftPpm       = DEFAULT_DRIFT_PPM;
+  m.driftErrorPpm  = DEFAULT_DRIFT_PPM;
+  m.samples        = 0;
+  m.wakesSinceSync = 0;
+  return;
+} // end clockModelReset
+
+/* Returns true once the model has been synchronized.
+ */
+bool clockModelValid(const clock_model_t &m)
+{
+  return m.magic == CLOCK_MODEL_MAGIC;
+} // end clockModelValid
+
+/* Returns the learned drift rate, or the default one if nothing was learned
+ * yet.
+ */
+float clockModelDriftPpm(const clock_model_t &m)
+{
+  return clockModelValid(m) ? m.driftPpm : DEFAULT_DRIFT_PPM;
+} // end clockModelDriftPpm
+
+/* Returns the correction to apply to the clock, currently reading clockUs, so
+ * that it accounts for the drift since the last synchronization.
+ */
+int64_t clockModelCorrectionUs(const clock_model_t &m, int64_t clockUs)
+{
+  if (m.magic != CLOCK_MODEL_MAGIC)
+  {
+    return 0;
+  }
+  // time elapsed since the synchronization, as counted by the RTC
+  const double rtcElapsedUs = static_cast<double>(clockUs - m.correctionUs
+                                                  - m.syncUs);
+  const double gainUs = rtcElapsedUs * m.driftPpm / (1e6 + m.driftPpm);
+  return -std::llround(gainUs) - m.correctionUs;
+} // end clockModelCorrectionUs
+
+/* Returns how far off the corrected clock is expected to be, when reading
+ * clockUs.
+ */
+int64_t clockModelPredictedErrorUs(const clock_model_t &m, int64_t clockUs)
+{
+  if (m.magic != CLOCK_MODEL_MAGIC)
+  {
+    return INT64_MAX;
+  }
+  const double elapsedUs = static_cast<double>(clockUs - m.syncUs);
+  return std::llround(std::fabs(elapsedUs) * m.driftErrorPpm / 1e6);
+} // end clockModelPredictedErrorUs
+
+/* Returns true if the clock must be synchronized: it never was, it was reset,
+ * syncInterval wakes have passed since the last synchronization, or its
+ * predicted error exceeds maxErrorUs.
+ */
+bool clockModelNeedsSync(const clock_model_t &m, int64_t clockUs,
+                         int syncInterval, int64_t maxErrorUs)
+{
+  return m.magic != CLOCK_MODEL_MAGIC
+      || clockUs < m.syncUs
+      || m.wakesSinceSync + 1 >= syncInterval
+      || clockModelPredictedErrorUs(m, clockUs) > maxErrorUs;
+} // end clockModelNeedsSync
+
+/* Learns from a synchronization that set the clock, reading clockUs, to the
+ * true time trueUs.
+ */
+void clockModelSynced(clock_model_t &m, int64_t clockUs, int64_t trueUs)
+{
+  if (m.magic == CLOCK_MODEL_MAGIC)
+  {
+    const int64_t periodUs = trueUs - m.syncUs;
+    // time gained by the RTC, without the corrections made since
+    const double gainUs = static_cast<double>(clockUs - m.correctionUs
+                                              - trueUs);
+    const float measuredPpm = periodUs > 0 ? gainUs * 1e6 / periodUs : 0.f;
+
+    if (periodUs >= MIN_DRIFT_PERIOD_US
+     && std::fabs(measuredPpm) <= MAX_DRIFT_PPM)
+    {
+      // average the first measurements, then smooth
+      const float weight = m.samples < 4 ? 1.f / (m.samples + 1)
+                                         : DRIFT_SMOOTHING;
+      const float errorPpm = std::fabs(measuredPpm - m.driftPpm);
+      m.driftPpm      += weight * (measuredPpm - m.driftPpm);
+      m.driftErrorPpm += weight * (errorPpm - m.driftErrorPpm);
+      m.driftErrorPpm  = std::max(m.driftErrorPpm, MIN_DRIFT_ERROR_PPM);
+      ++m.samples;
+    }
+  }
+  else
+  {
+    clockModelReset(m);
+  }
+
+  m.magic          = CLOCK_MODEL_MAGIC;
+  m.syncUs         = trueUs;
+  m.correctionUs   = 0;
+  m.wakesSinceSync = 0;
+  return;
+} // end clockModelSynced
+
+/* Parses an HTTP date in the preferred IMF-fixdate format, e.g.
+ * "Sun, 06 Nov 1994 08:49:37 GMT", into seconds since the Unix epoch.
+ *
+ * Returns true if the date was valid.
+ */
+bool parseHttpDate(const char *date, int64_t &epochS)
+{
+  static const char MONTHS[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+  char month[4] = {};
+  int day, year, hour, min, sec;
+  int end = 0; // only set if the trailing "GMT" matched
+  if (sscanf(date, "%*3s, %2d %3s %4d %2d:%2d:%2d GMT%n",
+             &day, month, &year, &hour, &min, &sec, &end) != 6 || end == 0)
+  {
+    return false;
+  }
+  const char *m = strstr(MONTHS, month);
+  if (m == NULL || strlen(month) != 3 || (m - MONTHS) % 3 != 0
+   || day < 1 || day > 31 || year < 1970 || hour > 23 || min > 59 || sec > 60)
+  {
+    return false;
+  }
+
+  // days since the epoch of the civil date, counting years from March so the
+  // leap day is the last day of the year
+  int mon = (m - MONTHS) / 3 + 1;
+  int y = year - (mon <= 2);
+  const int era = y / 400;
+  const int yoe = y - era * 400;
+  const int doy = (153 * (mon + (mon > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  const int64_t days = era * 146097LL + doe - 719468;
+
+  epochS = days * 86400 + hour * 3600 + min * 60 + sec;
+  return true;
+} // end parseHttpDate
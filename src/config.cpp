@@ -42,6 +42,13 @@ const uint8_t PIN_EPD_PWR  = 26; // Irrelevant if directly connected to 3.3V
 const char *WIFI_SSID     = "xxxxxxxxxxx";
 const char *WIFI_PASSWORD = "xxxxxxxxxxxxxxxxxxxx";
 const unsigned long WIFI_TIMEOUT = 10000; // ms, WiFi connection timeout.
+// ms, timeout of a reconnect using the cached access point and DHCP lease
+// (see WIFI_FAST_RECONNECT in config.h), before falling back to a full scan.
+const unsigned long WIFI_FAST_TIMEOUT = 3000;
+// s, age after which the cached DHCP lease is renewed with a full connection.
+// Keep it well under the lease time of the router, half of it or less; 12 hours
+// suits the common 24 hour lease.
+const unsigned long WIFI_CACHE_MAX_AGE = 12 * 60 * 60;
 
 // HTTP
 // The following errors are likely the result of insuffient http client tcp 
@@ -95,6 +102,12 @@ const char *NTP_SERVER_2 = "time.nist.gov";
 // If you encounter the 'Failed To Fetch The Time' error, try increasing
 // NTP_TIMEOUT or select closer/lower latency time servers.
 const unsigned long NTP_TIMEOUT = 20000; // ms
+// The RTC keeps time during deep sleep, and its drift is learned from each NTP
+// synchronization. NTP servers are only queried every NTP_SYNC_INTERVAL wakes,
+// or sooner if the clock is expected to be off by more than
+// NTP_MAX_PREDICTED_ERROR. Set NTP_SYNC_INTERVAL to 1 to query them every wake.
+const int NTP_SYNC_INTERVAL = 12;
+const unsigned long NTP_MAX_PREDICTED_ERROR = 2000; // ms
 // Sleep duration in minutes. (aka how often esp32 will wake for an update)
 // Aligned to the nearest minute boundary.
 // For example, if set to 30 (minutes) the display will update at 00 or 30
@@ -115,6 +128,18 @@ const int WAKE_TIME = 06; // Hour of first update after BED_TIME, 06:00.
 // SLEEP_DURATION = 1440, and you can set the time it should update each day by
 // setting both BED_TIME and WAKE_TIME to the hour you want it to update.
 
+// FULL REFRESH INTERVAL
+// With PARTIAL_REFRESH (see config.h), number of partial refreshes between two
+// full refreshes of the panel. Partial refreshes of colour panels slowly leave
+// ghosting behind, which a full refresh clears.
+const int FULL_REFRESH_INTERVAL = 12;
+
+// STALE DATA
+// With STALE_DATA_FALLBACK (see config.h), seconds the data last received from
+// an endpoint is still drawn for when its request fails. Older data is not
+// drawn, the error screen is shown instead.
+const int STALE_DATA_MAX_AGE = 24 * 60 * 60; // 24 hours
+
 // HOURLY OUTLOOK GRAPH
 // Number of hours to display on the outlook graph. (range: [8-48])
 const int HOURLY_GRAPH_MAX = 24;
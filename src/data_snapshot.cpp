@@ -0,0 +1,88 @@
+/* Decoded data snapshot for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstddef>
+#include <cstring>
+#include <Arduino.h>
+#include <esp32/rom/crc.h>
+
+#include "config.h"
+#include "data_snapshot.h"
+#include "snapshot_codec.h"
+
+RTC_DATA_ATTR static uint8_t meteoSnapshot[METEO_SNAPSHOT_SIZE] = {};
+RTC_DATA_ATTR static uint8_t idxSnapshot[IDX_SNAPSHOT_SIZE] = {};
+RTC_DATA_ATTR static uint8_t graphSnapshot[GRAPH_SNAPSHOT_SIZE] = {};
+
+static uint8_t *const SNAPSHOTS[API_ENDPOINT_COUNT] = {
+  meteoSnapshot, idxSnapshot, graphSnapshot
+};
+static const size_t SNAPSHOT_SIZE[API_ENDPOINT_COUNT] = {
+  METEO_SNAPSHOT_SIZE, IDX_SNAPSHOT_SIZE, GRAPH_SNAPSHOT_SIZE
+};
+
+const char *API_ENDPOINT_NAMES[API_ENDPOINT_COUNT] = {
+  "Open-Meteo", "Domoticz", "Domoticz graph"
+};
+
+/* CRC of the snapshots, from the ROM.
+ */
+static uint32_t romCrc32(uint32_t crc, const uint8_t *buf, size_t len)
+{
+  return crc32_le(crc, buf, len);
+} // end romCrc32
+
+/* Keeps the members of r decoded from endpoint in RTC memory, as received at
+ * the time fetched.
+ */
+void saveSnapshot(api_endpoint_t endpoint, const requested_data_t &r,
+                  time_t fetched)
+{
+  uint8_t *snapshot = SNAPSHOTS[endpoint];
+  size_t length = encodeSnapshot(endpoint, r, fetched, snapshot,
+                                 SNAPSHOT_SIZE[endpoint], romCrc32);
+  if (length == 0)
+  { // drop the previous snapshot, it is older than what was drawn
+    memset(snapshot, 0, sizeof(snapshot_header_t));
+  }
+#if DEBUG_LEVEL >= 1
+  Serial.println(String("[debug] ") + API_ENDPOINT_NAMES[endpoint]
+                 + " snapshot : " + String(length) + " B");
+#endif
+  return;
+} // end saveSnapshot
+
+/* Restores the members of r decoded from endpoint, from its snapshot in RTC
+ * memory. The time they were received is stored in fetched, if not NULL.
+ *
+ * Returns false if no valid snapshot of the endpoint is kept.
+ */
+bool loadSnapshot(api_endpoint_t endpoint, requested_data_t &r,
+                  time_t *fetched)
+{
+  int64_t fetchedS;
+  if (!decodeSnapshot(endpoint, SNAPSHOTS[endpoint], SNAPSHOT_SIZE[endpoint],
+                      r, &fetchedS, romCrc32))
+  {
+    return false;
+  }
+  if (fetched != NULL)
+  {
+    *fetched = static_cast<time_t>(fetchedS);
+  }
+  return true;
+} // end loadSnapshot
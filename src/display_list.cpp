@@ -0,0 +1,249 @@
+/* Display list recorder for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <Arduino.h>
+#include <Adafruit_GFX.h>
+
+#include "display_list.h"
+
+DisplayList::DisplayList(int16_t w, int16_t h) : Adafruit_GFX(w, h)
+{
+  // enough for a dashboard without reallocating
+  _commands.reserve(256);
+  _text.reserve(1024);
+}
+
+/* Appends a command covering x0 <= x < x1, y0 <= y < y1.
+ */
+dl_command_t &DisplayList::add(dl_command_type_t type, uint16_t color,
+                               int16_t x0, int16_t y0, int16_t x1, int16_t y1)
+{
+  _commands.push_back({});
+  dl_command_t &command = _commands.back();
+  command.type  = type;
+  command.color = color;
+  command.x0    = x0;
+  command.y0    = y0;
+  command.x1    = x1;
+  command.y1    = y1;
+  return command;
+} // end add
+
+void DisplayList::drawPixel(int16_t x, int16_t y, uint16_t color)
+{
+  add(DL_PIXEL, color, x, y, x + 1, y + 1);
+  return;
+} // end drawPixel
+
+void DisplayList::drawFastHLine(int16_t x, int16_t y, int16_t w,
+                                uint16_t color)
+{
+  if (w > 0)
+  {
+    add(DL_HLINE, color, x, y, x + w, y + 1);
+  }
+  return;
+} // end drawFastHLine
+
+void DisplayList::drawFastVLine(int16_t x, int16_t y, int16_t h,
+                                uint16_t color)
+{
+  if (h > 0)
+  {
+    add(DL_VLINE, color, x, y, x + 1, y + h);
+  }
+  return;
+} // end drawFastVLine
+
+void DisplayList::fillRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                           uint16_t color)
+{
+  if (w > 0 && h > 0)
+  {
+    add(DL_FILL_RECT, color, x, y, x + w, y + h);
+  }
+  return;
+} // end fillRect
+
+void DisplayList::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                           uint16_t color)
+{
+  dl_command_t &command = add(DL_LINE, color,
+                              std::min(x0, x1), std::min(y0, y1),
+                              std::max(x0, x1) + 1, std::max(y0, y1) + 1);
+  command.arg[0] = x0;
+  command.arg[1] = y0;
+  command.arg[2] = x1;
+  command.arg[3] = y1;
+  return;
+} // end drawLine
+
+void DisplayList::drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                                int16_t r, uint16_t color)
+{
+  if (w > 0 && h > 0)
+  {
+    add(DL_ROUND_RECT, color, x, y, x + w, y + h).arg[0] = r;
+  }
+  return;
+} // end drawRoundRect
+
+void DisplayList::fillRoundRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                                int16_t r, uint16_t color)
+{
+  if (w > 0 && h > 0)
+  {
+    add(DL_FILL_ROUND_RECT, color, x, y, x + w, y + h).arg[0] = r;
+  }
+  return;
+} // end fillRoundRect
+
+void DisplayList::drawInvertedBitmap(int16_t x, int16_t y,
+                                     const uint8_t bitmap[],
+                                     int16_t w, int16_t h, uint16_t color)
+{
+  if (w > 0 && h > 0)
+  {
+    add(DL_INVERTED_BITMAP, color, x, y, x + w, y + h).data = bitmap;
+  }
+  return;
+} // end drawInvertedBitmap
+
+/* Records a bar shaded with every other pixel of every other row, starting from
+ * the bottom row (y1 - 1) and excluding row y0. The bounding box covers exactly
+ * the shaded pixels, see replayAlphaBar() in display_list.h.
+ */
+void DisplayList::drawAlphaBar(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                               uint16_t color)
+{
+  const int16_t xStart = x0 + (x0 % 2);
+  if (xStart < x1 && y1 - 1 > y0)
+  {
+    add(DL_ALPHA_BAR, color, xStart, y0 + 1, x1, y1);
+  }
+  return;
+} // end drawAlphaBar
+
+void DisplayList::drawDottedHLine(int16_t x0, int16_t x1, int16_t y,
+                                  int16_t step, uint16_t color)
+{
+  if (x0 <= x1 && step > 0)
+  {
+    add(DL_DOTTED_HLINE, color, x0, y, x1 + 1, y + 1).arg[0] = step;
+  }
+  return;
+} // end drawDottedHLine
+
+size_t DisplayList::write(uint8_t c)
+{
+  return write(&c, 1);
+} // end write
+
+/* Records the text as a single command and advances the cursor past it, the
+ * same way Adafruit_GFX does when wrapping is disabled. The bounding box is the
+ * union of the glyphs, text without any visible glyph is not recorded.
+ */
+size_t DisplayList::write(const uint8_t *buffer, size_t size)
+{
+  const int16_t cursorX = cursor_x;
+  const int16_t cursorY = cursor_y;
+  int16_t x0 = INT16_MAX, y0 = INT16_MAX, x1 = INT16_MIN, y1 = INT16_MIN;
+
+  for (size_t i = 0; i < size; ++i)
+  {
+    const uint8_t c = buffer[i];
+    if (c == '\n')
+    {
+      cursor_x = 0;
+      cursor_y += gfxFont ? gfxFont->yAdvance : 8;
+      continue;
+    }
+    if (c == '\r')
+    {
+      continue;
+    }
+
+    if (gfxFont == NULL)
+    { // built-in 6x8 font
+      x0 = std::min(x0, cursor_x);
+      y0 = std::min(y0, cursor_y);
+      x1 = std::max<int16_t>(x1, cursor_x + 6);
+      y1 = std::max<int16_t>(y1, cursor_y + 8);
+      cursor_x += 6;
+    }
+    else if (c >= gfxFont->first && c <= gfxFont->last)
+    {
+      const GFXglyph &glyph = gfxFont->glyph[c - gfxFont->first];
+      if (glyph.width > 0 && glyph.height > 0)
+      {
+        const int16_t gx = cursor_x + glyph.xOffset;
+        const int16_t gy = cursor_y + glyph.yOffset;
+        x0 = std::min(x0, gx);
+        y0 = std::min(y0, gy);
+        x1 = std::max<int16_t>(x1, gx + glyph.width);
+        y1 = std::max<int16_t>(y1, gy + glyph.height);
+      }
+      cursor_x += glyph.xAdvance;
+    }
+  }
+
+  if (x0 < x1)
+  {
+    const size_t offset = _text.size();
+    _text.insert(_text.end(), buffer, buffer + size);
+    dl_command_t &command = add(DL_TEXT, textcolor, x0, y0, x1, y1);
+    command.arg[0] = cursorX;
+    command.arg[1] = cursorY;
+    command.arg[2] = static_cast<int16_t>(offset);
+    command.arg[3] = static_cast<int16_t>(size);
+    command.data   = gfxFont;
+  }
+  return size;
+} // end write
+
+/* Forgets the recorded commands, keeping the memory for the next frame.
+ */
+void DisplayList::clear()
+{
+  _commands.clear();
+  _text.clear();
+  return;
+} // end clear
+
+size_t DisplayList::size() const
+{
+  return _commands.size();
+} // end size
+
+const dl_command_t &DisplayList::operator[](size_t i) const
+{
+  return _commands[i];
+} // end operator[]
+
+const GFXfont *DisplayList::getFont() const
+{
+  return gfxFont;
+} // end getFont
+
+/* Returns the text of a DL_TEXT command, command.arg[3] characters long and
+ * not null-terminated.
+ */
+const char *DisplayList::text(const dl_command_t &command) const
+{
+  return _text.data() + static_cast<uint16_t>(command.arg[2]);
+} // end text
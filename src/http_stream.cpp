@@ -0,0 +1,707 @@
+/* HTTP body stream for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <Arduino.h>
+
+#include "http_stream.h"
+
+HttpBodyStream::HttpBodyStream(Stream &src, bool chunked, int contentLength)
+  : _src(src), _chunked(chunked), _remaining(chunked ? 0 : contentLength),
+    _peeked(-1), _eof(!chunked && contentLength == 0), _error(false)
+{
+  setTimeout(src.getTimeout());
+}
+
+/* Reads one byte from the connection, waiting up to its timeout.
+ *
+ * Returns -1 on timeout.
+ */
+int HttpBodyStream::srcRead()
+{
+  uint8_t c;
+  if (_src.readBytes(&c, 1) != 1)
+  {
+    return -1;
+  }
+  return c;
+} // end srcRead
+
+/* Reads one line from the connection, without its line ending. Characters
+ * that do not fit in buf are dropped.
+ *
+ * Returns the length of the line, or -1 on timeout.
+ */
+int HttpBodyStream::readLine(char *buf, size_t size)
+{
+  size_t len = 0;
+  int c;
+  while ((c = srcRead()) != '\n')
+  {
+    if (c < 0)
+    {
+      return -1;
+    }
+    if (c != '\r' && len < size - 1)
+    {
+      buf[len++] = static_cast<char>(c);
+    }
+  }
+  buf[len] = '\0';
+  return len;
+} // end readLine
+
+/* Reads the next chunk-size line, and the trailer if this is the last chunk.
+ * Chunk extensions are ignored.
+ *
+ * Returns true if there is chunk data to read.
+ */
+bool HttpBodyStream::beginChunk()
+{
+  char line[20];
+  int len = readLine(line, sizeof(line));
+  if (len == 0)
+  { // CRLF terminating the data of the previous chunk
+    len = readLine(line, sizeof(line));
+  }
+
+  char *end;
+  unsigned long size = len > 0 ? strtoul(line, &end, 16) : 0;
+  if (len <= 0 || end == line)
+  {
+    _error = true;
+    return false;
+  }
+
+  if (size == 0)
+  { // last chunk, skip the trailer up to the empty line
+    do
+    {
+      len = readLine(line, sizeof(line));
+    } while (len > 0);
+    _error = len < 0;
+    _eof = true;
+    return false;
+  }
+
+  _remaining = static_cast<int32_t>(size);
+  return true;
+} // end beginChunk
+
+/* Returns the next byte of the body, or -1 once the body has ended or failed.
+ */
+int HttpBodyStream::nextByte()
+{
+  if (_eof || _error)
+  {
+    return -1;
+  }
+  if (_chunked && _remaining == 0 && !beginChunk())
+  {
+    return -1;
+  }
+
+  int c = srcRead();
+  if (c < 0)
+  {
+    if (!_chunked && _remaining < 0)
+    { // no Content-Length, the body ends when the server closes the connection
+      _eof = true;
+    }
+    else
+    {
+      _error = true;
+    }
+    return -1;
+  }
+
+  if (_remaining > 0 && --_remaining == 0 && !_chunked)
+  {
+    _eof = true;
+  }
+  return c;
+} // end nextByte
+
+int HttpBodyStream::available()
+{
+  if (_peeked >= 0)
+  {
+    return 1;
+  }
+  if (_eof || _error || _remaining == 0)
+  {
+    return 0;
+  }
+  int avail = _src.available();
+  if (_remaining > 0 && avail > _remaining)
+  {
+    avail = _remaining;
+  }
+  return avail;
+} // end available
+
+int HttpBodyStream::read()
+{
+  if (_peeked >= 0)
+  {
+    int c = _peeked;
+    _peeked = -1;
+    return c;
+  }
+  return nextByte();
+} // end read
+
+int HttpBodyStream::peek()
+{
+  if (_peeked < 0)
+  {
+    _peeked = nextByte();
+  }
+  return _peeked;
+} // end peek
+
+size_t HttpBodyStream::readBytes(char *buffer, size_t length)
+{
+  size_t count = 0;
+  while (count < length)
+  {
+    int c = read();
+    if (c < 0)
+    {
+      break;
+    }
+    buffer[count++] = static_cast<char>(c);
+  }
+  return count;
+} // end readBytes
+
+size_t HttpBodyStream::write(uint8_t)
+{
+  return 0; // read only
+} // end write
+
+/* Consumes what is left of the body, so the connection is positioned at the
+ * start of the next response.
+ *
+ * Returns true if the whole body was received and the framing was valid.
+ */
+bool HttpBodyStream::finish()
+{
+  while (read() >= 0)
+  {
+  }
+  return _eof && !_error;
+} // end finish
+
+bool HttpBodyStream::failed() const
+{
+  return _error;
+} // end failed
+
+MemoryStream::MemoryStream()
+  : _buf(NULL), _capacity(0), _size(0), _pos(0), _overflow(false)
+{
+}
+
+MemoryStream::MemoryStream(uint8_t *buf, size_t capacity)
+  : _buf(buf), _capacity(capacity), _size(0), _pos(0), _overflow(false)
+{
+}
+
+int MemoryStream::available()
+{
+  return _size - _pos;
+} // end available
+
+int MemoryStream::read()
+{
+  if (_pos >= _size)
+  {
+    return -1;
+  }
+  return _buf[_pos++];
+} // end read
+
+int MemoryStream::peek()
+{
+  if (_pos >= _size)
+  {
+    return -1;
+  }
+  return _buf[_pos];
+} // end peek
+
+size_t MemoryStream::readBytes(char *buffer, size_t length)
+{
+  size_t count = std::min(length, _size - _pos);
+  memcpy(buffer, _buf + _pos, count);
+  _pos += count;
+  return count;
+} // end readBytes
+
+size_t MemoryStream::write(uint8_t c)
+{
+  return write(&c, 1);
+} // end write
+
+size_t MemoryStream::write(const uint8_t *buffer, size_t size)
+{
+  if (size > _capacity - _size)
+  {
+    size = _capacity - _size;
+    _overflow = true;
+  }
+  if (size > 0)
+  {
+    memcpy(_buf + _size, buffer, size);
+    _size += size;
+  }
+  return size;
+} // end write
+
+void MemoryStream::clear()
+{
+  _size = 0;
+  _pos = 0;
+  _overflow = false;
+  return;
+} // end clear
+
+void MemoryStream::rewind()
+{
+  _pos = 0;
+  return;
+} // end rewind
+
+const uint8_t *MemoryStream::data() const
+{
+  return _buf;
+} // end data
+
+size_t MemoryStream::size() const
+{
+  return _size;
+} // end size
+
+bool MemoryStream::overflowed() const
+{
+  return _overflow;
+} // end overflowed
+
+
+#if HTTP_GZIP
+// With CONCURRENT_FETCH, responses are inflated from several tasks. Only one
+// GzipStream exists at a time, so the inflater state and the deflate window
+// are never allocated twice.
+static SemaphoreHandle_t gzipMutex()
+{
+  static SemaphoreHandle_t m = xSemaphoreCreateMutex();
+  return m;
+} // end gzipMutex
+
+GzipStream::GzipStream(Stream &src)
+  : _src(src), _inflator(NULL), _window(NULL), _windowPos(0),
+    _outPos(0), _outEnd(0), _outTotal(0), _inPos(0), _inLen(0),
+    _started(false), _done(false), _error(false)
+{
+  setTimeout(src.getTimeout());
+  xSemaphoreTake(gzipMutex(), portMAX_DELAY);
+  // about 43 KiB, only taken from the heap when a response is gzip encoded
+  _inflator = static_cast<tinfl_decompressor *>(
+    malloc(sizeof(tinfl_decompressor)));
+  _window = static_cast<uint8_t *>(malloc(TINFL_LZ_DICT_SIZE));
+  if (_inflator == NULL || _window == NULL)
+  {
+    _error = true;
+    return;
+  }
+  tinfl_init(_inflator);
+}
+
+GzipStream::~GzipStream()
+{
+  free(_window);
+  free(_inflator);
+  xSemaphoreGive(gzipMutex());
+}
+
+/* Returns the next compressed byte, or -1 at the end of the source.
+ *
+ * The source is read in blocks of what is already available, and one byte at
+ * a time (waiting up to its timeout) otherwise.
+ */
+int GzipStream::srcRead()
+{
+  if (_inPos == _inLen)
+  {
+    int avail = _src.available();
+    size_t want = avail > 0 ? std::min(static_cast<size_t>(avail), sizeof(_in))
+                            : 1;
+    _inLen = _src.readBytes(reinterpret_cast<char *>(_in), want);
+    _inPos = 0;
+    if (_inLen == 0)
+    {
+      return -1;
+    }
+  }
+  return _in[_inPos++];
+} // end srcRead
+
+/* Reads the gzip member header, up to the start of the deflate data.
+ *
+ * Returns false if it is not a valid gzip header.
+ */
+bool GzipStream::readHeader()
+{
+  const uint8_t FHCRC = 0x02, FEXTRA = 0x04, FNAME = 0x08, FCOMMENT = 0x10;
+  int header[10];
+  for (int i = 0; i < 10; ++i)
+  {
+    header[i] = srcRead();
+  }
+  // ID1, ID2, CM (8 = deflate); MTIME, XFL and OS are ignored
+  if (header[0] != 0x1f || header[1] != 0x8b || header[2] != 8
+   || header[3] < 0 || header[9] < 0)
+  {
+    return false;
+  }
+  const int flags = header[3];
+
+  if (flags & FEXTRA)
+  {
+    int lo = srcRead();
+    int hi = srcRead();
+    if (lo < 0 || hi < 0)
+    {
+      return false;
+    }
+    for (int len = lo | (hi << 8); len > 0; --len)
+    {
+      if (srcRead() < 0)
+      {
+        return false;
+      }
+    }
+  }
+  for (uint8_t zeroTerminated : {FNAME, FCOMMENT})
+  {
+    if (flags & zeroTerminated)
+    {
+      int c;
+      while ((c = srcRead()) > 0)
+      {
+      }
+      if (c < 0)
+      {
+        return false;
+      }
+    }
+  }
+  if (flags & FHCRC)
+  {
+    if (srcRead() < 0 || srcRead() < 0)
+    {
+      return false;
+    }
+  }
+  return true;
+} // end readHeader
+
+/* Reads the gzip member trailer, following the deflate data.
+ *
+ * Returns false if the trailer is missing or the inflated size does not match.
+ * The CRC-32 is not checked, the deflate stream is already self-checking
+ * enough for a parser that validates its own input.
+ */
+bool GzipStream::readTrailer()
+{
+  uint32_t isize = 0;
+  for (int i = 0; i < 8; ++i)
+  {
+    int c = srcRead();
+    if (c < 0)
+    {
+      return false;
+    }
+    if (i >= 4)
+    { // ISIZE, little-endian
+      isize |= static_cast<uint32_t>(c) << (8 * (i - 4));
+    }
+  }
+  return isize == _outTotal;
+} // end readTrailer
+
+/* Inflates the next bytes into the window.
+ *
+ * Returns false once the compressed data has ended or failed.
+ */
+bool GzipStream::inflateMore()
+{
+  if (_done || _error)
+  {
+    return false;
+  }
+  if (!_started)
+  {
+    _started = true;
+    if (!readHeader())
+    {
+      _error = true;
+      return false;
+    }
+  }
+
+  while (true)
+  {
+    if (_inPos == _inLen)
+    {
+      int c = srcRead();
+      if (c < 0)
+      { // the source ended before the deflate data
+        _error = true;
+        return false;
+      }
+      --_inPos; // keep c in the input buffer
+    }
+
+    size_t inBytes = _inLen - _inPos;
+    size_t outBytes = TINFL_LZ_DICT_SIZE - _windowPos;
+    tinfl_status status = tinfl_decompress(_inflator, _in + _inPos, &inBytes,
+                                           _window, _window + _windowPos,
+                                           &outBytes,
+                                           TINFL_FLAG_HAS_MORE_INPUT);
+    _inPos += inBytes;
+    _outPos = _windowPos;
+    _outEnd = _windowPos + outBytes;
+    _outTotal += outBytes;
+    _windowPos = (_windowPos + outBytes) & (TINFL_LZ_DICT_SIZE - 1);
+
+    if (status < TINFL_STATUS_DONE)
+    {
+      _error = true;
+      return false;
+    }
+    if (status == TINFL_STATUS_DONE)
+    {
+      _done = true;
+      _error = !readTrailer();
+    }
+    if (outBytes > 0)
+    {
+      return true;
+    }
+    if (_done || _error)
+    {
+      return false;
+    }
+  }
+} // end inflateMore
+
+int GzipStream::available()
+{
+  return _outEnd - _outPos;
+} // end available
+
+int GzipStream::read()
+{
+  if (_outPos == _outEnd && !inflateMore())
+  {
+    return -1;
+  }
+  return _window[_outPos++];
+} // end read
+
+int GzipStream::peek()
+{
+  if (_outPos == _outEnd && !inflateMore())
+  {
+    return -1;
+  }
+  return _window[_outPos];
+} // end peek
+
+size_t GzipStream::readBytes(char *buffer, size_t length)
+{
+  size_t count = 0;
+  while (count < length)
+  {
+    if (_outPos == _outEnd && !inflateMore())
+    {
+      break;
+    }
+    size_t len = std::min(length - count, _outEnd - _outPos);
+    memcpy(buffer + count, _window + _outPos, len);
+    _outPos += len;
+    count += len;
+  }
+  return count;
+} // end readBytes
+
+size_t GzipStream::write(uint8_t)
+{
+  return 0; // read only
+} // end write
+
+bool GzipStream::failed() const
+{
+  return _error;
+} // end failed
+#endif
+
+/* Copies the headers of the response held by http that are needed to decode
+ * and cache its body. They must have been collected with collectHeaders().
+ */
+response_headers_t getResponseHeaders(HTTPClient &http)
+{
+  response_headers_t headers;
+  headers.contentEncoding = http.header("Content-Encoding");
+  headers.etag            = http.header("ETag");
+  headers.lastModified    = http.header("Last-Modified");
+  return headers;
+} // end getResponseHeaders
+
+/* Reads one line of a response head, without its line ending, waiting up to
+ * the timeout of src for each character.
+ *
+ * Returns false on timeout.
+ */
+static bool readHeadLine(Stream &src, String &line)
+{
+  line = "";
+  char c;
+  while (src.readBytes(&c, 1) == 1)
+  {
+    if (c == '\n')
+    {
+      return true;
+    }
+    if (c != '\r')
+    {
+      line += c;
+    }
+  }
+  return false;
+} // end readHeadLine
+
+/* Reads the status line and the headers of a response, leaving src at the
+ * start of its body. Interim (1xx) responses are skipped.
+ */
+void readResponseHead(Stream &src, response_head_t &head)
+{
+  String line;
+  do
+  {
+    head = {};
+    head.status = HTTPC_ERROR_READ_TIMEOUT;
+    head.contentLength = -1;
+    if (!readHeadLine(src, line))
+    {
+      return;
+    }
+    // "HTTP/1.x nnn reason", persistent by default from HTTP/1.1
+    if (!line.startsWith("HTTP/1.") || line.length() < 12)
+    {
+      head.status = HTTPC_ERROR_NO_HTTP_SERVER;
+      return;
+    }
+    head.keepAlive = line[7] != '0';
+    const int status = line.substring(9, 12).toInt();
+
+    while (true)
+    {
+      if (!readHeadLine(src, line))
+      {
+        return;
+      }
+      if (line.length() == 0)
+      { // end of the head
+        break;
+      }
+      const int colon = line.indexOf(':');
+      if (colon <= 0)
+      {
+        continue;
+      }
+      const String name = line.substring(0, colon);
+      String value = line.substring(colon + 1);
+      value.trim();
+      if (name.equalsIgnoreCase("Transfer-Encoding"))
+      {
+        head.chunked = value.equalsIgnoreCase("chunked");
+      }
+      else if (name.equalsIgnoreCase("Content-Length"))
+      {
+        head.contentLength = value.toInt();
+      }
+      else if (name.equalsIgnoreCase("Connection"))
+      {
+        value.toLowerCase();
+        if (value.indexOf("close") >= 0)
+        {
+          head.keepAlive = false;
+        }
+        else if (value.indexOf("keep-alive") >= 0)
+        {
+          head.keepAlive = true;
+        }
+      }
+      else if (name.equalsIgnoreCase("Date"))
+      {
+        head.date = value;
+      }
+      else if (name.equalsIgnoreCase("ETag"))
+      {
+        head.headers.etag = value;
+      }
+      else if (name.equalsIgnoreCase("Last-Modified"))
+      {
+        head.headers.lastModified = value;
+      }
+      else if (name.equalsIgnoreCase("Content-Encoding"))
+      {
+        head.headers.contentEncoding = value;
+      }
+    }
+    head.status = status >= 100 ? status : HTTPC_ERROR_NO_HTTP_SERVER;
+  } while (head.status >= 100 && head.status < 200);
+  return;
+} // end readResponseHead
+
+/* Passes the body of a response to the given deserializer, inflating it first
+ * if it is gzip encoded (see HTTP_GZIP).
+ */
+DeserializationError deserializeBody(const response_headers_t &headers,
+  Stream &body,
+  DeserializationError (*deserialize)(Stream &body, requested_data_t &r),
+  requested_data_t &r)
+{
+#if HTTP_GZIP
+  if (headers.contentEncoding.equalsIgnoreCase("gzip"))
+  {
+    GzipStream inflated(body);
+    DeserializationError error = deserialize(inflated, r);
+    if (inflated.failed())
+    {
+      error = DeserializationError::InvalidInput;
+    }
+    return error;
+  }
+#endif
+  return deserialize(body, r);
+} // end deserializeBody
@@ -0,0 +1,341 @@
+/* Streaming JSON pull parser for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <Arduino.h>
+
+#include "json_pull.h"
+
+JsonPullParser::JsonPullParser(Stream &in)
+  : _in(in), _len(0), _pos(0), _started(false),
+    _error(DeserializationError::Ok)
+{}
+
+/* Returns the next character of the stream without consuming it, or -1 at the
+ * end of the stream.
+ *
+ * Reads the stream in blocks of what is already available, and one byte at a
+ * time (waiting up to the stream's timeout) otherwise.
+ */
+int JsonPullParser::peekChar()
+{
+  if (_pos < _len)
+  {
+    return static_cast<uint8_t>(_buf[_pos]);
+  }
+  if (_error != DeserializationError::Ok)
+  {
+    return -1;
+  }
+  int avail = _in.available();
+  size_t want = avail > 0 ? std::min(static_cast<size_t>(avail), sizeof(_buf))
+                          : 1;
+  _len = _in.readBytes(_buf, want);
+  _pos = 0;
+  if (_len == 0)
+  {
+    fail(_started ? DeserializationError::IncompleteInput
+                  : DeserializationError::EmptyInput);
+    return -1;
+  }
+  _started = true;
+  return static_cast<uint8_t>(_buf[_pos]);
+} // end peekChar
+
+int JsonPullParser::readChar()
+{
+  int c = peekChar();
+  if (c >= 0)
+  {
+    ++_pos;
+  }
+  return c;
+} // end readChar
+
+/* Skips whitespace.
+ *
+ * Returns the next character without consuming it, or -1 at the end of the
+ * stream.
+ */
+int JsonPullParser::skipSpace()
+{
+  int c;
+  while ((c = peekChar()) == ' ' || c == '\n' || c == '\r' || c == '\t')
+  {
+    ++_pos;
+  }
+  return c;
+} // end skipSpace
+
+bool JsonPullParser::expect(char c)
+{
+  if (skipSpace() != c)
+  {
+    return fail(DeserializationError::InvalidInput);
+  }
+  ++_pos;
+  return true;
+} // end expect
+
+/* Records the first error. Always returns false.
+ */
+bool JsonPullParser::fail(DeserializationError::Code code)
+{
+  if (_error == DeserializationError::Ok)
+  {
+    _error = code;
+  }
+  return false;
+} // end fail
+
+bool JsonPullParser::nextIs(char c)
+{
+  return _error == DeserializationError::Ok && skipSpace() == c;
+} // end nextIs
+
+bool JsonPullParser::beginObject()
+{
+  return _error == DeserializationError::Ok && expect('{');
+} // end beginObject
+
+bool JsonPullParser::beginArray()
+{
+  return _error == DeserializationError::Ok && expect('[');
+} // end beginArray
+
+bool JsonPullParser::nextKey(char *key, size_t size)
+{
+  if (_error != DeserializationError::Ok)
+  {
+    return false;
+  }
+  int c = skipSpace();
+  if (c == ',')
+  {
+    ++_pos;
+    c = skipSpace();
+  }
+  if (c == '}')
+  {
+    ++_pos;
+    return false;
+  }
+  if (c != '"')
+  {
+    return fail(c < 0 ? DeserializationError::IncompleteInput
+                      : DeserializationError::InvalidInput);
+  }
+  return readString(key, size) && expect(':');
+} // end nextKey
+
+bool JsonPullParser::nextElement()
+{
+  if (_error != DeserializationError::Ok)
+  {
+    return false;
+  }
+  int c = skipSpace();
+  if (c == ',')
+  {
+    ++_pos;
+    c = skipSpace();
+  }
+  if (c == ']')
+  {
+    ++_pos;
+    return false;
+  }
+  if (c < 0)
+  {
+    return fail(DeserializationError::IncompleteInput);
+  }
+  return true;
+} // end nextElement
+
+/* Reads a literal or a number (everything up to the next delimiter) into buf,
+ * truncated to fit.
+ */
+bool JsonPullParser::readToken(char *buf, size_t size)
+{
+  size_t len = 0;
+  size_t count = 0;
+  int c;
+  while ((c = peekChar()) >= 0 && c != ',' && c != '}' && c != ']'
+         && c != ' ' && c != '\n' && c != '\r' && c != '\t')
+  {
+    if (len + 1 < size)
+    {
+      buf[len++] = c;
+    }
+    ++count;
+    ++_pos;
+  }
+  buf[len] = '\0';
+  if (count == 0)
+  {
+    return fail(c < 0 ? DeserializationError::IncompleteInput
+                      : DeserializationError::InvalidInput);
+  }
+  return true;
+} // end readToken
+
+bool JsonPullParser::readString(char *buf, size_t size)
+{
+  size_t len = 0;
+  buf[0] = '\0';
+  if (_error != DeserializationError::Ok)
+  {
+    return false;
+  }
+  if (skipSpace() != '"')
+  {
+    char token[8];
+    if (!readToken(token, sizeof(token)))
+    {
+      return false;
+    }
+    return strcmp(token, "null") == 0
+           || fail(DeserializationError::InvalidInput);
+  }
+  ++_pos;
+
+  int c;
+  while ((c = readChar()) != '"')
+  {
+    if (c < 0)
+    {
+      return false;
+    }
+    if (c == '\\')
+    {
+      c = readChar();
+      switch (c)
+      {
+      case 'b': c = '\b'; break;
+      case 'f': c = '\f'; break;
+      case 'n': c = '\n'; break;
+      case 'r': c = '\r'; break;
+      case 't': c = '\t'; break;
+      case 'u':
+      {
+        // Only characters of the Basic Latin block are kept.
+        unsigned code = 0;
+        for (int i = 0; i < 4; ++i)
+        {
+          int h = readChar();
+          if (!isxdigit(h))
+          {
+            return fail(h < 0 ? DeserializationError::IncompleteInput
+                              : DeserializationError::InvalidInput);
+          }
+          code = code * 16 + (isdigit(h) ? h - '0' : (h | 0x20) - 'a' + 10);
+        }
+        c = code < 0x80 ? code : '?';
+        break;
+      }
+      case '"':
+      case '\\':
+      case '/':
+        break;
+      default:
+        return fail(c < 0 ? DeserializationError::IncompleteInput
+                          : DeserializationError::InvalidInput);
+      }
+    }
+    if (len + 1 < size)
+    {
+      buf[len++] = c;
+    }
+  }
+  buf[len] = '\0';
+  return true;
+} // end readString
+
+bool JsonPullParser::readFloat(float &value)
+{
+  char token[32];
+  value = 0;
+  if (_error != DeserializationError::Ok)
+  {
+    return false;
+  }
+  bool ok = skipSpace() == '"' ? readString(token, sizeof(token))
+                               : readToken(token, sizeof(token));
+  if (ok)
+  {
+    value = strtof(token, NULL);
+  }
+  return ok;
+} // end readFloat
+
+bool JsonPullParser::skipValue()
+{
+  if (_error != DeserializationError::Ok)
+  {
+    return false;
+  }
+  int c = skipSpace();
+  if (c == '"')
+  {
+    char unused[1];
+    return readString(unused, sizeof(unused));
+  }
+  if (c != '{' && c != '[')
+  {
+    char unused[1];
+    return readToken(unused, sizeof(unused));
+  }
+
+  // Objects and arrays are skipped by counting brackets, so nesting depth
+  // costs no memory.
+  int depth = 0;
+  do
+  {
+    c = peekChar();
+    if (c == '"')
+    {
+      char unused[1];
+      if (!readString(unused, sizeof(unused)))
+      {
+        return false;
+      }
+      continue;
+    }
+    if (c < 0)
+    {
+      return false;
+    }
+    if (c == '{' || c == '[')
+    {
+      ++depth;
+    }
+    else if (c == '}' || c == ']')
+    {
+      --depth;
+    }
+    ++_pos;
+  } while (depth > 0);
+  return true;
+} // end skipValue
+
+DeserializationError JsonPullParser::error() const
+{
+  return _error;
+} // end error
+
@@ -16,6 +16,8 @@
  */
 
 #include "config.h"
+#include <algorithm>
+#include <cstring>
 #include <Arduino.h>
 //#include <Adafruit_Sensor.h>
 #include <Preferences.h>
@@ -27,22 +29,72 @@
 #include "api_response.h"
 #include "client_utils.h"
 #include "config.h"
+#include "data_snapshot.h"
 #include "display_utils.h"
 #include "icons/icons_196x196.h"
+#include "profiler.h"
 #include "renderer.h"
-
-#if defined(USE_HTTPS_WITH_CERT_VERIF) || defined(USE_HTTPS_WITH_CERT_VERIF)
-  #include <WiFiClientSecure.h>
-#endif
-#ifdef USE_HTTPS_WITH_CERT_VERIF
-  #include "cert.h"
-#endif
+#include "timekeeping.h"
 
 // too large to allocate locally on stack
 static requested_data_t       stored_datas;
 
 Preferences prefs;
 
+#if SKIP_UNCHANGED_REFRESH
+// Digest of the content shown in each region of the panel (see
+// getRegionDigests()), all 0 if unknown. Kept in RTC memory across deep sleep.
+RTC_DATA_ATTR static uint32_t panelDigests[REGION_COUNT] = {};
+#endif
+#if PARTIAL_REFRESH
+// partial refreshes since the last full refresh
+RTC_DATA_ATTR static int partialRefreshes = 0;
+#endif
+
+#if STALE_DATA_FALLBACK
+/* Replaces the data of each endpoint whose request failed by the data last
+ * received from it, if that is no older than STALE_DATA_MAX_AGE. A notice
+ * naming the stale endpoints, with the time of the oldest data, is stored in
+ * statusStr.
+ *
+ * Returns true if the data of every endpoint that failed was replaced.
+ */
+static bool useStaleData(requested_data_t &r,
+                         const int status[API_ENDPOINT_COUNT], time_t now,
+                         String &statusStr)
+{
+  time_t oldest = now;
+  String names;
+  for (int i = 0; i < API_ENDPOINT_COUNT; ++i)
+  {
+    if (status[i] == HTTP_CODE_OK)
+    {
+      continue;
+    }
+    time_t fetched;
+    if (!loadSnapshot(static_cast<api_endpoint_t>(i), r, &fetched)
+     || now - fetched > STALE_DATA_MAX_AGE)
+    {
+      return false;
+    }
+    oldest = std::min(oldest, fetched);
+    if (!names.isEmpty())
+    {
+      names += ", ";
+    }
+    names += API_ENDPOINT_NAMES[i];
+  }
+
+  tm oldestInfo = {};
+  localtime_r(&oldest, &oldestInfo);
+  String oldestStr;
+  getRefreshTimeStr(oldestStr, true, &oldestInfo);
+  statusStr = "Stale " + names + " (" + oldestStr + ")";
+  Serial.println(statusStr);
+  return true;
+} // end useStaleData
+#endif
+
 /* Put esp32 into ultra low-power deep sleep (<11μA).
  * Aligns wake time to the minute. Sleep times defined in config.cpp.
  */
@@ -97,9 +149,10 @@ void beginDeepSleep(unsigned long startTime, tm *timeInfo)
     sleepDuration = hoursUntilWake * 3600ULL - (timeInfo->tm_min * 60ULL + timeInfo->tm_sec);
   }
 
-  // add extra delay to compensate for esp32's with fast RTCs.
+  // add extra delay to compensate for esp32's with fast RTCs, at the drift rate
+  // learned from NTP.
   sleepDuration += 3ULL;
-  sleepDuration *= 1.0015f;
+  sleepDuration *= 1.0f + getClockDriftPpm() / 1e6f;
 
 #if DEBUG_LEVEL >= 1
   printHeapUsage();
@@ -110,6 +163,7 @@ void beginDeepSleep(unsigned long startTime, tm *timeInfo)
   Serial.println(" "  + String((millis() - startTime) / 1000.0, 3) + "s");
   Serial.print(TXT_ENTERING_DEEP_SLEEP_FOR);
   Serial.println(" " + String(sleepDuration) + "s");
+  profileWakeEnd();
   esp_deep_sleep_start();
 } // end beginDeepSleep
 
@@ -119,6 +173,7 @@ void setup()
 {
   unsigned long startTime = millis();
   Serial.begin(115200);
+  profileWakeBegin();
 
 #if DEBUG_LEVEL >= 1
   printHeapUsage();
@@ -126,11 +181,33 @@ void setup()
 
   disableBuiltinLED();
 
+#if SKIP_UNCHANGED_REFRESH
+  // only a successful dashboard refresh sets the digests again, so that an
+  // error screen is always replaced
+  uint32_t lastPanelDigests[REGION_COUNT];
+  memcpy(lastPanelDigests, panelDigests, sizeof(panelDigests));
+  memset(panelDigests, 0, sizeof(panelDigests));
+  const bool panelKnown = lastPanelDigests[0] != 0;
+#endif
+#if PARTIAL_REFRESH
+  // unless it is unknown, the panel still shows the last dashboard. Panels with
+  // fast partial update also need the previous frame in the controller, which
+  // is lost when powerOffDisplay() cuts their supply, so they start over.
+  const bool displayInitial = !panelKnown
+                           || display.epd2.hasFastPartialUpdate;
+#else
+  const bool displayInitial = true;
+#endif
+
   // Open namespace for read/write to non-volatile storage
+  int64_t phaseStart = profileStart();
   prefs.begin(NVS_NAMESPACE, false);
+  profileEnd(PHASE_NVS, phaseStart);
 
 #if BATTERY_MONITORING
+  phaseStart = profileStart();
   uint32_t batteryVoltage = readBatteryVoltage();
+  profileEnd(PHASE_BATTERY, phaseStart);
   Serial.print(TXT_BATTERY_VOLTAGE);
   Serial.println(": " + String(batteryVoltage) + "mv");
 
@@ -148,10 +225,8 @@ void setup()
       prefs.putBool("lowBat", true);
       prefs.end();
       initDisplay();
-      do
-      {
-        drawError(battery_alert_0deg_196x196, TXT_LOW_BATTERY);
-      } while (display.nextPage());
+      drawError(battery_alert_0deg_196x196, TXT_LOW_BATTERY);
+      drawFrame();
       powerOffDisplay();
     }
 
@@ -177,6 +252,7 @@ void setup()
       Serial.print(TXT_ENTERING_DEEP_SLEEP_FOR);
       Serial.println(" " + String(LOW_BATTERY_SLEEP_INTERVAL) + "min");
     }
+    profileWakeEnd();
     esp_deep_sleep_start();
   }
   // battery is no longer low, reset variable in non-volatile storage
@@ -191,89 +267,94 @@ void setup()
   // All data should have been loaded from NVS. Close filesystem.
   prefs.end();
 
+  // Power-up the display on the other core while WiFi associates. When the
+  // refresh may be skipped, the panel is only powered once the content is
+  // known to have changed, see beginPanelInit().
+#if !SKIP_UNCHANGED_REFRESH
+  beginDisplayInit(displayInitial);
+#endif
+
   String statusStr = {};
   String tmpStr = {};
   tm timeInfo = {};
 
   // START WIFI
   int wifiRSSI = 0; // “Received Signal Strength Indicator"
+  phaseStart = profileStart();
   wl_status_t wifiStatus = startWiFi(wifiRSSI);
+  profileEnd(PHASE_WIFI, phaseStart);
   if (wifiStatus != WL_CONNECTED)
   { // WiFi Connection Failed
     killWiFi();
-    initDisplay();
+    awaitDisplay(false);
     if (wifiStatus == WL_NO_SSID_AVAIL)
     {
       Serial.println(TXT_NETWORK_NOT_AVAILABLE);
-      do
-      {
-        drawError(wifi_x_196x196, TXT_NETWORK_NOT_AVAILABLE);
-      } while (display.nextPage());
+      drawError(wifi_x_196x196, TXT_NETWORK_NOT_AVAILABLE);
+      drawFrame();
     }
     else
     {
       Serial.println(TXT_WIFI_CONNECTION_FAILED);
-      do
-      {
-        drawError(wifi_x_196x196, TXT_WIFI_CONNECTION_FAILED);
-      } while (display.nextPage());
+      drawError(wifi_x_196x196, TXT_WIFI_CONNECTION_FAILED);
+      drawFrame();
     }
     powerOffDisplay();
     beginDeepSleep(startTime, &timeInfo);
   }
 
-  // TIME SYNCHRONIZATION
-  configTzTime(TIMEZONE, NTP_SERVER_1, NTP_SERVER_2);
-  bool timeConfigured = waitForSNTPSync(&timeInfo);
+  // TIME SYNCHRONIZATION, completes in the background of the API requests
+  beginTimeSync();
+
+  // MAKE API REQUESTS
+  int apiStatus[API_ENDPOINT_COUNT];
+  int rxStatus = getApiData(stored_datas, apiStatus);
+
+  // falls back on the Date of the API responses if NTP is slow
+  bool timeConfigured = finishTimeSync(&timeInfo);
+
+#if DOWNLOAD_THEN_PARSE
+  // the responses have all been read, decode them with WiFi off
+  killWiFi();
+  rxStatus = parseApiData(stored_datas, apiStatus);
+#endif
 
   if (!timeConfigured)
   {
     Serial.println(TXT_TIME_SYNCHRONIZATION_FAILED);
     killWiFi();
-    initDisplay();
-    do
-    {
-      drawError(wi_time_4_196x196, TXT_TIME_SYNCHRONIZATION_FAILED);
-    } while (display.nextPage());
+    awaitDisplay(false);
+    drawError(wi_time_4_196x196, TXT_TIME_SYNCHRONIZATION_FAILED);
+    drawFrame();
     powerOffDisplay();
     beginDeepSleep(startTime, &timeInfo);
   }
 
-  // MAKE API REQUESTS
-#ifdef USE_HTTP
-  WiFiClient client;
-#elif defined(USE_HTTPS_NO_CERT_VERIF)
-  WiFiClientSecure client;
-  client.setInsecure();
-#elif defined(USE_HTTPS_WITH_CERT_VERIF)
-  WiFiClientSecure client;
-  client.setCACert(cert_Sectigo_RSA_Organization_Validation_Secure_Server_CA);
-#endif
-
-  // Get datas
-
-  int rxStatus = getMeteocall(client, stored_datas);
-  if (rxStatus == HTTP_CODE_OK)
+#if STALE_DATA_FALLBACK
+  const time_t now = time(NULL);
+  for (int i = 0; i < API_ENDPOINT_COUNT; ++i)
   {
-    rxStatus = getDomoticzcall_IDX(client, stored_datas);
+    if (apiStatus[i] == HTTP_CODE_OK)
+    {
+      saveSnapshot(static_cast<api_endpoint_t>(i), stored_datas, now);
+    }
   }
-  if (rxStatus == HTTP_CODE_OK)
+  if (rxStatus != HTTP_CODE_OK
+   && useStaleData(stored_datas, apiStatus, now, statusStr))
   {
-    rxStatus = getDomoticzcall_GRAPH(client, stored_datas);
+    rxStatus = HTTP_CODE_OK;
   }
-
+#endif
 
   if (rxStatus != HTTP_CODE_OK)
   {
     killWiFi();
     statusStr = "Connexion issue with API";
     tmpStr = String(rxStatus, DEC) + ": " + getHttpResponsePhrase(rxStatus);
-    initDisplay();
+    awaitDisplay(false);
 
-    do
-    {
-      drawError(wi_cloud_down_196x196, statusStr, tmpStr);
-    } while (display.nextPage());
+    drawError(wi_cloud_down_196x196, statusStr, tmpStr);
+    drawFrame();
 
     powerOffDisplay();
     beginDeepSleep(startTime, &timeInfo);
@@ -288,20 +369,96 @@ void setup()
   String dateStr;
   getDateStr(dateStr, &timeInfo);
 
-  // RENDER FULL REFRESH
-  initDisplay();
+#if SKIP_UNCHANGED_REFRESH
+  getRegionDigests(panelDigests, stored_datas, timeInfo, dateStr, statusStr,
+                   wifiRSSI, batteryVoltage);
+  bool dirty[REGION_COUNT];
+  bool unchanged = true;
+  for (int i = 0; i < REGION_COUNT; ++i)
+  {
+    dirty[i] = panelDigests[i] != lastPanelDigests[i];
+    unchanged &= !dirty[i];
+  }
+  if (unchanged)
+  {
+#if DEBUG_LEVEL >= 1
+    Serial.println("[debug] Content unchanged, skipping display refresh");
+#endif
+    beginDeepSleep(startTime, &timeInfo);
+  }
+
+  // Power-up the panel on the other core while the frame is recorded.
+  beginPanelInit(displayInitial);
+  const bool staticLayoutReady = false;
+#else
+  const bool staticLayoutReady = awaitDisplay(true, displayInitial);
+#endif
 
-  do
+#if PARTIAL_REFRESH
+  // Only the regions that changed are refreshed, along with the status bar to
+  // update the refresh time. A full refresh is done every FULL_REFRESH_INTERVAL
+  // refreshes, to clear the ghosting partial refreshes leave behind. Panels
+  // with fast partial update always get a full refresh (see displayInitial).
+  const bool fullRefresh = displayInitial || !display.epd2.hasPartialUpdate
+                        || partialRefreshes >= FULL_REFRESH_INTERVAL;
+  dirty[REGION_STATUS_BAR] = true;
+  int16_t dirtyX0 = INT16_MAX, dirtyY0 = INT16_MAX, dirtyX1 = 0, dirtyY1 = 0;
+  for (int i = 0; i < REGION_COUNT; ++i)
   {
-    drawCurrentConditions(stored_datas.current, stored_datas.daily[0], 22, 40, dateStr);
-    drawForecast(stored_datas.daily, timeInfo);
-    drawDomoticz(stored_datas.data, stored_datas.memo);
+    if (dirty[i])
+    {
+      int16_t x, y, w, h;
+      getRegionBounds(static_cast<display_region_t>(i), x, y, w, h);
+      dirtyX0 = std::min(dirtyX0, x);
+      dirtyY0 = std::min(dirtyY0, y);
+      dirtyX1 = std::max<int16_t>(dirtyX1, x + w);
+      dirtyY1 = std::max<int16_t>(dirtyY1, y + h);
+    }
+  }
+  partialRefreshes = fullRefresh ? 0 : partialRefreshes + 1;
+#endif
+
+  // the frame is recorded once, then replayed on each page of the display
+  phaseStart = profileStart();
+  if (!staticLayoutReady)
+  {
+    drawStaticLayout();
+  }
+  drawCurrentConditions(stored_datas.current, stored_datas.daily[0], 22, 40, dateStr);
+  drawForecast(stored_datas.daily, timeInfo);
+  drawDomoticz(stored_datas.data, stored_datas.memo.c_str());
 
-    //drawOutlookGraph(stored_datas.hourly, timeInfo);
-    drawConsumptionGraph(stored_datas.graph , timeInfo);
+  //drawOutlookGraph(stored_datas.hourly, timeInfo);
+  drawConsumptionGraph(stored_datas.graph , timeInfo);
 
-    drawStatusBar(statusStr, refreshTimeStr, wifiRSSI, batteryVoltage);
-  } while (display.nextPage());
+  drawStatusBar(statusStr, refreshTimeStr, wifiRSSI, batteryVoltage);
+  profileEnd(PHASE_RECORD_FRAME, phaseStart);
+
+#if SKIP_UNCHANGED_REFRESH
+  awaitDisplay(true, displayInitial);
+#endif
+
+  // RENDER FULL OR PARTIAL REFRESH
+#if PARTIAL_REFRESH
+  if (!fullRefresh)
+  {
+#if DEBUG_LEVEL >= 1
+    Serial.println("[debug] Partial refresh of " + String(dirtyX1 - dirtyX0)
+                   + "x" + String(dirtyY1 - dirtyY0) + " at " + String(dirtyX0)
+                   + "," + String(dirtyY0));
+#endif
+    display.setPartialWindow(dirtyX0, dirtyY0,
+                             dirtyX1 - dirtyX0, dirtyY1 - dirtyY0);
+    display.firstPage();
+    drawFrame(dirtyX0, dirtyY0, dirtyX1 - dirtyX0, dirtyY1 - dirtyY0);
+  }
+  else
+  {
+    drawFrame();
+  }
+#else
+  drawFrame();
+#endif
 
 
   powerOffDisplay();
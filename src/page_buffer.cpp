@@ -0,0 +1,593 @@
+/* Page buffer for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <Arduino.h>
+#include <Adafruit_GFX.h>
+
+#include "config.h"
+#include "page_buffer.h"
+#include "renderer.h"
+
+#if DIRECT_PAGE_BUFFER
+
+static uint8_t pagePlanes[PAGE_BUFFER_PLANES][PAGE_BUFFER_SIZE];
+
+// longest bitmap row or column blitted a byte at a time, in bytes
+static const int16_t BLIT_MAX_BYTES = 32;
+
+static const uint8_t PATTERN_SOLID[8] = {
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF
+};
+
+PageBuffer::PageBuffer()
+  : Adafruit_GFX(DISP_WIDTH, DISP_HEIGHT), _partial(false),
+    _winX(0), _winY(0), _winW(DISP_WIDTH), _winH(DISP_HEIGHT),
+    _stride(DISP_WIDTH / 8), _pageRows(0), _row0(0), _rows(0)
+{
+  for (int p = 0; p < PAGE_BUFFER_PLANES; ++p)
+  {
+    _planes[p] = pagePlanes[p];
+  }
+}
+
+/* Returns true if drawing color sets bits of plane (white), false if it clears
+ * them (black or accent color).
+ */
+static inline bool isWhite(int plane, uint16_t color)
+{
+#if PAGE_BUFFER_PLANES == 2
+  return color == GxEPD_WHITE
+      || (plane == 0 && color != GxEPD_BLACK)
+      || (plane == 1 && color == GxEPD_BLACK);
+#else
+  return color == GxEPD_WHITE;
+#endif
+} // end isWhite
+
+/* Gets the panel rectangle px0 <= x < px1, py0 <= y < py1 covered by the
+ * display rectangle x, y, w, h, the same way GxEPD2 rotates coordinates.
+ */
+void PageBuffer::toPanelRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                             int16_t &px0, int16_t &py0,
+                             int16_t &px1, int16_t &py1) const
+{
+  switch (getRotation())
+  {
+    case 0:
+      px0 = x;              px1 = x + w;
+      py0 = y;              py1 = y + h;
+      break;
+    case 1:
+      px0 = WIDTH - y - h;  px1 = WIDTH - y;
+      py0 = x;              py1 = x + w;
+      break;
+    case 2:
+      px0 = WIDTH - x - w;  px1 = WIDTH - x;
+      py0 = HEIGHT - y - h; py1 = HEIGHT - y;
+      break;
+    default:
+      px0 = y;              px1 = y + h;
+      py0 = HEIGHT - x - w; py1 = HEIGHT - x;
+      break;
+  }
+  return;
+} // end toPanelRect
+
+/* Fills the panel rectangle px0 <= x < px1, py0 <= y < py1 with color where
+ * pattern (in panel coordinates) is set, clipped to the selected page.
+ */
+void PageBuffer::fillPanelRect(int16_t px0, int16_t py0,
+                               int16_t px1, int16_t py1,
+                               const uint8_t pattern[8], uint16_t color)
+{
+  px0 = std::max(px0, _winX);
+  px1 = std::min<int16_t>(px1, _winX + _winW);
+  py0 = std::max(py0, _row0);
+  py1 = std::min<int16_t>(py1, _row0 + _rows);
+  if (px0 >= px1 || py0 >= py1)
+  {
+    return;
+  }
+
+  // _winX is a multiple of 8, so are the first pixels of the bytes
+  const int16_t b0 = (px0 - _winX) >> 3;
+  const int16_t b1 = (px1 - 1 - _winX) >> 3;
+  uint8_t mask0 = 0xFF >> (px0 & 7);
+  uint8_t mask1 = 0xFF << (7 - ((px1 - 1) & 7));
+  if (b0 == b1)
+  {
+    mask0 &= mask1;
+  }
+
+  for (int p = 0; p < PAGE_BUFFER_PLANES; ++p)
+  {
+    const bool white = isWhite(p, color);
+    for (int16_t py = py0; py < py1; ++py)
+    {
+      const uint8_t bits = pattern[py & 7];
+      if (bits == 0)
+      {
+        continue;
+      }
+      uint8_t *row = _planes[p] + (py - _row0) * _stride;
+      if (white)
+      {
+        row[b0] |= bits & mask0;
+      }
+      else
+      {
+        row[b0] &= ~(bits & mask0);
+      }
+      if (b0 == b1)
+      {
+        continue;
+      }
+
+      if (bits == 0xFF)
+      {
+        memset(row + b0 + 1, white ? 0xFF : 0x00, b1 - b0 - 1);
+      }
+      else if (white)
+      {
+        for (int16_t b = b0 + 1; b < b1; ++b)
+        {
+          row[b] |= bits;
+        }
+      }
+      else
+      {
+        for (int16_t b = b0 + 1; b < b1; ++b)
+        {
+          row[b] &= ~bits;
+        }
+      }
+
+      if (white)
+      {
+        row[b1] |= bits & mask1;
+      }
+      else
+      {
+        row[b1] &= ~(bits & mask1);
+      }
+    }
+  }
+  return;
+} // end fillPanelRect
+
+void PageBuffer::drawPixel(int16_t x, int16_t y, uint16_t color)
+{
+  if (x < 0 || x >= width() || y < 0 || y >= height())
+  {
+    return;
+  }
+  int16_t px0, py0, px1, py1;
+  toPanelRect(x, y, 1, 1, px0, py0, px1, py1);
+  if (px0 < _winX || px0 >= _winX + _winW
+   || py0 < _row0 || py0 >= _row0 + _rows)
+  {
+    return;
+  }
+
+  uint8_t *byte = _planes[0] + (py0 - _row0) * _stride + ((px0 - _winX) >> 3);
+  const uint8_t bit = 0x80 >> (px0 & 7);
+#if PAGE_BUFFER_PLANES == 2
+  uint8_t *accent = byte - _planes[0] + _planes[1];
+  if (color == GxEPD_WHITE)
+  {
+    *byte   |= bit;
+    *accent |= bit;
+  }
+  else if (color == GxEPD_BLACK)
+  {
+    *byte   &= ~bit;
+    *accent |= bit;
+  }
+  else
+  {
+    *byte   |= bit;
+    *accent &= ~bit;
+  }
+#else
+  if (color == GxEPD_WHITE)
+  {
+    *byte |= bit;
+  }
+  else
+  {
+    *byte &= ~bit;
+  }
+#endif
+  return;
+} // end drawPixel
+
+void PageBuffer::drawFastHLine(int16_t x, int16_t y, int16_t w,
+                               uint16_t color)
+{
+  fillPattern(x, y, w, 1, PATTERN_SOLID, color);
+  return;
+} // end drawFastHLine
+
+void PageBuffer::drawFastVLine(int16_t x, int16_t y, int16_t h,
+                               uint16_t color)
+{
+  fillPattern(x, y, 1, h, PATTERN_SOLID, color);
+  return;
+} // end drawFastVLine
+
+void PageBuffer::fillRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                          uint16_t color)
+{
+  fillPattern(x, y, w, h, PATTERN_SOLID, color);
+  return;
+} // end fillRect
+
+void PageBuffer::fillScreen(uint16_t color)
+{
+  fillPattern(0, 0, width(), height(), PATTERN_SOLID, color);
+  return;
+} // end fillScreen
+
+/* The pattern is rotated to panel coordinates once, then written to the page
+ * a byte at a time. The width and height of the panel are multiples of 8, so
+ * the pattern stays tiled from (0, 0) of the display.
+ */
+void PageBuffer::fillPattern(int16_t x, int16_t y, int16_t w, int16_t h,
+                             const uint8_t pattern[8], uint16_t color)
+{
+  if (w <= 0 || h <= 0)
+  {
+    return;
+  }
+  // clip to the display first, panel coordinates would wrap around otherwise
+  const int16_t x1 = std::min<int16_t>(x + w, width());
+  const int16_t y1 = std::min<int16_t>(y + h, height());
+  x = std::max<int16_t>(x, 0);
+  y = std::max<int16_t>(y, 0);
+  if (x >= x1 || y >= y1)
+  {
+    return;
+  }
+
+  uint8_t panelPattern[8];
+  for (int py = 0; py < 8; ++py)
+  {
+    uint8_t bits = 0;
+    for (int px = 0; px < 8; ++px)
+    {
+      int lx, ly;
+      switch (getRotation())
+      {
+        case 0:  lx = px;     ly = py;     break;
+        case 1:  lx = py;     ly = 7 - px; break;
+        case 2:  lx = 7 - px; ly = 7 - py; break;
+        default: lx = 7 - py; ly = px;     break;
+      }
+      if (pattern[ly] & (0x80 >> lx))
+      {
+        bits |= 0x80 >> px;
+      }
+    }
+    panelPattern[py] = bits;
+  }
+
+  int16_t px0, py0, px1, py1;
+  toPanelRect(x, y, x1 - x, y1 - y, px0, py0, px1, py1);
+  fillPanelRect(px0, py0, px1, py1, panelPattern, color);
+  return;
+} // end fillPattern
+
+/* Reverses the order of the bits of a byte.
+ */
+static inline uint8_t reverseByte(uint8_t b)
+{
+  b = (b & 0xF0) >> 4 | (b & 0x0F) << 4;
+  b = (b & 0xCC) >> 2 | (b & 0x33) << 2;
+  b = (b & 0xAA) >> 1 | (b & 0x55) << 1;
+  return b;
+} // end reverseByte
+
+/* Reverses the order of the first n bits of bits (n > 0), in place.
+ */
+static void reverseBits(uint8_t *bits, int16_t n)
+{
+  const int16_t bytes = (n + 7) / 8;
+  const int16_t pad = bytes * 8 - n;
+  uint8_t reversed[BLIT_MAX_BYTES];
+  for (int16_t k = 0; k < bytes; ++k)
+  {
+    reversed[k] = reverseByte(bits[bytes - 1 - k]);
+  }
+  // the padding bits, now leading, are shifted out
+  for (int16_t k = 0; k < bytes; ++k)
+  {
+    const uint8_t next = k + 1 < bytes ? reversed[k + 1] : 0;
+    bits[k] = pad ? (reversed[k] << pad) | (next >> (8 - pad)) : reversed[k];
+  }
+  return;
+} // end reverseBits
+
+/* Transposes an 8x8 bit matrix: bit 7 - c of in[r] becomes bit 7 - r of
+ * out[c] (Hacker's Delight, 7-3).
+ */
+static void transpose8(const uint8_t in[8], uint8_t out[8])
+{
+  uint32_t x = (uint32_t)in[0] << 24 | (uint32_t)in[1] << 16
+             | (uint32_t)in[2] << 8  | in[3];
+  uint32_t y = (uint32_t)in[4] << 24 | (uint32_t)in[5] << 16
+             | (uint32_t)in[6] << 8  | in[7];
+  uint32_t t;
+  t = (x ^ (x >> 7)) & 0x00AA00AA;  x = x ^ t ^ (t << 7);
+  t = (y ^ (y >> 7)) & 0x00AA00AA;  y = y ^ t ^ (t << 7);
+  t = (x ^ (x >> 14)) & 0x0000CCCC; x = x ^ t ^ (t << 14);
+  t = (y ^ (y >> 14)) & 0x0000CCCC; y = y ^ t ^ (t << 14);
+  t = (x & 0xF0F0F0F0) | ((y >> 4) & 0x0F0F0F0F);
+  y = ((x << 4) & 0xF0F0F0F0) | (y & 0x0F0F0F0F);
+  x = t;
+  out[0] = x >> 24; out[1] = x >> 16; out[2] = x >> 8; out[3] = x;
+  out[4] = y >> 24; out[5] = y >> 16; out[6] = y >> 8; out[7] = y;
+  return;
+} // end transpose8
+
+/* Sets color where bits (n bits, the most significant first) are set, on panel
+ * row py from panel column px, clipped to the selected page. The bits past n
+ * must be cleared.
+ */
+void PageBuffer::blitPanelRow(int16_t px, int16_t py, const uint8_t *bits,
+                              int16_t n, uint16_t color)
+{
+  if (py < _row0 || py >= _row0 + _rows)
+  {
+    return;
+  }
+  // bits[k] lands across page bytes d0 + k and d0 + k + 1
+  const int16_t rx = px - _winX;
+  const int16_t d0 = rx >= 0 ? rx / 8 : -((7 - rx) / 8);
+  const int16_t shift = rx - d0 * 8;
+  const int16_t bytes = (n + 7) / 8;
+
+  for (int p = 0; p < PAGE_BUFFER_PLANES; ++p)
+  {
+    const bool white = isWhite(p, color);
+    uint8_t *row = _planes[p] + (py - _row0) * _stride;
+    for (int16_t k = 0; k <= bytes; ++k)
+    {
+      const int16_t d = d0 + k;
+      if (d < 0 || d >= _stride)
+      {
+        continue;
+      }
+      const uint8_t hi = k < bytes ? bits[k] >> shift : 0;
+      const uint8_t lo = k > 0 && shift ? bits[k - 1] << (8 - shift) : 0;
+      const uint8_t mask = hi | lo;
+      if (white)
+      {
+        row[d] |= mask;
+      }
+      else
+      {
+        row[d] &= ~mask;
+      }
+    }
+  }
+  return;
+} // end blitPanelRow
+
+/* Draws color where the bits of bitmap are cleared, like GxEPD2 does, but a
+ * byte at a time. Rows of the bitmap that become panel columns (rotations 1
+ * and 3) are turned into panel rows 8x8 bits at a time.
+ */
+void PageBuffer::drawInvertedBitmap(int16_t x, int16_t y,
+                                    const uint8_t bitmap[],
+                                    int16_t w, int16_t h, uint16_t color)
+{
+  if (w <= 0 || h <= 0)
+  {
+    return;
+  }
+  const uint8_t rotation = getRotation();
+  const bool transposed = rotation & 1;
+  // bits per panel row
+  if ((transposed ? h : w) > BLIT_MAX_BYTES * 8)
+  {
+    for (int16_t j = 0; j < h; ++j)
+    {
+      for (int16_t i = 0; i < w; ++i)
+      {
+        if (!(pgm_read_byte(&bitmap[j * ((w + 7) / 8) + i / 8])
+              & (0x80 >> (i & 7))))
+        {
+          drawPixel(x + i, y + j, color);
+        }
+      }
+    }
+    return;
+  }
+
+  const int16_t byteWidth = (w + 7) / 8;
+  // panel rectangle of the bitmap, the first bitmap row or column starts at
+  // its left unless reversed
+  int16_t px0, py0, px1, py1;
+  toPanelRect(x, y, w, h, px0, py0, px1, py1);
+  const bool reversed = rotation == 1 || rotation == 2;
+  uint8_t bits[BLIT_MAX_BYTES];
+
+  if (!transposed)
+  {
+    const uint8_t lastMask = 0xFF << ((8 - w % 8) % 8);
+    for (int16_t j = 0; j < h; ++j)
+    {
+      const int16_t py = rotation == 0 ? y + j : HEIGHT - 1 - (y + j);
+      if (py < _row0 || py >= _row0 + _rows)
+      {
+        continue;
+      }
+      for (int16_t k = 0; k < byteWidth; ++k)
+      {
+        bits[k] = ~pgm_read_byte(&bitmap[j * byteWidth + k]);
+      }
+      bits[byteWidth - 1] &= lastMask;
+      if (reversed)
+      {
+        reverseBits(bits, w);
+      }
+      blitPanelRow(px0, py, bits, w, color);
+    }
+    return;
+  }
+
+  // 8 columns of the bitmap at a time, each column a panel row
+  const int16_t byteHeight = (h + 7) / 8;
+  uint8_t columns[8][BLIT_MAX_BYTES];
+  for (int16_t c = 0; c < byteWidth; ++c)
+  {
+    // panel rows of columns 8c to 8c + 7
+    const int16_t pyFirst = rotation == 1 ? x + 8 * c : HEIGHT - 1 - (x + 8 * c);
+    const int16_t pyLast  = rotation == 1 ? pyFirst + 7 : pyFirst - 7;
+    if (std::max(pyFirst, pyLast) < _row0
+     || std::min(pyFirst, pyLast) >= _row0 + _rows)
+    {
+      continue;
+    }
+
+    for (int16_t r = 0; r < byteHeight; ++r)
+    {
+      uint8_t block[8], transposedBlock[8];
+      for (int16_t a = 0; a < 8; ++a)
+      {
+        // reversed columns are read from the bottom row up
+        const int16_t j = reversed ? h - 1 - (8 * r + a) : 8 * r + a;
+        block[a] = j >= 0 && j < h
+                 ? ~pgm_read_byte(&bitmap[j * byteWidth + c]) : 0;
+      }
+      transpose8(block, transposedBlock);
+      for (int16_t b = 0; b < 8; ++b)
+      {
+        columns[b][r] = transposedBlock[b];
+      }
+    }
+
+    for (int16_t b = 0; b < 8 && 8 * c + b < w; ++b)
+    {
+      const int16_t py = rotation == 1 ? pyFirst + b : pyFirst - b;
+      if (py < _row0 || py >= _row0 + _rows)
+      {
+        continue;
+      }
+      blitPanelRow(px0, py, columns[b], h, color);
+    }
+  }
+  return;
+} // end drawInvertedBitmap
+
+int PageBuffer::setWindow(int16_t x, int16_t y, int16_t w, int16_t h,
+                          bool partial)
+{
+  int16_t px0, py0, px1, py1;
+  toPanelRect(x, y, w, h, px0, py0, px1, py1);
+  px0 = std::max<int16_t>(px0, 0) & ~7;
+  px1 = (std::min<int16_t>(px1, WIDTH) + 7) & ~7;
+  py0 = std::max<int16_t>(py0, 0);
+  py1 = std::min<int16_t>(py1, HEIGHT);
+
+  _partial  = partial;
+  _winX     = px0;
+  _winY     = py0;
+  _winW     = std::max(px1 - px0, 8);
+  _winH     = std::max(py1 - py0, 1);
+  _stride   = _winW / 8;
+  _pageRows = std::min<int16_t>(PAGE_BUFFER_SIZE / _stride, _winH);
+  return (_winH + _pageRows - 1) / _pageRows;
+} // end setWindow
+
+void PageBuffer::setPage(int page)
+{
+  _row0 = _winY + page * _pageRows;
+  _rows = std::min<int16_t>(_pageRows, _winY + _winH - _row0);
+  for (int p = 0; p < PAGE_BUFFER_PLANES; ++p)
+  {
+    memset(_planes[p], 0xFF, _rows * _stride);
+  }
+  return;
+} // end setPage
+
+void PageBuffer::getPageBounds(int16_t &x0, int16_t &y0,
+                               int16_t &x1, int16_t &y1) const
+{
+  const int16_t px0 = _winX, px1 = _winX + _winW;
+  const int16_t py0 = _row0, py1 = _row0 + _rows;
+  switch (getRotation())
+  {
+    case 0:
+      x0 = px0;          x1 = px1;
+      y0 = py0;          y1 = py1;
+      break;
+    case 1:
+      x0 = py0;          x1 = py1;
+      y0 = WIDTH - px1;  y1 = WIDTH - px0;
+      break;
+    case 2:
+      x0 = WIDTH - px1;  x1 = WIDTH - px0;
+      y0 = HEIGHT - py1; y1 = HEIGHT - py0;
+      break;
+    default:
+      x0 = HEIGHT - py1; x1 = HEIGHT - py0;
+      y0 = px0;          y1 = px1;
+      break;
+  }
+  return;
+} // end getPageBounds
+
+void PageBuffer::writePage(bool again)
+{
+#if PAGE_BUFFER_PLANES == 2
+  display.epd2.writeImage(_planes[0], _planes[1],
+                          _winX, _row0, _winW, _rows);
+#else
+  if (again)
+  {
+    display.epd2.writeImageAgain(_planes[0], _winX, _row0, _winW, _rows);
+  }
+  else if (_partial)
+  {
+    display.epd2.writeImage(_planes[0], _winX, _row0, _winW, _rows);
+  }
+  else
+  {
+    display.epd2.writeImageForFullRefresh(_planes[0],
+                                          _winX, _row0, _winW, _rows);
+  }
+#endif
+  return;
+} // end writePage
+
+void PageBuffer::refresh()
+{
+  if (_partial)
+  {
+    display.epd2.refresh(_winX, _winY, _winW, _winH);
+  }
+  else
+  {
+    display.epd2.refresh(false);
+  }
+  return;
+} // end refresh
+
+#endif
@@ -0,0 +1,225 @@
+/* Wake profiler for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <sys/time.h>
+
+#include <Arduino.h>
+#include <esp_system.h>
+#include <esp_timer.h>
+
+#include "config.h"
+#include "profiler.h"
+
+#if WAKE_PROFILER
+// number of wakes kept, and of events kept per wake
+#define PROFILE_WAKES       4
+#define PROFILE_MAX_EVENTS 32
+
+/*
+ * Timeline of the last wakes, kept in RTC memory that is not initialized at
+ * boot, so it also survives a reset (i.e. the reset button, a crash or a
+ * watchdog). It is only lost on power loss.
+ */
+typedef struct profile_event
+{
+  uint32_t startUs;    // since boot
+  uint32_t durationUs;
+  uint8_t  phase;
+  uint8_t  core;
+} profile_event_t;
+
+typedef struct profile_wake
+{
+  int64_t  epochUs;    // wall clock at boot, 0 if unknown
+  uint32_t seq;        // number of the wake since the log was cleared
+  uint32_t count;      // events recorded
+  profile_event_t events[PROFILE_MAX_EVENTS];
+} profile_wake_t;
+
+typedef struct profile_log
+{
+  uint32_t magic;      // PROFILE_MAGIC once initialized
+  uint32_t current;    // index of the wake being recorded
+  uint32_t seq;
+  profile_wake_t wakes[PROFILE_WAKES];
+} profile_log_t;
+
+static const uint32_t PROFILE_MAGIC = 0x50524F46; // "PROF"
+
+static const char *PHASE_NAMES[PHASE_COUNT] = {
+  "Battery",
+  "NVS",
+  "Display init",
+  "WiFi connect",
+  "SNTP",
+  "Fetch Open-Meteo",
+  "Parse Open-Meteo",
+  "Fetch Domoticz devices",
+  "Parse Domoticz devices",
+  "Fetch Domoticz graph",
+  "Parse Domoticz graph",
+  "Record frame",
+  "Render page",
+  "Page transfer",
+  "Panel refresh",
+  "Sleep",
+};
+
+RTC_NOINIT_ATTR static profile_log_t profileLog;
+// the fetch tasks record events concurrently
+static portMUX_TYPE profileMux = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
+/* Begins recording a new wake. Must be called first thing in setup(), once
+ * Serial is started.
+ *
+ * After a reset (as opposed to a wake from deep sleep), the wakes recorded so
+ * far are printed to the serial monitor as a Chrome trace first. Pressing the
+ * reset button is thus all it takes to retrieve them.
+ */
+void profileWakeBegin()
+{
+#if WAKE_PROFILER
+  const esp_reset_reason_t reason = esp_reset_reason();
+  const bool valid = profileLog.magic == PROFILE_MAGIC
+                  && profileLog.current < PROFILE_WAKES
+                  && reason != ESP_RST_POWERON && reason != ESP_RST_BROWNOUT;
+  if (!valid)
+  {
+    memset(&profileLog, 0, sizeof(profileLog));
+    profileLog.magic = PROFILE_MAGIC;
+  }
+  else
+  {
+    if (reason != ESP_RST_DEEPSLEEP)
+    {
+      profileDump(Serial);
+    }
+    profileLog.current = (profileLog.current + 1) % PROFILE_WAKES;
+  }
+
+  profile_wake_t &wake = profileLog.wakes[profileLog.current];
+  wake.epochUs = 0;
+  wake.seq     = ++profileLog.seq;
+  wake.count   = 0;
+#endif
+  return;
+} // end profileWakeBegin
+
+/* Records the entry into deep sleep, which ends the wake.
+ */
+void profileWakeEnd()
+{
+#if WAKE_PROFILER
+  const int64_t nowUs = esp_timer_get_time();
+  profileEvent(PHASE_SLEEP, nowUs, nowUs);
+
+  timeval tv;
+  gettimeofday(&tv, NULL);
+  const int64_t clockUs = tv.tv_sec * 1000000LL + tv.tv_usec;
+  // the clock is only meaningful once it was set
+  if (tv.tv_sec > 1577836800) // 2020-01-01
+  {
+    profileLog.wakes[profileLog.current].epochUs = clockUs - nowUs;
+  }
+#endif
+  return;
+} // end profileWakeEnd
+
+/* Returns the start time of a phase, to be passed to profileEnd().
+ */
+int64_t profileStart()
+{
+  return esp_timer_get_time();
+} // end profileStart
+
+/* Records a phase that started at startUs and ends now.
+ */
+void profileEnd(profile_phase_t phase, int64_t startUs)
+{
+  profileEvent(phase, startUs, esp_timer_get_time());
+  return;
+} // end profileEnd
+
+/* Records a phase from startUs to endUs, as read from esp_timer_get_time().
+ * Events past PROFILE_MAX_EVENTS are dropped.
+ */
+void profileEvent(profile_phase_t phase, int64_t startUs, int64_t endUs)
+{
+#if WAKE_PROFILER
+  portENTER_CRITICAL(&profileMux);
+  profile_wake_t &wake = profileLog.wakes[profileLog.current];
+  if (wake.count < PROFILE_MAX_EVENTS)
+  {
+    profile_event_t &e = wake.events[wake.count++];
+    e.startUs    = static_cast<uint32_t>(startUs);
+    e.durationUs = static_cast<uint32_t>(endUs - startUs);
+    e.phase      = static_cast<uint8_t>(phase);
+    e.core       = static_cast<uint8_t>(xPortGetCoreID());
+  }
+  portEXIT_CRITICAL(&profileMux);
+#endif
+  return;
+} // end profileEvent
+
+/* Prints the recorded wakes, oldest first, in the Chrome trace event format.
+ * Save the output between the markers to a .json file and open it in
+ * chrome://tracing or https://ui.perfetto.dev.
+ *
+ * Each wake is shown as a process, with one thread per core.
+ */
+void profileDump(Print &out)
+{
+#if WAKE_PROFILER
+  out.println("----- BEGIN WAKE TRACE -----");
+  out.print("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+  bool first = true;
+  for (int i = 1; i <= PROFILE_WAKES; ++i)
+  {
+    const profile_wake_t &wake =
+      profileLog.wakes[(profileLog.current + i) % PROFILE_WAKES];
+    if (wake.seq == 0)
+    {
+      continue; // never recorded
+    }
+
+    out.printf("%s\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%u,"
+               "\"args\":{\"name\":\"Wake %u\"}}",
+               first ? "" : ",", static_cast<unsigned>(wake.seq),
+               static_cast<unsigned>(wake.seq));
+    first = false;
+    const uint32_t count = std::min<uint32_t>(wake.count, PROFILE_MAX_EVENTS);
+    for (uint32_t j = 0; j < count; ++j)
+    {
+      const profile_event_t &e = wake.events[j];
+      const char *name = e.phase < PHASE_COUNT ? PHASE_NAMES[e.phase] : "?";
+      out.printf(",\n{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%lld,"
+                 "\"dur\":%u,\"pid\":%u,\"tid\":%u}",
+                 name, e.phase == PHASE_SLEEP ? "i" : "X",
+                 static_cast<long long>(wake.epochUs + e.startUs),
+                 static_cast<unsigned>(e.durationUs),
+                 static_cast<unsigned>(wake.seq), static_cast<unsigned>(e.core));
+    }
+  }
+  out.println("\n]}");
+  out.println("----- END WAKE TRACE -----");
+#endif
+  return;
+} // end profileDump
+
@@ -15,13 +15,21 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <cassert>
+#include <esp_timer.h>
 #include "_locale.h"
 #include "_strftime.h"
 #include "renderer.h"
 #include "api_response.h"
+#include "background_task.h"
 #include "config.h"
 #include "conversions.h"
 #include "display_utils.h"
+#include "page_buffer.h"
+#include "profiler.h"
+#include "response_cache.h"
+#include "text_metrics.h"
 
 // fonts
 #include FONT_HEADER
@@ -39,7 +47,7 @@
 
 #ifdef DISP_BW_V2
   GxEPD2_BW<GxEPD2_750_T7,
-            GxEPD2_750_T7::HEIGHT> display(
+            GXEPD2_PAGE_HEIGHT(GxEPD2_750_T7::HEIGHT)> display(
     GxEPD2_750_T7(PIN_EPD_CS,
                   PIN_EPD_DC,
                   PIN_EPD_RST,
@@ -47,7 +55,7 @@
 #endif
 #ifdef DISP_3C_B
   GxEPD2_3C<GxEPD2_750c_Z08,
-            GxEPD2_750c_Z08::HEIGHT / 2> display(
+            GXEPD2_PAGE_HEIGHT(GxEPD2_750c_Z08::HEIGHT / 2)> display(
     GxEPD2_750c_Z08(PIN_EPD_CS,
                     PIN_EPD_DC,
                     PIN_EPD_RST,
@@ -63,7 +71,7 @@
 #endif
 #ifdef DISP_BW_V1
   GxEPD2_BW<GxEPD2_750,
-            GxEPD2_750::HEIGHT> display(
+            GXEPD2_PAGE_HEIGHT(GxEPD2_750::HEIGHT)> display(
     GxEPD2_750(PIN_EPD_CS,
                PIN_EPD_DC,
                PIN_EPD_RST,
@@ -74,14 +82,194 @@
   #define ACCENT_COLOR GxEPD_BLACK
 #endif
 
+DisplayList canvas(DISP_WIDTH, DISP_HEIGHT);
+#if DIRECT_PAGE_BUFFER
+static PageBuffer pageBuffer;
+#endif
+#if PIPELINED_DISPLAY_INIT
+static background_task_t displayTask = {};
+// only initializes the panel, the canvas stays with setup()
+static background_task_t panelTask = {};
+#endif
+
+/* The display init task draws in canvas and builds the text metrics from the
+ * other core, and neither is thread safe. Both belong to the task from
+ * beginDisplayInit() until awaitDisplay() returns, so nothing else may draw or
+ * measure text meanwhile. Called by the drawing entry points to enforce it.
+ */
+static inline void assertCanvasOwner()
+{
+#if PIPELINED_DISPLAY_INIT
+  assert(backgroundTaskHandedBack(displayTask));
+#endif
+  return;
+} // end assertCanvasOwner
+
+#if DIRECT_PAGE_BUFFER
+/* Draws a recorded alpha bar on the page buffer, a byte at a time: even
+ * columns of every other row, starting from the bottom row. replayCommand()
+ * finds it over the generic one by argument-dependent lookup.
+ */
+static void replayAlphaBar(PageBuffer &gfx, const dl_command_t &c)
+{
+  uint8_t pattern[8];
+  for (int row = 0; row < 8; ++row)
+  {
+    pattern[row] = (row & 1) == ((c.y1 - 1) & 1) ? 0xAA : 0x00;
+  }
+  gfx.fillPattern(c.x0, c.y0, c.x1 - c.x0, c.y1 - c.y0, pattern, c.color);
+  return;
+} // end replayAlphaBar
+
+/* Draws every page of the window set on the page buffer and sends it to the
+ * panel, see PageBuffer::writePage() for again.
+ */
+static void writePages(int pages, bool again)
+{
+  for (int page = 0; page < pages; ++page)
+  {
+    int64_t phaseStart = profileStart();
+    // a single page is still in the buffer
+    if (!again || pages > 1)
+    {
+      int16_t x0, y0, x1, y1;
+      pageBuffer.setPage(page);
+      pageBuffer.getPageBounds(x0, y0, x1, y1);
+      replayPage(pageBuffer, canvas, x0, y0, x1, y1);
+    }
+    profileEnd(PHASE_RENDER_PAGE, phaseStart);
+
+    phaseStart = profileStart();
+    pageBuffer.writePage(again);
+    profileEnd(PHASE_PAGE_TRANSFER, phaseStart);
+  }
+  return;
+} // end writePages
+
+/* Draws the recorded frame in the window x, y, w, h of the page buffer, page
+ * by page, refreshes the panel, then clears the record. Each page only replays
+ * the commands that reach it. The window gets a partial refresh unless it is
+ * the full window.
+ */
+static void drawPages(int16_t x, int16_t y, int16_t w, int16_t h, bool partial)
+{
+  assertCanvasOwner();
+  const int pages = pageBuffer.setWindow(x, y, w, h, partial);
+#if DEBUG_LEVEL >= 1
+  Serial.println("[debug] Display list       : " + String(canvas.size())
+                 + " commands over " + String(pages) + " pages");
+#endif
+  writePages(pages, false);
+
+  int64_t phaseStart = profileStart();
+  pageBuffer.refresh();
+  profileEnd(PHASE_PANEL_REFRESH, phaseStart);
+  if (display.epd2.hasFastPartialUpdate)
+  { // the next partial refresh is relative to what the panel now shows
+    writePages(pages, true);
+  }
+
+  canvas.clear();
+  return;
+} // end drawPages
+
+void drawFrame(int16_t x, int16_t y, int16_t w, int16_t h)
+{
+  drawPages(x, y, w, h, true);
+  return;
+} // end drawFrame
+
+void drawFrame()
+{
+  drawPages(0, 0, display.width(), display.height(), false);
+  return;
+} // end drawFrame
+
+#else
+/* Gets the part of the screen that page of the window x, y, w, h covers, in
+ * display coordinates. GxEPD2 pages along the rows of the panel, whatever the
+ * rotation, so only one axis is bounded.
+ */
+static void getPageBounds(int page, int16_t x, int16_t y, int16_t w, int16_t h,
+                          int16_t &x0, int16_t &y0, int16_t &x1, int16_t &y1)
+{
+  const int16_t panelHeight = display.epd2.HEIGHT;
+  // window rows on the panel
+  int16_t rowStart, rows;
+  switch (display.getRotation())
+  {
+    case 0:  rowStart = y;                   rows = h; break;
+    case 1:  rowStart = x;                   rows = w; break;
+    case 2:  rowStart = panelHeight - y - h; rows = h; break;
+    default: rowStart = panelHeight - x - w; rows = w; break;
+  }
+  const int16_t row0 = rowStart + page * display.pageHeight();
+  const int16_t row1 = std::min<int16_t>(row0 + display.pageHeight(),
+                                         rowStart + rows);
+
+  x0 = y0 = INT16_MIN;
+  x1 = y1 = INT16_MAX;
+  switch (display.getRotation())
+  {
+    case 0:  y0 = row0;               y1 = row1;               break;
+    case 1:  x0 = row0;               x1 = row1;               break;
+    case 2:  y0 = panelHeight - row1; y1 = panelHeight - row0; break;
+    default: x0 = panelHeight - row1; x1 = panelHeight - row0; break;
+  }
+  return;
+} // end getPageBounds
+
+/* Draws the recorded frame in the window x, y, w, h set on the display (the
+ * full window unless setPartialWindow() was called), then clears the record.
+ * Each page only replays the commands that reach it. The panel is refreshed
+ * once the last page has been transferred.
+ */
+void drawFrame(int16_t x, int16_t y, int16_t w, int16_t h)
+{
+  assertCanvasOwner();
+#if DEBUG_LEVEL >= 1
+  Serial.println("[debug] Display list       : " + String(canvas.size())
+                 + " commands over " + String(display.pages()) + " pages");
+#endif
+  int page = 0;
+  bool morePages;
+  do
+  {
+    int64_t phaseStart = profileStart();
+    int16_t x0, y0, x1, y1;
+    // pages start over for the second phase of some partial refreshes
+    getPageBounds(page % display.pages(), x, y, w, h, x0, y0, x1, y1);
+    replayPage(display, canvas, x0, y0, x1, y1);
+    profileEnd(PHASE_RENDER_PAGE, phaseStart);
+
+    phaseStart = profileStart();
+    morePages = display.nextPage();
+    profileEnd(morePages ? PHASE_PAGE_TRANSFER : PHASE_PANEL_REFRESH,
+               phaseStart);
+    ++page;
+  } while (morePages);
+
+  canvas.clear();
+  return;
+} // end drawFrame
+
+void drawFrame()
+{
+  drawFrame(0, 0, display.width(), display.height());
+  return;
+} // end drawFrame
+#endif
+
 /* Returns the string width in pixels
  */
+uint16_t getStringWidth(const char *text)
+{
+  return getTextWidth(canvas.getFont(), text, strlen(text));
+}
+
 uint16_t getStringWidth(const String &text)
 {
-  int16_t x1, y1;
-  uint16_t w, h;
-  display.getTextBounds(text, 0, 0, &x1, &y1, &w, &h);
-  return w;
+  return getTextWidth(canvas.getFont(), text.c_str(), text.length());
 }
 
 /* Returns the string height in pixels
@@ -90,43 +278,35 @@ uint16_t getStringHeight(const String &text)
 {
   int16_t x1, y1;
   uint16_t w, h;
-  display.getTextBounds(text, 0, 0, &x1, &y1, &w, &h);
+  canvas.getTextBounds(text, 0, 0, &x1, &y1, &w, &h);
   return h;
 }
 
 void drawAlphaBar(int16_t x0_t, int16_t y0_t, int16_t x1_t, int16_t y1_t, uint16_t color)
 {
-    for (int y = y1_t - 1; y > y0_t; y -= 2)
-    {
-      for (int x = x0_t + (x0_t % 2); x < x1_t; x += 2)
-      {
-        display.drawPixel(x, y, color);
-      }
-    }
+  canvas.drawAlphaBar(x0_t, y0_t, x1_t, y1_t, color);
 }
 
 void drawBox(int16_t x, int16_t y, int16_t w, int16_t h)
 {
-  display.drawFastHLine(x,y,w,GxEPD_BLACK);
-  display.drawFastHLine(x,y+h,w,ACCENT_COLOR);
-  display.drawFastVLine(x,y,h,GxEPD_BLACK);
-  display.drawFastVLine(x+w,y,h,ACCENT_COLOR);
+  canvas.drawFastHLine(x,y,w,GxEPD_BLACK);
+  canvas.drawFastHLine(x,y+h,w,ACCENT_COLOR);
+  canvas.drawFastVLine(x,y,h,GxEPD_BLACK);
+  canvas.drawFastVLine(x+w,y,h,ACCENT_COLOR);
 
-  display.drawFastHLine(x,y+1,w,GxEPD_BLACK);
-  display.drawFastHLine(x,y+h-1,w,ACCENT_COLOR);
-  display.drawFastVLine(x+1,y,h,GxEPD_BLACK);
-  display.drawFastVLine(x+w-1,y,h,ACCENT_COLOR);
+  canvas.drawFastHLine(x,y+1,w,GxEPD_BLACK);
+  canvas.drawFastHLine(x,y+h-1,w,ACCENT_COLOR);
+  canvas.drawFastVLine(x+1,y,h,GxEPD_BLACK);
+  canvas.drawFastVLine(x+w-1,y,h,ACCENT_COLOR);
 
 }
 
-/* Draws a string with alignment
+/* Draws len characters of text, w pixels wide, with alignment.
  */
-void drawString(int16_t x, int16_t y, const String &text, alignment_t alignment, uint16_t color)
+static void drawText(int16_t x, int16_t y, const char *text, size_t len,
+                     uint16_t w, alignment_t alignment, uint16_t color)
 {
-  int16_t x1, y1;
-  uint16_t w, h;
-  display.setTextColor(color);
-  display.getTextBounds(text, x, y, &x1, &y1, &w, &h);
+  canvas.setTextColor(color);
   if (alignment == RIGHT)
   {
     x = x - w;
@@ -135,14 +315,33 @@ void drawString(int16_t x, int16_t y, const String &text, alignment_t alignment,
   {
     x = x - w / 2;
   }
-  display.setCursor(x, y);
-  display.print(text);
+  canvas.setCursor(x, y);
+  canvas.write(text, len);
+  return;
+} // end drawText
+
+/* Draws a string with alignment
+ */
+void drawString(int16_t x, int16_t y, const String &text, alignment_t alignment, uint16_t color)
+{
+  drawText(x, y, text.c_str(), text.length(),
+           getTextWidth(canvas.getFont(), text.c_str(), text.length()),
+           alignment, color);
+  return;
+} // end drawString
+
+void drawString(int16_t x, int16_t y, const char *text, alignment_t alignment, uint16_t color)
+{
+  const size_t len = strlen(text);
+  drawText(x, y, text, len, getTextWidth(canvas.getFont(), text, len),
+           alignment, color);
   return;
 } // end drawString
 
 /* Draws a string that will flow into the next line when max_width is reached.
  * If a string exceeds max_lines an ellipsis (...) will terminate the last word.
- * Lines will break at spaces(' ') and dashes('-').
+ * Lines will break at spaces(' '), after dashes('-') and at line breaks ("<br>"
+ * or '\n'). Lines are measured once, as they are broken, see nextLine().
  *
  * Note: max_width should be big enough to accommodate the largest word that
  *       will be displayed. If an unbroken string of characters longer than
@@ -154,130 +353,51 @@ void drawMultiLnString(int16_t x, int16_t y, const String &text,
                        uint16_t max_lines, int16_t line_spacing,
                        uint16_t color)
 {
-
-  uint16_t current_line = 0;
-  String textRemaining = text;
-  // print until we reach max_lines or no more text remains
-
-  while (current_line < max_lines && !textRemaining.isEmpty())
+  const GFXfont *font = canvas.getFont();
+  const char *remaining = text.c_str();
+  const char *end = remaining + text.length();
+  text_line_t line;
+  for (uint16_t current_line = 0;
+       current_line < max_lines
+       && nextLine(font, remaining, end, max_width,
+                   current_line == max_lines - 1, line);
+       ++current_line)
   {
-    int16_t  x1, y1;
-    uint16_t w, h;
-
-    display.getTextBounds(textRemaining, 0, 0, &x1, &y1, &w, &h);
-
-    int endIndex = textRemaining.length();
-    // check if remaining text is to wide, if it is then print what we can
-    String subStr = textRemaining;
-    int splitAt = 0;
-    int keepLastChar = 0;
-    int cr = 0;
-
-    while (w > max_width && splitAt != -1)
+    drawText(x, y + (current_line * line_spacing), line.text, line.len,
+             line.width, alignment, color);
+    if (line.ellipsis)
     {
-      if (keepLastChar)
-      {
-        // if we kept the last character during the last iteration of this while
-        // loop, remove it now so we don't get stuck in an infinite loop.
-        subStr.remove(subStr.length() - 1);
-      }
-
-      // find the last place in the string that we can break it.
-      if (current_line < max_lines - 1)
-      {
-        splitAt = std::max(subStr.lastIndexOf(" "), subStr.lastIndexOf("-"));
-      }
-      else
-      {
-        // this is the last line, only break at spaces so we can add ellipsis
-        splitAt = subStr.lastIndexOf(" ");
-      }
-
-      // Make cariage return on <br>
-      if (subStr.lastIndexOf("<"))
-      {
-        splitAt = subStr.lastIndexOf("<") - 1;
-        cr = 1;
-      }
-
-      // if splitAt == -1 then there is an unbroken set of characters that is
-      // longer than max_width. Otherwise if splitAt != -1 then we can continue
-      // the loop until the string is <= max_width
-      if (splitAt != -1)
-      {
-        endIndex = splitAt;
-        subStr = subStr.substring(0, endIndex + 1);
-
-        if (cr == 1)
-        {
-          endIndex +=3;
-        }
-
-        char lastChar = subStr.charAt(endIndex);
-        if (lastChar == ' ')
-        {
-          // remove this char now so it is not counted towards line width
-          keepLastChar = 0;
-          subStr.remove(endIndex);
-          --endIndex;
-        }
-        else if (lastChar == '-')
-        {
-          // this char will be printed on this line and removed next iteration
-          keepLastChar = 1;
-        }
-
-        if (current_line < max_lines - 1)
-        {
-          // this is not the last line
-          display.getTextBounds(subStr, 0, 0, &x1, &y1, &w, &h);
-        }
-        else
-        {
-          // this is the last line, we need to make sure there is space for
-          // ellipsis
-          display.getTextBounds(subStr + "...", 0, 0, &x1, &y1, &w, &h);
-          if (w <= max_width)
-          {
-            // ellipsis fit, add them to subStr
-            subStr = subStr + "...";
-          }
-        }
-
-      } // end if (splitAt != -1)
-    } // end inner while
-
-    drawString(x, y + (current_line * line_spacing), subStr, alignment, color);
-
-    // update textRemaining to no longer include what was printed
-    // +1 for exclusive bounds, +1 to get passed space/dash
-    textRemaining = textRemaining.substring(endIndex + 2 - keepLastChar);
-
-    ++current_line;
-  } // end outer while
-
+      canvas.print("...");
+    }
+  }
   return;
 } // end drawMultiLnString
 
-/* Initialize e-paper display
+// landscape, for the panel and everything drawn for it
+static const uint8_t DISPLAY_ROTATION = 1;
+
+/* Powers the e-paper panel up and initializes it, without touching the canvas.
+ * initial must be true unless the panel still shows what was last drawn, which
+ * allows partial refreshes.
  */
-void initDisplay()
+static void initPanel(bool initial)
 {
+  int64_t initStart = profileStart();
   pinMode(PIN_EPD_PWR, OUTPUT);
   digitalWrite(PIN_EPD_PWR, HIGH);
 
 #ifdef DRIVER_WAVESHARE
-  display.init(115200, true, 2, false);
+  display.init(115200, initial, 2, false);
 #endif
 #ifdef DRIVER_DESPI_C02
-  display.init(115200, true, 10, false);
+  display.init(115200, initial, 10, false);
 #endif
 
   // remap spi
   SPI.end();
   SPI.begin(PIN_EPD_SCK, PIN_EPD_MISO, PIN_EPD_MOSI, PIN_EPD_CS);
 
-  display.setRotation(1);
+  display.setRotation(DISPLAY_ROTATION);
   display.setTextSize(1);
   display.setTextColor(GxEPD_BLACK);
   display.setTextWrap(false);
@@ -285,6 +405,35 @@ void initDisplay()
   display.setFullWindow();
   display.firstPage(); // use paged drawing mode, sets fillScreen(GxEPD_WHITE)
 
+  profileEnd(PHASE_DISPLAY_INIT, initStart);
+  return;
+} // end initPanel
+
+/* Sets up the canvas the frame is recorded in, and the page buffer it is
+ * replayed on, to match the panel.
+ */
+static void initCanvas()
+{
+  canvas.setRotation(DISPLAY_ROTATION);
+#if DIRECT_PAGE_BUFFER
+  pageBuffer.setRotation(DISPLAY_ROTATION);
+  pageBuffer.setTextSize(1);
+  pageBuffer.setTextWrap(false);
+#endif
+  canvas.setTextSize(1);
+  canvas.setTextColor(GxEPD_BLACK);
+  canvas.setTextWrap(false);
+  return;
+} // end initCanvas
+
+/* Initialize e-paper display.
+ * initial must be true unless the panel still shows what was last drawn, which
+ * allows partial refreshes.
+ */
+void initDisplay(bool initial)
+{
+  initPanel(initial);
+  initCanvas();
   return;
 } // end initDisplay
 
@@ -298,20 +447,191 @@ void powerOffDisplay()
   return;
 } // end initDisplay
 
+#if PIPELINED_DISPLAY_INIT
+static bool staticLayoutDrawn = false;
+static bool displayInitial = true;
+
+/* Initializes the e-paper display, from the core that is not running setup().
+ */
+static void displayInitTask(void *arg)
+{
+  initDisplay(displayInitial);
+  // When the whole frame fits in a single page, the buffer will not be cleared
+  // again before it is sent to the panel, so the static layout can be drawn
+  // right away.
+#if DIRECT_PAGE_BUFFER
+  // The record is replayed on every page, so the static layout can be
+  // recorded ahead whatever the number of pages.
+  drawStaticLayout();
+  staticLayoutDrawn = true;
+#else
+  if (display.pages() == 1)
+  {
+    drawStaticLayout();
+    replayPage(display, canvas, INT16_MIN, INT16_MIN, INT16_MAX, INT16_MAX);
+    canvas.clear();
+    staticLayoutDrawn = true;
+  }
+#endif
+  return;
+} // end displayInitTask
+
+/* Initializes the e-paper panel, from the core that is not running setup().
+ */
+static void panelInitTask(void *arg)
+{
+  initPanel(displayInitial);
+  return;
+} // end panelInitTask
+#endif
+
+/* Starts initializing the e-paper display on the core that is not running
+ * setup(), so that it overlaps with WiFi association and the API requests.
+ * Does nothing if PIPELINED_DISPLAY_INIT is disabled, awaitDisplay() will then
+ * initialize the display itself.
+ */
+void beginDisplayInit(bool initial)
+{
+#if PIPELINED_DISPLAY_INIT
+  displayInitial = initial;
+  // if the task cannot be started, awaitDisplay() falls back to initDisplay()
+  startBackgroundTask(displayTask, displayInitTask, NULL, "epd_init", 8192);
+#endif
+  return;
+} // end beginDisplayInit
+
+/* Starts powering up and initializing the e-paper panel on the core that is not
+ * running setup(), so that it overlaps with the recording of the frame. Unlike
+ * beginDisplayInit(), the canvas is set up right away and stays with the
+ * caller, which draws the static layout itself. Does nothing but set up the
+ * canvas if PIPELINED_DISPLAY_INIT is disabled, awaitDisplay() will then
+ * initialize the panel itself.
+ */
+void beginPanelInit(bool initial)
+{
+  initCanvas();
+#if PIPELINED_DISPLAY_INIT
+  displayInitial = initial;
+  // if the task cannot be started, awaitDisplay() falls back to initDisplay()
+  startBackgroundTask(panelTask, panelInitTask, NULL, "epd_init", 8192);
+#endif
+  return;
+} // end beginPanelInit
+
+#if DEBUG_LEVEL >= 1
+/* Prints how long setup() waited for the display, and how much of the
+ * initialization and static layout was done meanwhile, overlapped with WiFi and
+ * the API requests. Printed the same way without PIPELINED_DISPLAY_INIT, where
+ * nothing is saved, so wakes with and without it can be compared.
+ */
+static void printDisplayWait(int64_t waitUs, int64_t savedUs)
+{
+  Serial.println("[debug] Waited for display  : "
+                 + String(static_cast<long>(waitUs / 1000)) + " ms, saved "
+                 + String(static_cast<long>(savedUs / 1000)) + " ms");
+  return;
+} // end printDisplayWait
+#endif
+
+/* Blocks until the display started by beginDisplayInit() or beginPanelInit()
+ * is ready, or initializes it now if it was never started, see initDisplay()
+ * for initial.
+ * If keepLayout is false, a static layout already drawn in the background is
+ * erased (i.e. before drawing an error screen).
+ *
+ * Returns true if the static layout is already in the frame buffer, in which
+ * case drawStaticLayout() must not be called again.
+ */
+bool awaitDisplay(bool keepLayout, bool initial)
+{
+#if PIPELINED_DISPLAY_INIT
+  if (backgroundTaskPending(panelTask))
+  {
+    const int64_t waitUs __attribute__((unused))
+      = awaitBackgroundTask(panelTask);
+#if DEBUG_LEVEL >= 1
+    printDisplayWait(waitUs, panelTask.runUs - waitUs);
+#endif
+    return false;
+  }
+  if (backgroundTaskPending(displayTask))
+  {
+    const int64_t waitUs __attribute__((unused))
+      = awaitBackgroundTask(displayTask);
+#if DEBUG_LEVEL >= 1
+    printDisplayWait(waitUs, displayTask.runUs - waitUs);
+#endif
+    if (staticLayoutDrawn && !keepLayout)
+    {
+#if DIRECT_PAGE_BUFFER
+      canvas.clear();
+#else
+      display.fillScreen(GxEPD_WHITE);
+#endif
+      staticLayoutDrawn = false;
+    }
+    return staticLayoutDrawn;
+  }
+#endif
+#if DEBUG_LEVEL >= 1
+  const int64_t initStart = esp_timer_get_time();
+#endif
+  initDisplay(initial);
+#if DEBUG_LEVEL >= 1
+  printDisplayWait(esp_timer_get_time() - initStart, 0);
+#endif
+  return false;
+} // end awaitDisplay
+
+/* This function is responsible for drawing the parts of the layout that do not
+ * depend on any fetched data: the boxes, fixed labels and icons.
+ */
+void drawStaticLayout()
+{
+  assertCanvasOwner();
+  // current weather data icons
+  canvas.drawInvertedBitmap(10 + X_OFFSET, Y_OFFSET + 184 + (48 + 8) * 0, wi_raindrops_48x48, 48, 48, GxEPD_BLACK);
+  canvas.drawInvertedBitmap(160 + X_OFFSET, Y_OFFSET + 184 + (48 + 8) * 0, wi_day_sunny_48x48, 48, 48, GxEPD_BLACK);
+  canvas.drawInvertedBitmap(310 + X_OFFSET, Y_OFFSET + 184 + (48 + 8) * 0, wi_strong_wind_48x48, 48, 48, GxEPD_BLACK);
+
+  // current weather data labels
+  canvas.setFont(&FONT_7pt8b);
+  drawString(X_OFFSET + 58, Y_OFFSET +184 + 10 + (48 + 8) * 0, "% Pluie", LEFT);
+  drawString(X_OFFSET + 160 + 48, Y_OFFSET +184 + 10 + (48 + 8) * 0, TXT_UV_INDEX, LEFT);
+  drawString(X_OFFSET + 310 + 48, Y_OFFSET +184 + 10 + (48 + 8) * 0, TXT_WIND, LEFT);
+
+  // forecast box and day of week band
+  canvas.drawRoundRect(X_OFFSET + 1, Y_OFFSET + 245, USABLE_WIDTH - 2, 126, 10, GxEPD_BLACK);
+  drawAlphaBar(X_OFFSET + 1, Y_OFFSET + 245 + 3, X_OFFSET + USABLE_WIDTH - 2, Y_OFFSET + 245 + 3 + 35, GxEPD_BLACK);
+
+  // Domoticz, make 3 zones
+  canvas.drawRoundRect(X_OFFSET + 1 , Y_OFFSET + 372, USABLE_WIDTH / 2 - 2, 296, 10, GxEPD_BLACK); // icons
+  canvas.drawRoundRect(X_OFFSET + USABLE_WIDTH / 2 , Y_OFFSET + 372, USABLE_WIDTH / 2 - 2, 150, 10, GxEPD_BLACK); // graph
+  canvas.drawRoundRect(X_OFFSET + USABLE_WIDTH / 2 , Y_OFFSET + 372 + 150 + 1, USABLE_WIDTH / 2 - 2, 146, 10, GxEPD_BLACK); // To remember
+
+  // Remember list header
+  canvas.fillRoundRect(X_OFFSET + USABLE_WIDTH / 2 + 1 , Y_OFFSET + 372 + 150 + 2 , USABLE_WIDTH / 2 - 4, 25, 10, ACCENT_COLOR);
+  canvas.setFont(&FONT_9pt8b);
+  drawString(X_OFFSET + 3 * USABLE_WIDTH / 4 , Y_OFFSET + 372 + 150 + 20 , "Ne pas oublier" , CENTER);
+
+  return;
+} // end drawStaticLayout
+
 /* This function is responsible for drawing the current conditions and
  * associated icons.
  */
 void drawCurrentConditions(const meteo_current_t &current, const meteo_daily_t &today , float inTemp, float inHumidity, const String &date)
 {
+  assertCanvasOwner();
 
   //Just for test to check size
-  //display.drawRoundRect(0+36,0+61,480-40,800-115,10,GxEPD_BLACK);
+  //canvas.drawRoundRect(0+36,0+61,480-40,800-115,10,GxEPD_BLACK);
 
   String dataStr, unitStr;
 
   // current weather icon
-  display.drawInvertedBitmap(X_OFFSET, Y_OFFSET, getCurrentConditionsBitmap196(current, today), 196, 196, GxEPD_BLACK);
-  //display.drawRoundRect(X_OFFSET,Y_OFFSET,196,196,10,GxEPD_BLACK);
+  canvas.drawInvertedBitmap(X_OFFSET, Y_OFFSET, getCurrentConditionsBitmap196(current, today), 196, 196, GxEPD_BLACK);
+  //canvas.drawRoundRect(X_OFFSET,Y_OFFSET,196,196,10,GxEPD_BLACK);
 
   // current temp
   dataStr = String(static_cast<int>(std::round(current.temp_min)));
@@ -325,35 +645,27 @@ void drawCurrentConditions(const meteo_current_t &current, const meteo_daily_t &
 #endif
   // FONT_**_temperature fonts only have the character set used for displaying temperature (0123456789.-\260)
   // TODO : Use this kind of font
-  //display.setFont(&FONT_48pt8b_temperature);
-  display.setFont(&FONT_22pt8b);
+  //canvas.setFont(&FONT_48pt8b_temperature);
+  canvas.setFont(&FONT_22pt8b);
 #ifndef DISP_BW_V1
     drawString(X_OFFSET + 196 + 164 / 2 - 30, Y_OFFSET + 196 / 2 + 69 / 2 - 20, dataStr, CENTER);
 #elif defined(DISP_BW_V1)
     drawString(X_OFFSET + 156 + 164 / 2 - 20, Y_OFFSET + 196 / 2 + 69 / 2, dataStr, CENTER);
 #endif
-  display.setFont(&FONT_14pt8b);
-  drawString(display.getCursorX(), Y_OFFSET + 196 / 2 - 69 / 2 + 20, unitStr, LEFT);
+  canvas.setFont(&FONT_14pt8b);
+  drawString(canvas.getCursorX(), Y_OFFSET + 196 / 2 - 69 / 2 + 20, unitStr, LEFT);
 
   // Date
-  display.setFont(&FONT_12pt8b);
+  canvas.setFont(&FONT_12pt8b);
   drawString(USABLE_WIDTH + X_OFFSET - 7, Y_OFFSET + 20, date, RIGHT);
 
   //Alerts
-  display.drawInvertedBitmap(USABLE_WIDTH + X_OFFSET - 5 - 50, Y_OFFSET + 50, alert_icon(current.alert[0]), 48, 48, ACCENT_COLOR);
-
-  // current weather data icons
-  display.drawInvertedBitmap(10 + X_OFFSET, Y_OFFSET + 184 + (48 + 8) * 0, wi_raindrops_48x48, 48, 48, GxEPD_BLACK);
-  display.drawInvertedBitmap(160 + X_OFFSET, Y_OFFSET + 184 + (48 + 8) * 0, wi_day_sunny_48x48, 48, 48, GxEPD_BLACK);
-  display.drawInvertedBitmap(310 + X_OFFSET, Y_OFFSET + 184 + (48 + 8) * 0, wi_strong_wind_48x48, 48, 48, GxEPD_BLACK);
+  canvas.drawInvertedBitmap(USABLE_WIDTH + X_OFFSET - 5 - 50, Y_OFFSET + 50, alert_icon(current.alert[0]), 48, 48, ACCENT_COLOR);
 
-  // current weather data labels
-  display.setFont(&FONT_7pt8b);
-  drawString(X_OFFSET + 58, Y_OFFSET +184 + 10 + (48 + 8) * 0, "% Pluie", LEFT);
-  drawString(X_OFFSET + 160 + 48, Y_OFFSET +184 + 10 + (48 + 8) * 0, TXT_UV_INDEX, LEFT);
-  drawString(X_OFFSET + 310 + 48, Y_OFFSET +184 + 10 + (48 + 8) * 0, TXT_WIND, LEFT);
+  // current weather data icons and labels are drawn by drawStaticLayout()
 
   // wind
+  canvas.setFont(&FONT_7pt8b);
   dataStr = String(static_cast<int>(std::round(current.wind_speed)));
 #ifdef UNITS_SPEED_METERSPERSECOND
   unitStr = String(" ") + TXT_UNITS_SPEED_METERSPERSECOND;
@@ -374,41 +686,41 @@ void drawCurrentConditions(const meteo_current_t &current, const meteo_daily_t &
   unitStr = String(" ") + TXT_UNITS_SPEED_BEAUFORT;
 #endif
   drawString(X_OFFSET + 58 + 310 , Y_OFFSET + 184 + 17 / 2 + (48 + 8) * 0 + 48 / 2, dataStr, LEFT);
-  display.setFont(&FONT_8pt8b);
-  drawString(display.getCursorX(), Y_OFFSET + 184 + 17 / 2 + (48 + 8) * 0 + 48 / 2, unitStr, LEFT);
+  canvas.setFont(&FONT_8pt8b);
+  drawString(canvas.getCursorX(), Y_OFFSET + 184 + 17 / 2 + (48 + 8) * 0 + 48 / 2, unitStr, LEFT);
 
   // uv and air quality indices
   // spacing between end of index value and start of descriptor text
   const int sp = 8;
 
   // uv index
-  display.setFont(&FONT_12pt8b);
+  canvas.setFont(&FONT_12pt8b);
   unsigned int uvi = static_cast<unsigned int>(std::max(std::round(current.uvi), 0.0f));
   dataStr = String(uvi);
   drawString(X_OFFSET + 150 + 58, Y_OFFSET + 184 + 17 / 2 + (48 + 8) * 0 + 48 / 2, dataStr, LEFT);
-  display.setFont(&FONT_7pt8b);
+  canvas.setFont(&FONT_7pt8b);
   dataStr = String(getUVIdesc(uvi));
-  int max_w = 170 - (display.getCursorX() + sp);
+  int max_w = 170 - (canvas.getCursorX() + sp);
   if (getStringWidth(dataStr) <= max_w)
   { // Fits on a single line, draw along bottom
-    drawString(display.getCursorX() + sp, Y_OFFSET + 184 + 17 / 2 + (48 + 8) * 0 + 48 / 2, dataStr, LEFT);
+    drawString(canvas.getCursorX() + sp, Y_OFFSET + 184 + 17 / 2 + (48 + 8) * 0 + 48 / 2, dataStr, LEFT);
   }
   else
   { // use smaller font
-    display.setFont(&FONT_5pt8b);
+    canvas.setFont(&FONT_5pt8b);
     if (getStringWidth(dataStr) <= max_w)
     { // Fits on a single line with smaller font, draw along bottom
-      drawString(display.getCursorX() + sp, Y_OFFSET + 184 + 17 / 2 + (48 + 8) * 0 + 48 / 2, dataStr, LEFT);
+      drawString(canvas.getCursorX() + sp, Y_OFFSET + 184 + 17 / 2 + (48 + 8) * 0 + 48 / 2, dataStr, LEFT);
     }
     else
     { // Does not fit on a single line, draw higher to allow room for 2nd line
-      drawMultiLnString(display.getCursorX() + sp, Y_OFFSET + 184 + 17 / 2 + (48 + 8) * 0 + 48 / 2 - 10, dataStr, LEFT, max_w, 2, 10);
+      drawMultiLnString(canvas.getCursorX() + sp, Y_OFFSET + 184 + 17 / 2 + (48 + 8) * 0 + 48 / 2 - 10, dataStr, LEFT, max_w, 2, 10);
     }
   }
 
   //Rain probability
   dataStr = String(static_cast<int>(std::round(current.pop))) + "%";
-  display.setFont(&FONT_7pt8b);
+  canvas.setFont(&FONT_7pt8b);
   drawString(X_OFFSET + 58 , Y_OFFSET + 184 + 17 / 2 + (48 + 8) * 0 + 48 / 2, dataStr, LEFT);
 
 
@@ -457,19 +769,14 @@ const unsigned char * hackicon(int v)
 
 /* This function is responsible for drawing the Domoticz part.
 */
-void drawDomoticz(const domoticz_t *data, String memo)
+void drawDomoticz(const domoticz_t *data, const char *memo)
 {
+  assertCanvasOwner();
 
-  //Make 3 zones
-  display.drawRoundRect(X_OFFSET + 1 , Y_OFFSET + 372, USABLE_WIDTH / 2 - 2, 296, 10, GxEPD_BLACK); // icons 
-  display.drawRoundRect(X_OFFSET + USABLE_WIDTH / 2 , Y_OFFSET + 372, USABLE_WIDTH / 2 - 2, 150, 10, GxEPD_BLACK); // graph 
-  display.drawRoundRect(X_OFFSET + USABLE_WIDTH / 2 , Y_OFFSET + 372 + 150 + 1, USABLE_WIDTH / 2 - 2, 146, 10, GxEPD_BLACK); // To remember
+  // The 3 zones and the remember list header are drawn by drawStaticLayout()
 
   //Remember list
-  display.fillRoundRect(X_OFFSET + USABLE_WIDTH / 2 + 1 , Y_OFFSET + 372 + 150 + 2 , USABLE_WIDTH / 2 - 4, 25, 10, ACCENT_COLOR);
-  display.setFont(&FONT_9pt8b);
-  drawString(X_OFFSET + 3 * USABLE_WIDTH / 4 , Y_OFFSET + 372 + 150 + 20 , "Ne pas oublier" , CENTER);
-  display.setFont(&FONT_8pt8b);
+  canvas.setFont(&FONT_8pt8b);
   drawMultiLnString(X_OFFSET + USABLE_WIDTH / 2 + 5  , Y_OFFSET + 372 + 150 + 20 + 22, memo, LEFT, USABLE_WIDTH /2 , 6, 15 );
 
   int i = 0;
@@ -486,14 +793,14 @@ void drawDomoticz(const domoticz_t *data, String memo)
         }
 
         // Icon
-        //display.fillRoundRect(X_OFFSET + 3 , 310 + 140 + y * 48 , 48, 48, 10, ACCENT_COLOR);
-        display.drawInvertedBitmap(X_OFFSET + 3 , Y_OFFSET + 372 + 3 + y * 48, hackicon(data[i].icon), 48, 48, GxEPD_BLACK);
+        //canvas.fillRoundRect(X_OFFSET + 3 , 310 + 140 + y * 48 , 48, 48, 10, ACCENT_COLOR);
+        canvas.drawInvertedBitmap(X_OFFSET + 3 , Y_OFFSET + 372 + 3 + y * 48, hackicon(data[i].icon), 48, 48, GxEPD_BLACK);
         // Title
-        display.setFont(&FONT_8pt8b);
-        drawString(X_OFFSET + 5 + 48 ,  Y_OFFSET + 372 + 3 + y * 48 + 48/2 + 4, data[i].description , LEFT);
+        canvas.setFont(&FONT_8pt8b);
+        drawString(X_OFFSET + 5 + 48 ,  Y_OFFSET + 372 + 3 + y * 48 + 48/2 + 4, data[i].description.c_str(), LEFT);
         // Value
-        display.setFont(&FONT_10pt8b);
-        drawString(X_OFFSET + USABLE_WIDTH / 2 - 15 , Y_OFFSET + 372 + 3 + y * 48 + 48/2 + 4, data[i].value, RIGHT);
+        canvas.setFont(&FONT_10pt8b);
+        drawString(X_OFFSET + USABLE_WIDTH / 2 - 15 , Y_OFFSET + 372 + 3 + y * 48 + 48/2 + 4, data[i].value.c_str(), RIGHT);
       }
 
       i += 1;
@@ -507,13 +814,12 @@ void drawDomoticz(const domoticz_t *data, String memo)
 */
 void drawForecast(const meteo_daily_t *daily, tm timeInfo)
 {
+  assertCanvasOwner();
 
   //Don't use the current day
   timeInfo.tm_wday = (timeInfo.tm_wday + 1) % 7; // increment to next day
 
-  display.drawRoundRect(X_OFFSET + 1, Y_OFFSET + 245, USABLE_WIDTH - 2, 126, 10, GxEPD_BLACK);
-
-  drawAlphaBar(X_OFFSET + 1, Y_OFFSET + 245 + 3, X_OFFSET + USABLE_WIDTH - 2, Y_OFFSET + 245 + 3 + 35, GxEPD_BLACK);
+  // The box and the day of week band are drawn by drawStaticLayout()
 
   // 5 day, forecast
   String Str;
@@ -524,17 +830,17 @@ void drawForecast(const meteo_daily_t *daily, tm timeInfo)
     int x = X_OFFSET + 28 + (i * 82);
 
     // icons
-    display.drawInvertedBitmap(x, Y_OFFSET + 245 + 38, getDailyForecastBitmap64(daily[i]), 64, 64, GxEPD_BLACK);
+    canvas.drawInvertedBitmap(x, Y_OFFSET + 245 + 38, getDailyForecastBitmap64(daily[i]), 64, 64, GxEPD_BLACK);
 
     // day of week label
-    display.setFont(&FONT_11pt8b);
+    canvas.setFont(&FONT_11pt8b);
     char dayBuffer[8] = {};
     _strftime(dayBuffer, sizeof(dayBuffer), "%a", &timeInfo); // abbrv'd day
     drawString(x + 31 - 2, Y_OFFSET + 245 + 26, dayBuffer, CENTER);
     timeInfo.tm_wday = (timeInfo.tm_wday + 1) % 7; // increment to next day
 
     // high | low
-    display.setFont(&FONT_8pt8b);
+    canvas.setFont(&FONT_8pt8b);
     Str = String(static_cast<int>(std::round(daily[i].temp_min))) + "/";
     Str += String(static_cast<int>(std::round(daily[i].temp_max))) + "\260C";
 
@@ -571,6 +877,7 @@ int kelvin_to_plot_y(float kelvin, int tempBoundMin, float yPxPerUnit, int yBoun
 
 void drawConsumptionGraph(const domoticz_graph_t *graph , tm timeInfo)
 {
+  assertCanvasOwner();
   const int xPos0 = X_OFFSET + USABLE_WIDTH / 2 + 27;
   int xPos1 = xPos0 + 185;
   const int yPos0 = Y_OFFSET + 384;
@@ -632,8 +939,8 @@ void drawConsumptionGraph(const domoticz_graph_t *graph , tm timeInfo)
   }
 
   // draw x axis
-  display.drawLine(xPos0, yPos1    , xPos1, yPos1    , GxEPD_BLACK);
-  display.drawLine(xPos0, yPos1 - 1, xPos1, yPos1 - 1, GxEPD_BLACK);
+  canvas.drawLine(xPos0, yPos1    , xPos1, yPos1    , GxEPD_BLACK);
+  canvas.drawLine(xPos0, yPos1 - 1, xPos1, yPos1 - 1, GxEPD_BLACK);
 
   // draw y axis
   float yInterval = (yPos1 - yPos0) / static_cast<float>(yMajorTicks);
@@ -641,7 +948,7 @@ void drawConsumptionGraph(const domoticz_graph_t *graph , tm timeInfo)
   {
     String dataStr;
     int yTick = static_cast<int>(yPos0 + (i * yInterval));
-    display.setFont(&FONT_8pt8b);
+    canvas.setFont(&FONT_8pt8b);
 
     dataStr = String(valBoundMax - (i * yTempMajorTicks));
     //dataStr += "Kw/h";
@@ -655,24 +962,22 @@ void drawConsumptionGraph(const domoticz_graph_t *graph , tm timeInfo)
     String precipUnit = "%";
 
     drawString(xPos1 + 8, yTick + 4, dataStr, LEFT);
-    display.setFont(&FONT_5pt8b);
-    drawString(display.getCursorX(), yTick + 4, precipUnit, LEFT);
+    canvas.setFont(&FONT_5pt8b);
+    drawString(canvas.getCursorX(), yTick + 4, precipUnit, LEFT);
 #endif
 
     // draw dotted line
     if (i < yMajorTicks)
     {
-      for (int x = xPos0; x <= xPos1 + 1; x += 3)
-      {
-        display.drawPixel(x, yTick + (yTick % 2), GxEPD_BLACK);
-      }
+      canvas.drawDottedHLine(xPos0, xPos1 + 1, yTick + (yTick % 2), 3,
+                             GxEPD_BLACK);
     }
   }
 
   int xMaxTicks = 8;
   int hourInterval = static_cast<int>(ceil(DAILY_GRAPH_MAX / static_cast<float>(xMaxTicks)));
   float xInterval = (xPos1 - xPos0 - 1) / static_cast<float>(DAILY_GRAPH_MAX);
-  display.setFont(&FONT_8pt8b);
+  canvas.setFont(&FONT_8pt8b);
   
   // precalculate all x and y coordinates for values
   float yPxPerUnit = (yPos1 - yPos0) / static_cast<float>(valBoundMax - valBoundMin);
@@ -688,7 +993,7 @@ void drawConsumptionGraph(const domoticz_graph_t *graph , tm timeInfo)
     x_t[i] = static_cast<int>(std::round(xPos0 + (i * xInterval) + (0.5 * xInterval) ));
   }
 
-  display.setFont(&FONT_8pt8b);
+  canvas.setFont(&FONT_8pt8b);
   for (int i = 0; i < DAILY_GRAPH_MAX; ++i)
   {
     int xTick = static_cast<int>(xPos0 + (i * xInterval));
@@ -702,9 +1007,9 @@ void drawConsumptionGraph(const domoticz_graph_t *graph , tm timeInfo)
       y0_t = y_t[i - 1];
       y1_t = y_t[i    ];
       // graph value
-      display.drawLine(x0_t    , y0_t    , x1_t    , y1_t    , ACCENT_COLOR);
-      display.drawLine(x0_t    , y0_t + 1, x1_t    , y1_t + 1, ACCENT_COLOR);
-      display.drawLine(x0_t - 1, y0_t    , x1_t - 1, y1_t    , ACCENT_COLOR);
+      canvas.drawLine(x0_t    , y0_t    , x1_t    , y1_t    , ACCENT_COLOR);
+      canvas.drawLine(x0_t    , y0_t + 1, x1_t    , y1_t + 1, ACCENT_COLOR);
+      canvas.drawLine(x0_t - 1, y0_t    , x1_t - 1, y1_t    , ACCENT_COLOR);
 
     }
 
@@ -725,8 +1030,8 @@ void drawConsumptionGraph(const domoticz_graph_t *graph , tm timeInfo)
     if ((i % hourInterval) == 0)
     {
       // draw x tick marks
-      display.drawLine(xTick    , yPos1 + 1, xTick    , yPos1 + 4, GxEPD_BLACK);
-      display.drawLine(xTick + 1, yPos1 + 1, xTick + 1, yPos1 + 4, GxEPD_BLACK);
+      canvas.drawLine(xTick    , yPos1 + 1, xTick    , yPos1 + 4, GxEPD_BLACK);
+      canvas.drawLine(xTick + 1, yPos1 + 1, xTick + 1, yPos1 + 4, GxEPD_BLACK);
 
       // draw x axis labels
       drawString(xTick, yPos1 + 1 + 12 + 4 + 3, graph[i + firstday].dt, CENTER);
@@ -741,6 +1046,7 @@ void drawConsumptionGraph(const domoticz_graph_t *graph , tm timeInfo)
 
 void drawOutlookGraph(const meteo_hourly_t *hourly, tm timeInfo)
 {
+  assertCanvasOwner();
 
   const int xPos0 = 274;
   int xPos1 = xPos0 + 160;
@@ -804,8 +1110,8 @@ void drawOutlookGraph(const meteo_hourly_t *hourly, tm timeInfo)
   }
 
   // draw x axis
-  display.drawLine(xPos0, yPos1    , xPos1, yPos1    , GxEPD_BLACK);
-  display.drawLine(xPos0, yPos1 - 1, xPos1, yPos1 - 1, GxEPD_BLACK);
+  canvas.drawLine(xPos0, yPos1    , xPos1, yPos1    , GxEPD_BLACK);
+  canvas.drawLine(xPos0, yPos1 - 1, xPos1, yPos1 - 1, GxEPD_BLACK);
 
   // draw y axis
   float yInterval = (yPos1 - yPos0) / static_cast<float>(yMajorTicks);
@@ -813,7 +1119,7 @@ void drawOutlookGraph(const meteo_hourly_t *hourly, tm timeInfo)
   {
     String dataStr;
     int yTick = static_cast<int>(yPos0 + (i * yInterval));
-    display.setFont(&FONT_8pt8b);
+    canvas.setFont(&FONT_8pt8b);
     // Temperature
     dataStr = String(tempBoundMax - (i * yTempMajorTicks));
     dataStr += "\260";
@@ -828,24 +1134,22 @@ void drawOutlookGraph(const meteo_hourly_t *hourly, tm timeInfo)
       String precipUnit = "%";
 
       drawString(xPos1 + 8, yTick + 4, dataStr, LEFT);
-      display.setFont(&FONT_5pt8b);
-      drawString(display.getCursorX(), yTick + 4, precipUnit, LEFT);
+      canvas.setFont(&FONT_5pt8b);
+      drawString(canvas.getCursorX(), yTick + 4, precipUnit, LEFT);
     } // end draw labels if precip is >0
 
     // draw dotted line
     if (i < yMajorTicks)
     {
-      for (int x = xPos0; x <= xPos1 + 1; x += 3)
-      {
-        display.drawPixel(x, yTick + (yTick % 2), GxEPD_BLACK);
-      }
+      canvas.drawDottedHLine(xPos0, xPos1 + 1, yTick + (yTick % 2), 3,
+                             GxEPD_BLACK);
     }
   }
 
   int xMaxTicks = 8;
   int hourInterval = static_cast<int>(ceil(HOURLY_GRAPH_MAX / static_cast<float>(xMaxTicks)));
   float xInterval = (xPos1 - xPos0 - 1) / static_cast<float>(HOURLY_GRAPH_MAX);
-  display.setFont(&FONT_8pt8b);
+  canvas.setFont(&FONT_8pt8b);
   
   // precalculate all x and y coordinates for temperature values
   float yPxPerUnit = (yPos1 - yPos0) / static_cast<float>(tempBoundMax - tempBoundMin);
@@ -861,7 +1165,7 @@ void drawOutlookGraph(const meteo_hourly_t *hourly, tm timeInfo)
                                           + (0.5 * xInterval) ));
   }
 
-  display.setFont(&FONT_8pt8b);
+  canvas.setFont(&FONT_8pt8b);
   for (int i = 0; i < HOURLY_GRAPH_MAX; ++i)
   {
     int xTick = static_cast<int>(xPos0 + (i * xInterval));
@@ -875,9 +1179,9 @@ void drawOutlookGraph(const meteo_hourly_t *hourly, tm timeInfo)
       y0_t = y_t[i - 1];
       y1_t = y_t[i    ];
       // graph temperature
-      display.drawLine(x0_t    , y0_t    , x1_t    , y1_t    , ACCENT_COLOR);
-      display.drawLine(x0_t    , y0_t + 1, x1_t    , y1_t + 1, ACCENT_COLOR);
-      display.drawLine(x0_t - 1, y0_t    , x1_t - 1, y1_t    , ACCENT_COLOR);
+      canvas.drawLine(x0_t    , y0_t    , x1_t    , y1_t    , ACCENT_COLOR);
+      canvas.drawLine(x0_t    , y0_t + 1, x1_t    , y1_t + 1, ACCENT_COLOR);
+      canvas.drawLine(x0_t - 1, y0_t    , x1_t - 1, y1_t    , ACCENT_COLOR);
 
     }
 
@@ -895,8 +1199,8 @@ void drawOutlookGraph(const meteo_hourly_t *hourly, tm timeInfo)
     if ((i % hourInterval) == 0)
     {
       // draw x tick marks
-      display.drawLine(xTick    , yPos1 + 1, xTick    , yPos1 + 4, GxEPD_BLACK);
-      display.drawLine(xTick + 1, yPos1 + 1, xTick + 1, yPos1 + 4, GxEPD_BLACK);
+      canvas.drawLine(xTick    , yPos1 + 1, xTick    , yPos1 + 4, GxEPD_BLACK);
+      canvas.drawLine(xTick + 1, yPos1 + 1, xTick + 1, yPos1 + 4, GxEPD_BLACK);
       // draw x axis labels
       char timeBuffer[12] = {}; // big enough to accommodate "hh:mm:ss am"
       time_t ts = hourly[i].dt;
@@ -913,8 +1217,8 @@ void drawOutlookGraph(const meteo_hourly_t *hourly, tm timeInfo)
     int xTick = static_cast<int>(
                 std::round(xPos0 + (HOURLY_GRAPH_MAX * xInterval)));
     // draw x tick marks
-    display.drawLine(xTick    , yPos1 + 1, xTick    , yPos1 + 4, GxEPD_BLACK);
-    display.drawLine(xTick + 1, yPos1 + 1, xTick + 1, yPos1 + 4, GxEPD_BLACK);
+    canvas.drawLine(xTick    , yPos1 + 1, xTick    , yPos1 + 4, GxEPD_BLACK);
+    canvas.drawLine(xTick + 1, yPos1 + 1, xTick + 1, yPos1 + 4, GxEPD_BLACK);
     // draw x axis labels
     char timeBuffer[12] = {}; // big enough to accommodate "hh:mm:ss am"
     time_t ts = hourly[HOURLY_GRAPH_MAX - 1].dt + 3600;
@@ -930,13 +1234,14 @@ void drawOutlookGraph(const meteo_hourly_t *hourly, tm timeInfo)
 
 
 /* This function is responsible for drawing the status bar along the bottom of
- * the display.
+ * the canvas.
  */
 void drawStatusBar(const String &statusStr, const String &refreshTimeStr, int rssi, uint32_t batVoltage)
 {
+  assertCanvasOwner();
   String dataStr;
   uint16_t dataColor = GxEPD_BLACK;
-  display.setFont(&FONT_6pt8b);
+  canvas.setFont(&FONT_6pt8b);
   int pos = USABLE_WIDTH - 2;
   const int sp = 2;
 
@@ -955,7 +1260,7 @@ void drawStatusBar(const String &statusStr, const String &refreshTimeStr, int rs
 #endif
   drawString(X_OFFSET + pos, Y_OFFSET + USABLE_HEIGHT - 1 - 2, dataStr, RIGHT, dataColor);
   pos -= getStringWidth(dataStr) + 25;
-  display.drawInvertedBitmap(X_OFFSET + pos, Y_OFFSET + USABLE_HEIGHT - 1 - 17, getBatBitmap24(batPercent), 24, 24, dataColor);
+  canvas.drawInvertedBitmap(X_OFFSET + pos, Y_OFFSET + USABLE_HEIGHT - 1 - 17, getBatBitmap24(batPercent), 24, 24, dataColor);
   pos -= sp + 9;
 #endif
 
@@ -970,14 +1275,14 @@ void drawStatusBar(const String &statusStr, const String &refreshTimeStr, int rs
 #endif
   drawString(X_OFFSET + pos, Y_OFFSET + USABLE_HEIGHT - 1 - 2, dataStr, RIGHT, dataColor);
   pos -= getStringWidth(dataStr) + 19;
-  display.drawInvertedBitmap(X_OFFSET + pos, Y_OFFSET + USABLE_HEIGHT - 1 - 13, getWiFiBitmap16(rssi), 16, 16, dataColor);
+  canvas.drawInvertedBitmap(X_OFFSET + pos, Y_OFFSET + USABLE_HEIGHT - 1 - 13, getWiFiBitmap16(rssi), 16, 16, dataColor);
   pos -= sp + 8;
 
   // last refresh
   dataColor = GxEPD_BLACK;
   drawString(X_OFFSET + pos, Y_OFFSET + USABLE_HEIGHT - 1 - 2, refreshTimeStr, RIGHT, dataColor);
   pos -= getStringWidth(refreshTimeStr) + 25;
-  display.drawInvertedBitmap(X_OFFSET + pos, Y_OFFSET + USABLE_HEIGHT - 1 - 21, wi_refresh_32x32, 32, 32, dataColor);
+  canvas.drawInvertedBitmap(X_OFFSET + pos, Y_OFFSET + USABLE_HEIGHT - 1 - 21, wi_refresh_32x32, 32, 32, dataColor);
   pos -= sp;
 
   // status
@@ -986,12 +1291,168 @@ void drawStatusBar(const String &statusStr, const String &refreshTimeStr, int rs
   {
     drawString(X_OFFSET + pos, Y_OFFSET + USABLE_HEIGHT - 1 - 2, statusStr, RIGHT, dataColor);
     pos -= getStringWidth(statusStr) + 24;
-    display.drawInvertedBitmap(X_OFFSET + pos, Y_OFFSET + USABLE_HEIGHT - 1 - 18, error_icon_24x24, 24, 24, dataColor);
+    canvas.drawInvertedBitmap(X_OFFSET + pos, Y_OFFSET + USABLE_HEIGHT - 1 - 18, error_icon_24x24, 24, 24, dataColor);
   }
 
   return;
 } // end drawStatusBar
 
+/* Adds len bytes of data to the running digest h.
+ */
+static void digestBytes(uint32_t &h, const void *data, size_t len)
+{
+  h = fnv1a32(static_cast<const uint8_t *>(data), len, h);
+  return;
+} // end digestBytes
+
+static void digestInt(uint32_t &h, int32_t v)
+{
+  digestBytes(h, &v, sizeof(v));
+  return;
+} // end digestInt
+
+static void digestPtr(uint32_t &h, const void *p)
+{
+  uintptr_t v = reinterpret_cast<uintptr_t>(p);
+  digestBytes(h, &v, sizeof(v));
+  return;
+} // end digestPtr
+
+static void digestStr(uint32_t &h, const char *s)
+{
+  digestBytes(h, s, strlen(s) + 1);
+  return;
+} // end digestStr
+
+static void digestStr(uint32_t &h, const String &s)
+{
+  digestBytes(h, s.c_str(), s.length() + 1);
+  return;
+} // end digestStr
+
+/* Computes one digest per region of the dashboard, of everything
+ * drawCurrentConditions(), drawForecast(), drawDomoticz(),
+ * drawConsumptionGraph() and drawStatusBar() put in it, taken in the form it
+ * is drawn (rounded values, selected icons, formatted strings). The refresh
+ * time is left out, so that a wake where nothing else changed does not need
+ * to refresh the panel.
+ *
+ * Icons are identified by their address, which is stable across deep sleep.
+ */
+void getRegionDigests(uint32_t digests[REGION_COUNT],
+                      const requested_data_t &r, const tm &timeInfo,
+                      const String &date, const String &statusStr,
+                      int rssi, uint32_t batVoltage)
+{
+  for (int i = 0; i < REGION_COUNT; ++i)
+  {
+    digests[i] = fnv1a32(NULL, 0);
+  }
+
+  // current conditions
+  uint32_t &h = digests[REGION_CURRENT_CONDITIONS];
+  const meteo_current_t &current = r.current;
+  digestPtr(h, getCurrentConditionsBitmap196(current, r.daily[0]));
+  digestInt(h, static_cast<int>(std::round(current.temp_min)));
+  digestInt(h, static_cast<int>(std::round(current.temp_max)));
+  digestStr(h, date);
+  digestPtr(h, alert_icon(current.alert[0]));
+  digestInt(h, static_cast<int>(std::round(current.wind_speed)));
+  digestInt(h, static_cast<int>(std::max(std::round(current.uvi), 0.0f)));
+  digestInt(h, static_cast<int>(std::round(current.pop)));
+
+  // forecast, labelled from the day of week
+  uint32_t &hForecast = digests[REGION_FORECAST];
+  digestInt(hForecast, timeInfo.tm_wday);
+  for (int i = 0; i < 5; ++i)
+  {
+    digestPtr(hForecast, getDailyForecastBitmap64(r.daily[i]));
+    digestInt(hForecast, static_cast<int>(std::round(r.daily[i].temp_min)));
+    digestInt(hForecast, static_cast<int>(std::round(r.daily[i].temp_max)));
+  }
+
+  // Domoticz tiles
+  uint32_t &hDomoticz = digests[REGION_DOMOTICZ];
+  for (int i = 0; i < 5; ++i)
+  {
+    digestInt(hDomoticz, r.data[i].icon);
+    if (r.data[i].icon > 0)
+    {
+      digestStr(hDomoticz, r.data[i].description.c_str());
+      digestStr(hDomoticz, r.data[i].value.c_str());
+    }
+  }
+
+  // consumption graph
+  uint32_t &hGraph = digests[REGION_GRAPH];
+  for (const domoticz_graph_t &g : r.graph)
+  {
+    digestInt(hGraph, g.value);
+    digestInt(hGraph, g.prev_value);
+    digestBytes(hGraph, g.dt, sizeof(g.dt));
+  }
+
+  // memo
+  digestStr(digests[REGION_MEMO], r.memo.c_str());
+
+  // status bar
+  uint32_t &hStatus = digests[REGION_STATUS_BAR];
+  digestStr(hStatus, statusStr);
+#if BATTERY_MONITORING
+  digestInt(hStatus, calcBatPercent(batVoltage, MIN_BATTERY_VOLTAGE,
+                                    MAX_BATTERY_VOLTAGE));
+  digestInt(hStatus, batVoltage < WARN_BATTERY_VOLTAGE);
+#if STATUS_BAR_EXTRAS_BAT_VOLTAGE
+  digestInt(hStatus, static_cast<int>(std::round(batVoltage / 10.f)));
+#endif
+#endif
+  digestPtr(hStatus, getWiFidesc(rssi));
+  digestPtr(hStatus, getWiFiBitmap16(rssi));
+  digestInt(hStatus, rssi >= -70);
+#if STATUS_BAR_EXTRAS_WIFI_RSSI
+  digestInt(hStatus, rssi);
+#endif
+
+  return;
+} // end getRegionDigests
+
+/* Gets the bounds of a region of the dashboard, in display coordinates. The
+ * bounds enclose everything drawn in the region, some regions overlap.
+ */
+void getRegionBounds(display_region_t region,
+                     int16_t &x, int16_t &y, int16_t &w, int16_t &h)
+{
+  switch (region)
+  {
+    case REGION_CURRENT_CONDITIONS:
+      x = 0;                           y = 0;
+      w = display.width();             h = Y_OFFSET + 245;
+      break;
+    case REGION_FORECAST:
+      x = 0;                           y = Y_OFFSET + 245;
+      w = display.width();             h = 127;
+      break;
+    case REGION_DOMOTICZ:
+      x = 0;                           y = Y_OFFSET + 372;
+      w = X_OFFSET + USABLE_WIDTH / 2; h = 297;
+      break;
+    case REGION_GRAPH:
+      x = X_OFFSET + USABLE_WIDTH / 2; y = Y_OFFSET + 372;
+      w = display.width() - x;         h = 151;
+      break;
+    case REGION_MEMO:
+      x = X_OFFSET + USABLE_WIDTH / 2; y = Y_OFFSET + 372 + 151;
+      w = display.width() - x;         h = 146;
+      break;
+    case REGION_STATUS_BAR:
+    default:
+      x = 0;                           y = Y_OFFSET + USABLE_HEIGHT - 1 - 24;
+      w = display.width();             h = display.height() - y;
+      break;
+  }
+  return;
+} // end getRegionBounds
+
 /* This function is responsible for drawing prominent error messages to the
  * screen.
  *
@@ -1000,7 +1461,8 @@ void drawStatusBar(const String &statusStr, const String &refreshTimeStr, int rs
  */
 void drawError(const uint8_t *bitmap_196x196, const String &errMsgLn1, const String &errMsgLn2)
 {
-  display.setFont(&FONT_26pt8b);
+  assertCanvasOwner();
+  canvas.setFont(&FONT_26pt8b);
   if (!errMsgLn2.isEmpty())
   {
     drawString(USABLE_WIDTH / 2, USABLE_HEIGHT / 2 + 196 / 2 + 21, errMsgLn1, CENTER);
@@ -1010,7 +1472,7 @@ void drawError(const uint8_t *bitmap_196x196, const String &errMsgLn1, const Str
   {
     drawMultiLnString(USABLE_WIDTH / 2, USABLE_HEIGHT / 2 + 196 / 2 + 21, errMsgLn1, CENTER, USABLE_WIDTH - 200, 2, 55);
   }
-  display.drawInvertedBitmap(USABLE_WIDTH / 2 - 196 / 2, USABLE_HEIGHT / 2 - 196 / 2 - 21 - 100, bitmap_196x196, 196, 196, ACCENT_COLOR);
+  canvas.drawInvertedBitmap(USABLE_WIDTH / 2 - 196 / 2, USABLE_HEIGHT / 2 - 196 / 2 - 21 - 100, bitmap_196x196, 196, 196, ACCENT_COLOR);
 
   return;
 } // end drawError
@@ -0,0 +1,246 @@
+/* API response cache for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <time.h>
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <HTTPClient.h>
+
+#include "api_response.h"
+#include "config.h"
+#include "data_snapshot.h"
+#include "http_stream.h"
+#include "response_cache.h"
+
+/*
+ * Validators and fingerprint of the last response of an endpoint. Kept in RTC
+ * memory, the values decoded from it are kept in its snapshot.
+ */
+typedef struct api_cache
+{
+  uint32_t magic;            // API_CACHE_MAGIC once the decoded values are kept
+  uint32_t uriHash;          // the request the response answered
+  uint32_t bodyHash;
+  char     etag[64];         // empty if the server sent none
+  char     lastModified[32];
+} api_cache_t;
+
+static const uint32_t API_CACHE_MAGIC = 0x41504943; // "APIC"
+
+RTC_DATA_ATTR static api_cache_t apiCache[API_CACHE_COUNT] = {};
+
+static const api_endpoint_t API_CACHE_ENDPOINTS[API_CACHE_COUNT] = {
+  API_METEO, API_DOMOTICZ_GRAPH
+};
+
+/* Returns the 32-bit FNV-1a hash of data, continuing from hash.
+ */
+uint32_t fnv1a32(const uint8_t *data, size_t len, uint32_t hash)
+{
+  for (size_t i = 0; i < len; ++i)
+  {
+    hash ^= data[i];
+    hash *= 16777619u;
+  }
+  return hash;
+} // end fnv1a32
+
+static uint32_t hashUri(const String &uri)
+{
+  return fnv1a32(reinterpret_cast<const uint8_t *>(uri.c_str()),
+                 uri.length());
+} // end hashUri
+
+// Key whose value changes on every request even when the data does not, left
+// out of the body hash: Open-Meteo reports how long it took to answer.
+static const char VOLATILE_KEY[] = "\"generationtime_ms\":";
+
+/* Returns the hash of what s reads, without the value of VOLATILE_KEY.
+ */
+static uint32_t hashStream(Stream &s)
+{
+  uint32_t hash = 2166136261u;
+  size_t matched = 0; // characters of VOLATILE_KEY just read
+  bool skipping = false;
+  int c;
+  while ((c = s.read()) >= 0)
+  {
+    if (skipping)
+    { // the number following the key
+      if (isdigit(c) || c == '.' || c == '-' || c == '+' || c == 'e'
+       || c == 'E')
+      {
+        continue;
+      }
+      skipping = false;
+    }
+    const uint8_t b = static_cast<uint8_t>(c);
+    hash = fnv1a32(&b, 1, hash);
+    // a mismatch restarts the match, at the opening quote if c is one
+    matched = c == VOLATILE_KEY[matched] ? matched + 1
+                                         : (c == VOLATILE_KEY[0] ? 1 : 0);
+    if (matched == sizeof(VOLATILE_KEY) - 1)
+    {
+      skipping = true;
+      matched = 0;
+    }
+  }
+  return hash;
+} // end hashStream
+
+/* Returns the hash of the body, inflated if it is gzip encoded, without the
+ * value of VOLATILE_KEY, so that identical data hashes the same. The body is
+ * rewound afterwards.
+ */
+static uint32_t hashBody(const response_headers_t &headers, MemoryStream &body)
+{
+  uint32_t hash;
+#if HTTP_GZIP
+  if (headers.contentEncoding.equalsIgnoreCase("gzip"))
+  {
+    GzipStream inflated(body);
+    hash = hashStream(inflated);
+  }
+  else
+#endif
+  {
+    hash = hashStream(body);
+  }
+  body.rewind();
+  return hash;
+} // end hashBody
+
+/* Returns true if the decoded values of the last response to uri are kept.
+ */
+static bool isCached(api_cache_id_t id, const String &uri)
+{
+  return apiCache[id].magic == API_CACHE_MAGIC
+      && apiCache[id].uriHash == hashUri(uri);
+} // end isCached
+
+/* Copies a response header to dst, or empties dst if it does not fit.
+ */
+static void copyHeader(char *dst, size_t size, const String &value)
+{
+  if (value.length() < size)
+  {
+    strcpy(dst, value.c_str());
+  }
+  else
+  {
+    dst[0] = '\0';
+  }
+  return;
+} // end copyHeader
+
+/* Makes the request conditional on the response having changed, using the
+ * validators the server sent with the last response. Must be called after
+ * http.begin().
+ */
+void addCacheValidators(api_cache_id_t id, const String &uri, HTTPClient &http)
+{
+  if (!isCached(id, uri))
+  {
+    return;
+  }
+  if (apiCache[id].etag[0] != '\0')
+  {
+    http.addHeader("If-None-Match", apiCache[id].etag);
+  }
+  if (apiCache[id].lastModified[0] != '\0')
+  {
+    http.addHeader("If-Modified-Since", apiCache[id].lastModified);
+  }
+  return;
+} // end addCacheValidators
+
+/* Returns the header lines that make a request written without HTTPClient
+ * conditional, like addCacheValidators() does, each ending with CRLF. Empty if
+ * nothing is cached for uri.
+ */
+String cacheValidatorHeaders(api_cache_id_t id, const String &uri)
+{
+  String lines;
+  if (!isCached(id, uri))
+  {
+    return lines;
+  }
+  if (apiCache[id].etag[0] != '\0')
+  {
+    lines += String("If-None-Match: ") + apiCache[id].etag + "\r\n";
+  }
+  if (apiCache[id].lastModified[0] != '\0')
+  {
+    lines += String("If-Modified-Since: ") + apiCache[id].lastModified
+           + "\r\n";
+  }
+  return lines;
+} // end cacheValidatorHeaders
+
+/* Deserializes the buffered body of a response to uri, unless the response is
+ * known to be unchanged: either the server answered 304 Not Modified, or the
+ * body is identical to the last one, except for values that change on every
+ * request (see hashBody()). The values decoded from the last response
+ * are kept instead.
+ */
+DeserializationError deserializeCached(api_cache_id_t id, const String &uri,
+  const response_headers_t &headers, int httpCode, MemoryStream &body,
+  DeserializationError (*deserialize)(Stream &json, requested_data_t &r),
+  requested_data_t &r)
+{
+  if (body.overflowed())
+  { // the body is incomplete, the cached values are still those shown
+    return DeserializationError::NoMemory;
+  }
+  api_cache_t &entry = apiCache[id];
+  const uint32_t bodyHash = hashBody(headers, body);
+
+  if (isCached(id, uri)
+   && (httpCode == HTTP_CODE_NOT_MODIFIED || entry.bodyHash == bodyHash)
+   && loadSnapshot(API_CACHE_ENDPOINTS[id], r, NULL))
+  {
+#if DEBUG_LEVEL >= 1
+    Serial.println(String("[debug] ")
+      + API_ENDPOINT_NAMES[API_CACHE_ENDPOINTS[id]] + " response "
+      + (httpCode == HTTP_CODE_NOT_MODIFIED ? "not modified" : "unchanged")
+      + ", skipping deserialization");
+#endif
+    return DeserializationError::Ok;
+  }
+
+  entry.magic = 0;
+  if (httpCode != HTTP_CODE_OK)
+  { // 304 without anything cached, request again without validators
+    return DeserializationError::EmptyInput;
+  }
+
+  DeserializationError error = deserializeBody(headers, body, deserialize, r);
+  if (!error)
+  {
+    // the clock may not be synchronized yet, the caller can save it again
+    saveSnapshot(API_CACHE_ENDPOINTS[id], r, time(NULL));
+    entry.uriHash  = hashUri(uri);
+    entry.bodyHash = bodyHash;
+    copyHeader(entry.etag, sizeof(entry.etag), headers.etag);
+    copyHeader(entry.lastModified, sizeof(entry.lastModified),
+               headers.lastModified);
+    entry.magic = API_CACHE_MAGIC;
+  }
+  return error;
+} // end deserializeCached
+
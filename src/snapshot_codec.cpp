@@ -0,0 +1,223 @@
+/* Snapshot encoding for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "snapshot_codec.h"
+
+// Increase when the encoding of any endpoint changes.
+static const uint16_t SNAPSHOT_VERSION = 1;
+
+/* Appends len bytes of src to buf, unless they do not fit in size.
+ */
+static bool put(uint8_t *buf, size_t size, size_t &pos, const void *src,
+                size_t len)
+{
+  if (len > size - pos)
+  {
+    return false;
+  }
+  memcpy(buf + pos, src, len);
+  pos += len;
+  return true;
+} // end put
+
+template <size_t N>
+static bool putString(uint8_t *buf, size_t size, size_t &pos,
+                      const FixedString<N> &s)
+{
+  static_assert(FixedString<N>::capacity() <= UINT8_MAX,
+                "string length must fit in one byte");
+  uint8_t len = static_cast<uint8_t>(s.length());
+  return put(buf, size, pos, &len, 1) && put(buf, size, pos, s.c_str(), len);
+} // end putString
+
+/* Reads the next len bytes of buf into dst, unless buf ends before.
+ */
+static bool get(const uint8_t *buf, size_t size, size_t &pos, void *dst,
+                size_t len)
+{
+  if (len > size - pos)
+  {
+    return false;
+  }
+  memcpy(dst, buf + pos, len);
+  pos += len;
+  return true;
+} // end get
+
+template <size_t N>
+static bool getString(const uint8_t *buf, size_t size, size_t &pos,
+                      FixedString<N> &s)
+{
+  uint8_t len;
+  if (!get(buf, size, pos, &len, 1) || len > FixedString<N>::capacity()
+   || len > size - pos)
+  {
+    return false;
+  }
+  s.assign(reinterpret_cast<const char *>(buf + pos), len);
+  pos += len;
+  return true;
+} // end getString
+
+/* Encodes the members of r decoded from endpoint into buf.
+ *
+ * Returns the length of the encoding, or 0 if it does not fit in size.
+ */
+static size_t encodeData(api_endpoint_t endpoint, const requested_data_t &r,
+                         uint8_t *buf, size_t size)
+{
+  size_t pos = 0;
+  bool ok = true;
+  switch (endpoint)
+  {
+  case API_METEO:
+    ok = put(buf, size, pos, &r.current, sizeof(r.current))
+      && put(buf, size, pos, r.daily, sizeof(r.daily));
+    break;
+  case API_DOMOTICZ_IDX:
+    for (const domoticz_t &d : r.data)
+    {
+      int32_t icon = d.icon;
+      ok = ok && put(buf, size, pos, &icon, sizeof(icon))
+              && putString(buf, size, pos, d.description)
+              && putString(buf, size, pos, d.value);
+    }
+    ok = ok && putString(buf, size, pos, r.memo);
+    break;
+  case API_DOMOTICZ_GRAPH:
+    ok = put(buf, size, pos, r.graph, sizeof(r.graph));
+    break;
+  default:
+    ok = false;
+    break;
+  }
+  return ok ? pos : 0;
+} // end encodeData
+
+/* Decodes an encoding made by encodeData() into the members of r of endpoint.
+ * r is left partly written if the encoding is invalid.
+ *
+ * Returns true if the encoding is valid and was read to its end.
+ */
+static bool decodeData(api_endpoint_t endpoint, const uint8_t *buf, size_t len,
+                       requested_data_t &r)
+{
+  size_t pos = 0;
+  bool ok = true;
+  switch (endpoint)
+  {
+  case API_METEO:
+    ok = get(buf, len, pos, &r.current, sizeof(r.current))
+      && get(buf, len, pos, r.daily, sizeof(r.daily));
+    break;
+  case API_DOMOTICZ_IDX:
+    for (domoticz_t &d : r.data)
+    {
+      int32_t icon = 0;
+      ok = ok && get(buf, len, pos, &icon, sizeof(icon))
+              && getString(buf, len, pos, d.description)
+              && getString(buf, len, pos, d.value);
+      d.icon = icon;
+    }
+    ok = ok && getString(buf, len, pos, r.memo);
+    break;
+  case API_DOMOTICZ_GRAPH:
+    ok = get(buf, len, pos, r.graph, sizeof(r.graph));
+    break;
+  default:
+    ok = false;
+    break;
+  }
+  return ok && pos == len;
+} // end decodeData
+
+static uint32_t snapshotCrc(const snapshot_header_t &header,
+                            const uint8_t *data, snapshot_crc_t crc)
+{
+  const uint8_t *fields = reinterpret_cast<const uint8_t *>(&header.version);
+  uint32_t c = crc(0, fields, sizeof(header)
+                              - offsetof(snapshot_header_t, version));
+  return crc(c, data, header.length);
+} // end snapshotCrc
+
+/* Encodes the members of r decoded from endpoint, as received at the time
+ * fetched, into a snapshot in buf, checksummed with crc.
+ *
+ * Returns the length of the snapshot, or 0 if it does not fit in size.
+ */
+size_t encodeSnapshot(api_endpoint_t endpoint, const requested_data_t &r,
+                      int64_t fetched, uint8_t *buf, size_t size,
+                      snapshot_crc_t crc)
+{
+  if (size < sizeof(snapshot_header_t))
+  {
+    return 0;
+  }
+  uint8_t *data = buf + sizeof(snapshot_header_t);
+  const size_t length = encodeData(endpoint, r, data,
+                                   size - sizeof(snapshot_header_t));
+  if (length == 0 || length > UINT16_MAX)
+  {
+    return 0;
+  }
+
+  snapshot_header_t header = {};
+  header.version = SNAPSHOT_VERSION;
+  header.length  = static_cast<uint16_t>(length);
+  header.fetched = fetched;
+  header.crc     = snapshotCrc(header, data, crc);
+  memcpy(buf, &header, sizeof(header));
+  return sizeof(header) + length;
+} // end encodeSnapshot
+
+/* Decodes a snapshot made by encodeSnapshot() into the members of r of
+ * endpoint, and the time it was received into fetched, if not NULL. r is left
+ * partly written if the encoding is invalid.
+ *
+ * Returns false if buf, of size bytes, does not hold a snapshot of the current
+ * version that matches its CRC and decodes to its end.
+ */
+bool decodeSnapshot(api_endpoint_t endpoint, const uint8_t *buf, size_t size,
+                    requested_data_t &r, int64_t *fetched, snapshot_crc_t crc)
+{
+  snapshot_header_t header;
+  if (size < sizeof(header))
+  {
+    return false;
+  }
+  memcpy(&header, buf, sizeof(header));
+  const uint8_t *data = buf + sizeof(header);
+  if (header.version != SNAPSHOT_VERSION
+   || header.length > size - sizeof(header)
+   || header.crc != snapshotCrc(header, data, crc))
+  {
+    return false;
+  }
+  if (!decodeData(endpoint, data, header.length, r))
+  {
+    return false;
+  }
+  if (fetched != NULL)
+  {
+    *fetched = header.fetched;
+  }
+  return true;
+} // end decodeSnapshot
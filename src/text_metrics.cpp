@@ -0,0 +1,242 @@
+/* Text metrics for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <Arduino.h>
+#include <Adafruit_GFX.h>
+
+#include "text_metrics.h"
+
+// fonts whose metrics are kept, the least recently built is replaced first.
+// Not thread safe, see assertCanvasOwner() in renderer.cpp.
+static const int TEXT_METRICS_FONTS = 4;
+static text_metrics_t metricsCache[TEXT_METRICS_FONTS];
+static int metricsUsed = 0;
+static int metricsNext = 0;
+static int metricsLast = 0;
+
+/*
+ * Horizontal extent of the glyphs measured so far, x0 <= x < x1, and where the
+ * cursor is, all relative to where the text starts. Like
+ * Adafruit_GFX::charBounds(), glyphs without pixels still extend x0 and x1 to
+ * where they would start, so leading and trailing spaces count.
+ */
+typedef struct text_bounds
+{
+  int16_t pen;
+  int16_t x0, x1;
+} text_bounds_t;
+
+static const text_bounds_t BOUNDS_EMPTY = {0, INT16_MAX, INT16_MIN};
+
+static inline void extend(text_bounds_t &b, const glyph_metrics_t &g)
+{
+  if (g.drawn)
+  {
+    b.x0 = std::min<int16_t>(b.x0, b.pen + g.left);
+    b.x1 = std::max<int16_t>(b.x1, b.pen + g.left + g.width);
+    b.pen += g.advance;
+  }
+  return;
+} // end extend
+
+static inline uint16_t boundsWidth(const text_bounds_t &b)
+{
+  return b.x1 > b.x0 ? b.x1 - b.x0 : 0;
+} // end boundsWidth
+
+/* Returns the width of what was measured in b followed by "...".
+ */
+static uint16_t ellipsisWidth(const text_metrics_t &m, text_bounds_t b)
+{
+  for (int i = 0; i < 3; ++i)
+  {
+    extend(b, m.glyph['.']);
+  }
+  return boundsWidth(b);
+} // end ellipsisWidth
+
+/* Copies the metrics of the characters of font out of its glyphs, the way
+ * Adafruit_GFX::getTextBounds() measures them.
+ */
+static void buildMetrics(text_metrics_t &m, const GFXfont *font)
+{
+  m.font = font;
+  memset(m.glyph, 0, sizeof(m.glyph));
+  for (int c = 0; c < 256; ++c)
+  {
+    if (c == '\n' || c == '\r')
+    {
+      continue;
+    }
+    glyph_metrics_t &g = m.glyph[c];
+    if (font == NULL)
+    { // built-in 6x8 font, every character is a full cell
+      g.advance = 6;
+      g.left    = 0;
+      g.width   = 6;
+      g.drawn   = true;
+    }
+    else if (c >= font->first && c <= font->last)
+    {
+      const GFXglyph &glyph = font->glyph[c - font->first];
+      g.advance = glyph.xAdvance;
+      g.left    = glyph.xOffset;
+      g.width   = glyph.width;
+      g.drawn   = true;
+    }
+  }
+  return;
+} // end buildMetrics
+
+/* Returns the metrics of font, building them the first time it is measured.
+ */
+const text_metrics_t &getTextMetrics(const GFXfont *font)
+{
+  if (metricsLast < metricsUsed && metricsCache[metricsLast].font == font)
+  {
+    return metricsCache[metricsLast];
+  }
+  for (int i = 0; i < metricsUsed; ++i)
+  {
+    if (metricsCache[i].font == font)
+    {
+      metricsLast = i;
+      return metricsCache[i];
+    }
+  }
+  metricsLast = metricsNext;
+  metricsNext = (metricsNext + 1) % TEXT_METRICS_FONTS;
+  metricsUsed = std::min(metricsUsed + 1, TEXT_METRICS_FONTS);
+  buildMetrics(metricsCache[metricsLast], font);
+  return metricsCache[metricsLast];
+} // end getTextMetrics
+
+/* Returns the width in pixels of len characters of text in font, the same as
+ * Adafruit_GFX::getTextBounds() gives with text size 1 and no wrapping, for
+ * text drawn within the display. After a '\n' the text is measured from where
+ * it started, where getTextBounds() goes back to x = 0.
+ */
+uint16_t getTextWidth(const GFXfont *font, const char *text, size_t len)
+{
+  const text_metrics_t &m = getTextMetrics(font);
+  text_bounds_t b = BOUNDS_EMPTY;
+  for (size_t i = 0; i < len; ++i)
+  {
+    if (text[i] == '\n')
+    {
+      b.pen = 0;
+      continue;
+    }
+    extend(b, m.glyph[static_cast<uint8_t>(text[i])]);
+  }
+  return boundsWidth(b);
+} // end getTextWidth
+
+/* Breaks the next line off text, which ends at end, and moves text past it.
+ * Returns false if no text remains.
+ *
+ * Lines are filled greedily, a word at a time. They break at "<br>" and '\n'
+ * and at spaces, which are dropped, and after dashes, except for the last line
+ * which only breaks at spaces so an ellipsis can follow the last word. The
+ * last line ends with an ellipsis if text remains after it and the ellipsis
+ * fits. A word wider than max_width overflows its line.
+ *
+ * Each character is measured once as the line grows, or twice if it is moved
+ * to the next line, so breaking text is linear in its length.
+ */
+bool nextLine(const GFXfont *font, const char *&text, const char *end,
+              uint16_t max_width, bool last, text_line_t &line)
+{
+  if (text >= end)
+  {
+    return false;
+  }
+  const text_metrics_t &m = getTextMetrics(font);
+  text_bounds_t b = BOUNDS_EMPTY;
+  // the last place the line can break: where it ends, where the next line
+  // starts and what the line measures
+  const char *brk = NULL;
+  const char *brkNext = NULL;
+  text_bounds_t brkBounds = BOUNDS_EMPTY;
+  // on the last line, the last space the line can break at with an ellipsis
+  const char *fit = NULL;
+  text_bounds_t fitBounds = BOUNDS_EMPTY;
+
+  const char *stop = end;
+  const char *next = end;
+  bool cut = false;
+  for (const char *p = text; p < end; ++p)
+  {
+    if (*p == '\n' || (*p == '<' && end - p >= 4 && strncmp(p, "<br>", 4) == 0))
+    {
+      stop = p;
+      next = p + (*p == '\n' ? 1 : 4);
+      cut  = last && next < end;
+      break;
+    }
+    if (*p == ' ')
+    {
+      brk       = p;
+      brkNext   = p + 1;
+      brkBounds = b;
+      if (last && ellipsisWidth(m, b) <= max_width)
+      {
+        fit       = p;
+        fitBounds = b;
+      }
+    }
+    extend(b, m.glyph[static_cast<uint8_t>(*p)]);
+    if (brk != NULL && boundsWidth(b) > max_width)
+    {
+      stop = brk;
+      next = brkNext;
+      b    = brkBounds;
+      cut  = last;
+      break;
+    }
+    if (*p == '-' && !last)
+    { // the dash stays on this line
+      brk       = p + 1;
+      brkNext   = p + 1;
+      brkBounds = b;
+    }
+  }
+
+  line.text     = text;
+  line.ellipsis = false;
+  line.width    = boundsWidth(b);
+  if (cut)
+  {
+    uint16_t w = ellipsisWidth(m, b);
+    if (w > max_width && fit != NULL)
+    {
+      stop = fit;
+      w    = ellipsisWidth(m, fitBounds);
+    }
+    if (w <= max_width)
+    {
+      line.ellipsis = true;
+      line.width    = w;
+    }
+  }
+  line.len = stop - text;
+  text = next;
+  return true;
+} // end nextLine
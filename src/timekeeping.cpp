@@ -0,0 +1,257 @@
+/* Time keeping for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstdlib>
+#include <sys/time.h>
+#include <time.h>
+
+#include <Arduino.h>
+#include <esp_sntp.h>
+#include <esp_timer.h>
+
+#include "client_utils.h"
+#include "config.h"
+#include "profiler.h"
+#include "timekeeping.h"
+
+RTC_DATA_ATTR static clock_model_t clockModel = {};
+
+// state of the synchronization begun by beginTimeSync()
+static bool sntpStarted = false;
+static int64_t sntpStartTimerUs = 0;
+static int64_t sntpStartClockUs = 0;
+static int64_t correctedErrorUs = 0;
+// set by the SNTP callback
+static volatile bool sntpSynced = false;
+static volatile int64_t sntpSyncTimerUs = 0;
+
+// Most accurate time received in the Date header of an HTTP response, the
+// fetch tasks may record it concurrently.
+static portMUX_TYPE httpDateMux = portMUX_INITIALIZER_UNLOCKED;
+static bool httpDateValid = false;
+static int64_t httpDateUs = 0;      // estimated true time at httpDateTimerUs
+static int64_t httpDateTimerUs = 0;
+static int64_t httpDateErrorUs = 0;
+
+/* Called by SNTP once it has set the clock.
+ */
+static void onSNTPSync(struct timeval *tv)
+{
+  sntpSyncTimerUs = esp_timer_get_time();
+  sntpSynced = true;
+  return;
+} // end onSNTPSync
+
+/* Returns the system clock in microseconds since the Unix epoch.
+ */
+static int64_t getClockUs()
+{
+  timeval tv;
+  gettimeofday(&tv, NULL);
+  return tv.tv_sec * 1000000LL + tv.tv_usec;
+} // end getClockUs
+
+/* Sets the system clock, in microseconds since the Unix epoch.
+ */
+static void setClockUs(int64_t us)
+{
+  timeval tv;
+  tv.tv_sec  = us / 1000000LL;
+  tv.tv_usec = us % 1000000LL;
+  settimeofday(&tv, NULL);
+  return;
+} // end setClockUs
+
+/* Records the Date header of an HTTP response, if valid. The request was sent
+ * at sentTimerUs and its response headers received at receivedTimerUs, as
+ * read from esp_timer_get_time().
+ *
+ * The server stamps the response at some point during the round trip, with
+ * whole seconds, so the one with the shortest round trip is kept.
+ */
+void recordHttpDate(const String &date, int64_t sentTimerUs,
+                    int64_t receivedTimerUs)
+{
+  int64_t epochS;
+  if (!parseHttpDate(date.c_str(), epochS))
+  {
+    return;
+  }
+  const int64_t rttUs = receivedTimerUs - sentTimerUs;
+  const int64_t errorUs = 500000 + rttUs / 2;
+
+  portENTER_CRITICAL(&httpDateMux);
+  if (!httpDateValid || errorUs < httpDateErrorUs)
+  {
+    httpDateUs      = epochS * 1000000LL + errorUs;
+    httpDateTimerUs = receivedTimerUs;
+    httpDateErrorUs = errorUs;
+    httpDateValid   = true;
+  }
+  portEXIT_CRITICAL(&httpDateMux);
+  return;
+} // end recordHttpDate
+
+/* Gets the current time estimated from the recorded HTTP Date header, and its
+ * uncertainty.
+ *
+ * Returns false if no valid Date header was received.
+ */
+static bool getHttpDateTime(int64_t &nowUs, int64_t &errorUs)
+{
+  portENTER_CRITICAL(&httpDateMux);
+  const bool valid = httpDateValid;
+  nowUs   = httpDateUs + (esp_timer_get_time() - httpDateTimerUs);
+  errorUs = httpDateErrorUs;
+  portEXIT_CRITICAL(&httpDateMux);
+  return valid;
+} // end getHttpDateTime
+
+/* Begins setting the local time, adjusted for the time zone specified in
+ * config.cpp.
+ *
+ * The RTC keeps time during deep sleep, so NTP servers are only queried every
+ * NTP_SYNC_INTERVAL wakes, or sooner if the predicted error of the clock
+ * exceeds NTP_MAX_PREDICTED_ERROR. In between, the drift of the RTC learned
+ * from previous synchronizations is corrected.
+ *
+ * SNTP runs in the background, so the API requests can be made meanwhile.
+ */
+void beginTimeSync()
+{
+  const int64_t clockUs = getClockUs();
+  if (!clockModelNeedsSync(clockModel, clockUs, NTP_SYNC_INTERVAL,
+                           NTP_MAX_PREDICTED_ERROR * 1000LL))
+  {
+    const int64_t correctionUs = clockModelCorrectionUs(clockModel, clockUs);
+    setClockUs(getClockUs() + correctionUs);
+    clockModel.correctionUs += correctionUs;
+    ++clockModel.wakesSinceSync;
+    correctedErrorUs = clockModelPredictedErrorUs(clockModel, clockUs);
+    setenv("TZ", TIMEZONE, 1);
+    tzset();
+    sntpStarted = false;
+#if DEBUG_LEVEL >= 1
+    Serial.println("[debug] Skipping NTP, clock corrected by "
+      + String(static_cast<long>(correctionUs / 1000)) + " ms, expected error "
+      + String(static_cast<long>(correctedErrorUs / 1000)) + " ms");
+#endif
+    return;
+  }
+
+  sntpSynced = false;
+  sntp_set_time_sync_notification_cb(onSNTPSync);
+  sntpStartTimerUs = esp_timer_get_time();
+  sntpStartClockUs = clockUs;
+  configTzTime(TIMEZONE, NTP_SERVER_1, NTP_SERVER_2);
+  sntpStarted = true;
+  return;
+} // end beginTimeSync
+
+/* Sets the clock to dateUs, the time estimated from an HTTP Date header with
+ * uncertainty errorUs.
+ */
+static void setClockFromHttpDate(int64_t dateUs, int64_t errorUs)
+{
+  const int64_t adjustUs = dateUs - getClockUs();
+  setClockUs(getClockUs() + adjustUs);
+  if (clockModelValid(clockModel))
+  { // keeps the next drift measurement consistent
+    clockModel.correctionUs += adjustUs;
+  }
+#if DEBUG_LEVEL >= 1
+  Serial.println("[debug] HTTP Date corrected clock by "
+    + String(static_cast<long>(adjustUs / 1000)) + " ms, +/- "
+    + String(static_cast<long>(errorUs / 1000)) + " ms");
+#endif
+  return;
+} // end setClockFromHttpDate
+
+/* Finishes setting the local time, once the API requests were made.
+ *
+ * If SNTP has not completed by then, the clock is set from the Date header of
+ * the HTTP responses instead of waiting for it. The Date header is also used
+ * to catch a clock corrected by a wrong drift model.
+ *
+ * Returns true if time was set successfully, otherwise false.
+ *
+ * Note: Must be connected to WiFi to get time from NTP server.
+ */
+bool finishTimeSync(tm *timeInfo)
+{
+  int64_t dateUs, dateErrorUs;
+  const bool haveDate = getHttpDateTime(dateUs, dateErrorUs);
+
+  if (!sntpStarted)
+  {
+    if (haveDate && std::llabs(dateUs - getClockUs())
+                    > correctedErrorUs + dateErrorUs)
+    { // the drift model is wrong, query NTP next wake
+      setClockFromHttpDate(dateUs, dateErrorUs);
+      clockModel.wakesSinceSync = NTP_SYNC_INTERVAL;
+    }
+    return printLocalTime(timeInfo);
+  }
+
+  bool timeConfigured;
+  if (!sntpSynced && haveDate)
+  {
+    sntp_stop();
+  }
+  if (sntpSynced)
+  {
+    timeConfigured = printLocalTime(timeInfo);
+  }
+  else if (haveDate)
+  {
+    setClockFromHttpDate(dateUs, dateErrorUs);
+    timeConfigured = printLocalTime(timeInfo);
+  }
+  else
+  {
+    timeConfigured = waitForSNTPSync(timeInfo);
+  }
+
+  profileEvent(PHASE_SNTP, sntpStartTimerUs,
+               sntpSynced ? sntpSyncTimerUs : esp_timer_get_time());
+  if (sntpSynced)
+  {
+    // While awake the clock is driven by the main crystal, which is accurate,
+    // so what it would read without the synchronization can be recovered.
+    const int64_t clockAtSyncUs = sntpStartClockUs
+                                  + (sntpSyncTimerUs - sntpStartTimerUs);
+    const int64_t trueAtSyncUs = getClockUs()
+                                 - (esp_timer_get_time() - sntpSyncTimerUs);
+    clockModelSynced(clockModel, clockAtSyncUs, trueAtSyncUs);
+#if DEBUG_LEVEL >= 1
+    Serial.println("[debug] NTP corrected clock by "
+      + String(static_cast<long>((trueAtSyncUs - clockAtSyncUs) / 1000))
+      + " ms, RTC drift " + String(clockModel.driftPpm, 1) + " +/- "
+      + String(clockModel.driftErrorPpm, 1) + " ppm");
+#endif
+  }
+  return timeConfigured;
+} // end finishTimeSync
+
+/* Returns the learned drift rate of the RTC, in parts per million. Positive
+ * when the RTC runs fast.
+ */
+float getClockDriftPpm()
+{
+  return clockModelDriftPpm(clockModel);
+} // end getClockDriftPpm
+
@@ -0,0 +1,339 @@
+/* Host stand-in for Adafruit_GFX.h, for the tests of esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MOCK_ADAFRUIT_GFX_H__
+#define __MOCK_ADAFRUIT_GFX_H__
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <Arduino.h>
+
+/*
+ * Fonts as gfxfont.h declares them, for the fonts of
+ * lib/esp32-weather-epd-assets to build on the host.
+ */
+typedef struct
+{
+  uint16_t bitmapOffset;
+  uint8_t  width;
+  uint8_t  height;
+  uint8_t  xAdvance;
+  int8_t   xOffset;
+  int8_t   yOffset;
+} GFXglyph;
+
+typedef struct
+{
+  uint8_t  *bitmap;
+  GFXglyph *glyph;
+  uint16_t  first;
+  uint16_t  last;
+  uint8_t   yAdvance;
+} GFXfont;
+
+/*
+ * The part of Adafruit_GFX the page buffer and the display list rely on: its
+ * size and rotation, the drawing primitives they override, which default to
+ * drawPixel() as in the library, and text in GFXfonts. Lines, rounded
+ * rectangles and glyphs are drawn the way the library draws them, text size is
+ * always 1 and the built-in font is not drawn.
+ */
+class Adafruit_GFX : public Print
+{
+public:
+  Adafruit_GFX(int16_t w, int16_t h)
+    : WIDTH(w), HEIGHT(h), _width(w), _height(h), rotation(0),
+      cursor_x(0), cursor_y(0), textcolor(0xFFFF), wrap(true), gfxFont(NULL)
+  {}
+  virtual ~Adafruit_GFX() {}
+
+  virtual void drawPixel(int16_t x, int16_t y, uint16_t color) = 0;
+  virtual void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color)
+  {
+    fillRect(x, y, w, 1, color);
+  }
+  virtual void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t color)
+  {
+    fillRect(x, y, 1, h, color);
+  }
+  virtual void fillRect(int16_t x, int16_t y, int16_t w, int16_t h,
+                        uint16_t color)
+  {
+    for (int16_t j = y; j < y + h; ++j)
+    {
+      for (int16_t i = x; i < x + w; ++i)
+      {
+        drawPixel(i, j, color);
+      }
+    }
+  }
+  virtual void fillScreen(uint16_t color)
+  {
+    fillRect(0, 0, _width, _height, color);
+  }
+  virtual void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1,
+                        uint16_t color)
+  {
+    if (x0 == x1)
+    {
+      drawFastVLine(x0, std::min(y0, y1), std::abs(y1 - y0) + 1, color);
+      return;
+    }
+    if (y0 == y1)
+    {
+      drawFastHLine(std::min(x0, x1), y0, std::abs(x1 - x0) + 1, color);
+      return;
+    }
+    // Bresenham, as Adafruit_GFX::writeLine()
+    const bool steep = std::abs(y1 - y0) > std::abs(x1 - x0);
+    if (steep)
+    {
+      std::swap(x0, y0);
+      std::swap(x1, y1);
+    }
+    if (x0 > x1)
+    {
+      std::swap(x0, x1);
+      std::swap(y0, y1);
+    }
+    const int16_t dx = x1 - x0, dy = std::abs(y1 - y0);
+    const int16_t ystep = y0 < y1 ? 1 : -1;
+    int16_t err = dx / 2;
+    for (; x0 <= x1; ++x0)
+    {
+      if (steep)
+      {
+        drawPixel(y0, x0, color);
+      }
+      else
+      {
+        drawPixel(x0, y0, color);
+      }
+      err -= dy;
+      if (err < 0)
+      {
+        y0 += ystep;
+        err += dx;
+      }
+    }
+  }
+  void drawRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r,
+                     uint16_t color)
+  {
+    r = std::min<int16_t>(r, std::min(w, h) / 2);
+    drawFastHLine(x + r, y, w - 2 * r, color);
+    drawFastHLine(x + r, y + h - 1, w - 2 * r, color);
+    drawFastVLine(x, y + r, h - 2 * r, color);
+    drawFastVLine(x + w - 1, y + r, h - 2 * r, color);
+    drawCircleHelper(x + r, y + r, r, 1, color);
+    drawCircleHelper(x + w - r - 1, y + r, r, 2, color);
+    drawCircleHelper(x + w - r - 1, y + h - r - 1, r, 4, color);
+    drawCircleHelper(x + r, y + h - r - 1, r, 8, color);
+  }
+  void fillRoundRect(int16_t x, int16_t y, int16_t w, int16_t h, int16_t r,
+                     uint16_t color)
+  {
+    r = std::min<int16_t>(r, std::min(w, h) / 2);
+    fillRect(x + r, y, w - 2 * r, h, color);
+    fillCircleHelper(x + w - r - 1, y + r, r, 1, h - 2 * r - 1, color);
+    fillCircleHelper(x + r, y + r, r, 2, h - 2 * r - 1, color);
+  }
+
+  void setRotation(uint8_t r)
+  {
+    rotation = r & 3;
+    _width  = rotation & 1 ? HEIGHT : WIDTH;
+    _height = rotation & 1 ? WIDTH : HEIGHT;
+  }
+  uint8_t getRotation() const { return rotation; }
+  int16_t width() const { return _width; }
+  int16_t height() const { return _height; }
+
+  void setFont(const GFXfont *f)
+  {
+    // the cursor stays on the baseline, as in the library
+    if (f != NULL && gfxFont == NULL)
+    {
+      cursor_y += 6;
+    }
+    else if (f == NULL && gfxFont != NULL)
+    {
+      cursor_y -= 6;
+    }
+    gfxFont = const_cast<GFXfont *>(f);
+  }
+  void setTextColor(uint16_t c) { textcolor = c; }
+  void setTextWrap(bool w) { wrap = w; }
+  void setCursor(int16_t x, int16_t y)
+  {
+    cursor_x = x;
+    cursor_y = y;
+  }
+  int16_t getCursorX() const { return cursor_x; }
+  int16_t getCursorY() const { return cursor_y; }
+
+  size_t write(uint8_t c) override
+  {
+    if (gfxFont == NULL)
+    {
+      if (c == '\n')
+      {
+        cursor_x = 0;
+        cursor_y += 8;
+      }
+      else if (c != '\r')
+      {
+        cursor_x += 6;
+      }
+      return 1;
+    }
+    if (c == '\n')
+    {
+      cursor_x = 0;
+      cursor_y += gfxFont->yAdvance;
+    }
+    else if (c != '\r' && c >= gfxFont->first && c <= gfxFont->last)
+    {
+      const GFXglyph &glyph = gfxFont->glyph[c - gfxFont->first];
+      if (glyph.width > 0 && glyph.height > 0)
+      {
+        if (wrap && cursor_x + glyph.xOffset + glyph.width > _width)
+        {
+          cursor_x = 0;
+          cursor_y += gfxFont->yAdvance;
+        }
+        drawChar(cursor_x, cursor_y, glyph, textcolor);
+      }
+      cursor_x += glyph.xAdvance;
+    }
+    return 1;
+  }
+
+protected:
+  const int16_t WIDTH, HEIGHT;
+  int16_t _width, _height;
+  uint8_t rotation;
+  int16_t cursor_x, cursor_y;
+  uint16_t textcolor;
+  bool wrap;
+  GFXfont *gfxFont;
+
+private:
+  void drawCircleHelper(int16_t x0, int16_t y0, int16_t r, uint8_t corners,
+                        uint16_t color)
+  {
+    int16_t f = 1 - r, ddF_x = 1, ddF_y = -2 * r, x = 0, y = r;
+    while (x < y)
+    {
+      if (f >= 0)
+      {
+        --y;
+        ddF_y += 2;
+        f += ddF_y;
+      }
+      ++x;
+      ddF_x += 2;
+      f += ddF_x;
+      if (corners & 0x4)
+      {
+        drawPixel(x0 + x, y0 + y, color);
+        drawPixel(x0 + y, y0 + x, color);
+      }
+      if (corners & 0x2)
+      {
+        drawPixel(x0 + x, y0 - y, color);
+        drawPixel(x0 + y, y0 - x, color);
+      }
+      if (corners & 0x8)
+      {
+        drawPixel(x0 - y, y0 + x, color);
+        drawPixel(x0 - x, y0 + y, color);
+      }
+      if (corners & 0x1)
+      {
+        drawPixel(x0 - y, y0 - x, color);
+        drawPixel(x0 - x, y0 - y, color);
+      }
+    }
+  }
+  void fillCircleHelper(int16_t x0, int16_t y0, int16_t r, uint8_t corners,
+                        int16_t delta, uint16_t color)
+  {
+    int16_t f = 1 - r, ddF_x = 1, ddF_y = -2 * r, x = 0, y = r;
+    int16_t px = x, py = y;
+    ++delta;
+    while (x < y)
+    {
+      if (f >= 0)
+      {
+        --y;
+        ddF_y += 2;
+        f += ddF_y;
+      }
+      ++x;
+      ddF_x += 2;
+      f += ddF_x;
+      if (x < y + 1)
+      {
+        if (corners & 1)
+        {
+          drawFastVLine(x0 + x, y0 - y, 2 * y + delta, color);
+        }
+        if (corners & 2)
+        {
+          drawFastVLine(x0 - x, y0 - y, 2 * y + delta, color);
+        }
+      }
+      if (y != py)
+      {
+        if (corners & 1)
+        {
+          drawFastVLine(x0 + py, y0 - px, 2 * px + delta, color);
+        }
+        if (corners & 2)
+        {
+          drawFastVLine(x0 - py, y0 - px, 2 * px + delta, color);
+        }
+        py = y;
+      }
+      px = x;
+    }
+  }
+  void drawChar(int16_t x, int16_t y, const GFXglyph &glyph, uint16_t color)
+  {
+    const uint8_t *bitmap = gfxFont->bitmap + glyph.bitmapOffset;
+    uint8_t bits = 0, bit = 0;
+    for (int16_t yy = 0; yy < glyph.height; ++yy)
+    {
+      for (int16_t xx = 0; xx < glyph.width; ++xx)
+      {
+        if (!(bit++ & 7))
+        {
+          bits = *bitmap++;
+        }
+        if (bits & 0x80)
+        {
+          drawPixel(x + glyph.xOffset + xx, y + glyph.yOffset + yy, color);
+        }
+        bits <<= 1;
+      }
+    }
+  }
+};
+
+#endif
@@ -0,0 +1,255 @@
+/* Host stand-in for Arduino.h, for the tests of esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MOCK_ARDUINO_H__
+#define __MOCK_ARDUINO_H__
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/*
+ * The parts of the Arduino core, and of what it pulls in from ESP-IDF, that the
+ * units built on the host use.
+ */
+
+#define PROGMEM
+#define pgm_read_byte(addr) (*reinterpret_cast<const uint8_t *>(addr))
+
+// pins_arduino.h of the FireBeetle 2 ESP32-E
+static const uint8_t A2 = 34;
+
+inline unsigned long micros()
+{
+  static const auto start = std::chrono::steady_clock::now();
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now() - start).count();
+}
+
+inline unsigned long millis()
+{
+  return micros() / 1000;
+}
+
+inline long random(long lo, long hi)
+{
+  return hi > lo ? lo + std::rand() % (hi - lo) : lo;
+}
+
+class String
+{
+public:
+  String() {}
+  String(const char *s) : _s(s != NULL ? s : "") {}
+  String(char c) : _s(1, c) {}
+  String(int v) : _s(std::to_string(v)) {}
+  String(unsigned v) : _s(std::to_string(v)) {}
+  String(long v) : _s(std::to_string(v)) {}
+  String(unsigned long v) : _s(std::to_string(v)) {}
+  String(double v, unsigned decimals = 2)
+  {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.*f", static_cast<int>(decimals), v);
+    _s = buf;
+  }
+
+  const char *c_str() const { return _s.c_str(); }
+  unsigned length() const { return _s.length(); }
+  bool isEmpty() const { return _s.empty(); }
+
+  String &operator+=(const String &s) { _s += s._s; return *this; }
+  String &operator+=(const char *s) { _s += s; return *this; }
+  String &operator+=(char c) { _s += c; return *this; }
+  friend String operator+(const String &a, const String &b)
+  {
+    String sum(a);
+    return sum += b;
+  }
+  bool operator==(const String &s) const { return _s == s._s; }
+
+private:
+  std::string _s;
+};
+
+class Print
+{
+public:
+  virtual ~Print() {}
+  virtual size_t write(uint8_t c) = 0;
+  virtual size_t write(const uint8_t *buffer, size_t size)
+  {
+    size_t n = 0;
+    while (size--)
+    {
+      n += write(*buffer++);
+    }
+    return n;
+  }
+  size_t write(const char *str)
+  {
+    return write(reinterpret_cast<const uint8_t *>(str), strlen(str));
+  }
+  size_t print(const char *s) { return write(s); }
+  size_t print(const String &s) { return write(s.c_str()); }
+};
+
+class Stream
+{
+public:
+  virtual ~Stream() {}
+  virtual int available() = 0;
+  virtual int read() = 0;
+  virtual int peek() = 0;
+  virtual size_t readBytes(char *buffer, size_t length)
+  {
+    size_t n = 0;
+    int c;
+    while (n < length && (c = read()) >= 0)
+    {
+      buffer[n++] = static_cast<char>(c);
+    }
+    return n;
+  }
+  void setTimeout(unsigned long timeout) {}
+};
+
+/*
+ * Prints to stdout, unless muted (e.g. while a benchmark repeats a decoder
+ * that prints its timing).
+ */
+class HardwareSerial
+{
+public:
+  void print(const String &s)
+  {
+    if (!muted)
+    {
+      fputs(s.c_str(), stdout);
+    }
+  }
+  void println(const String &s = String())
+  {
+    print(s);
+    print("\n");
+  }
+
+  bool muted = false;
+};
+
+inline HardwareSerial Serial;
+
+// FreeRTOS, tasks run on threads
+typedef int BaseType_t;
+#define pdPASS 1
+#define pdFAIL 0
+#define portMAX_DELAY 0xFFFFFFFF
+
+struct MockSemaphore
+{
+  std::mutex m;
+  std::condition_variable cv;
+  int count;
+};
+typedef MockSemaphore *SemaphoreHandle_t;
+
+inline SemaphoreHandle_t xSemaphoreCreateMutex()
+{
+  SemaphoreHandle_t s = new MockSemaphore;
+  s->count = 1;
+  return s;
+}
+inline SemaphoreHandle_t xSemaphoreCreateBinary()
+{
+  SemaphoreHandle_t s = new MockSemaphore;
+  s->count = 0;
+  return s;
+}
+inline void vSemaphoreDelete(SemaphoreHandle_t s) { delete s; }
+inline int xSemaphoreTake(SemaphoreHandle_t s, uint32_t ticks)
+{
+  std::unique_lock<std::mutex> lock(s->m);
+  s->cv.wait(lock, [s] { return s->count > 0; });
+  --s->count;
+  return pdPASS;
+}
+inline int xSemaphoreGive(SemaphoreHandle_t s)
+{
+  std::lock_guard<std::mutex> lock(s->m);
+  s->count = 1;
+  s->cv.notify_one();
+  return pdPASS;
+}
+
+struct MockTask {};
+typedef MockTask *TaskHandle_t;
+// thrown by vTaskDelete(NULL) to end the thread of the calling task
+struct MockTaskDeleted {};
+
+inline TaskHandle_t &mockCurrentTask()
+{
+  static thread_local TaskHandle_t current = NULL;
+  return current;
+}
+inline TaskHandle_t xTaskGetCurrentTaskHandle() { return mockCurrentTask(); }
+inline BaseType_t xPortGetCoreID() { return 1; }
+inline void vTaskDelete(TaskHandle_t task)
+{
+  if (task == NULL)
+  {
+    throw MockTaskDeleted();
+  }
+}
+inline BaseType_t xTaskCreatePinnedToCore(void (*fn)(void *), const char *name,
+                                          uint32_t stack, void *param,
+                                          int priority, TaskHandle_t *handle,
+                                          BaseType_t core)
+{
+  TaskHandle_t task = new MockTask;
+  if (handle != NULL)
+  {
+    *handle = task;
+  }
+  std::thread([=] {
+    mockCurrentTask() = task;
+    try
+    {
+      fn(param);
+    }
+    catch (MockTaskDeleted &) {}
+    delete task;
+  }).detach();
+  return pdPASS;
+}
+
+inline void delay(unsigned long ms)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+// esp_heap_caps.h
+#define MALLOC_CAP_DEFAULT (1 << 12)
+inline size_t heap_caps_get_free_size(uint32_t caps) { return 160 * 1024; }
+inline size_t heap_caps_get_total_size(uint32_t caps) { return 320 * 1024; }
+
+#endif
@@ -0,0 +1,30 @@
+/* Host stand-in for esp_timer.h, for the tests of esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __MOCK_ESP_TIMER_H__
+#define __MOCK_ESP_TIMER_H__
+
+#include <cstdint>
+#include <Arduino.h>
+
+// microseconds since the first call, like micros() but never wrapping
+inline int64_t esp_timer_get_time()
+{
+  return micros();
+}
+
+#endif
@@ -0,0 +1,65 @@
+/* Fixture stream for the tests of esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef __FIXTURE_STREAM_H__
+#define __FIXTURE_STREAM_H__
+
+#include <algorithm>
+#include <cstring>
+#include <Arduino.h>
+
+/*
+ * Stream over a response held in memory. At most chunk bytes are available at
+ * once, as when a response arrives over the network.
+ */
+class FixtureStream : public Stream
+{
+public:
+  FixtureStream(const char *data, size_t len, size_t chunk = 1436)
+    : _data(data), _len(len), _pos(0), _chunk(chunk) {}
+
+  int available() override
+  {
+    return static_cast<int>(std::min(_len - _pos, _chunk));
+  }
+
+  int read() override
+  {
+    return _pos < _len ? static_cast<uint8_t>(_data[_pos++]) : -1;
+  }
+
+  int peek() override
+  {
+    return _pos < _len ? static_cast<uint8_t>(_data[_pos]) : -1;
+  }
+
+  size_t readBytes(char *buffer, size_t length) override
+  {
+    const size_t n = std::min(length, _len - _pos);
+    memcpy(buffer, _data + _pos, n);
+    _pos += n;
+    return n;
+  }
+
+private:
+  const char *_data;
+  size_t _len;
+  size_t _pos;
+  size_t _chunk;
+};
+
+#endif
@@ -0,0 +1,229 @@
+/* Clock model tests for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstdint>
+#include <cstdlib>
+#include <unity.h>
+
+#include "clock_model.h"
+
+// defaults of NTP_SYNC_INTERVAL and NTP_MAX_PREDICTED_ERROR in config.cpp
+static const int SYNC_INTERVAL = 12;
+static const int64_t MAX_ERROR_US = 2000 * 1000LL;
+
+static const int64_t MINUTE_US = 60 * 1000000LL;
+static const int64_t HOUR_US = 60 * MINUTE_US;
+
+/*
+ * Simulated RTC that gains ppm parts per million on the true time, synchronized
+ * and corrected the way beginTimeSync() and finishTimeSync() do on each wake.
+ */
+typedef struct sim_clock
+{
+  int64_t trueUs;
+  int64_t clockUs;
+  double  ppm;
+  int     syncs;
+} sim_clock_t;
+
+static clock_model_t model;
+static sim_clock_t sim;
+
+static void sleepFor(int64_t us)
+{
+  sim.trueUs  += us;
+  sim.clockUs += us + static_cast<int64_t>(us * sim.ppm / 1e6);
+}
+
+// Returns true if the wake synchronized the clock.
+static bool wake(int syncInterval = SYNC_INTERVAL,
+                 int64_t maxErrorUs = MAX_ERROR_US)
+{
+  if (clockModelNeedsSync(model, sim.clockUs, syncInterval, maxErrorUs))
+  { // NTP sets the clock to the true time
+    clockModelSynced(model, sim.clockUs, sim.trueUs);
+    sim.clockUs = sim.trueUs;
+    ++sim.syncs;
+    return true;
+  }
+  const int64_t correctionUs = clockModelCorrectionUs(model, sim.clockUs);
+  sim.clockUs += correctionUs;
+  model.correctionUs += correctionUs;
+  ++model.wakesSinceSync;
+  return false;
+}
+
+static int64_t errorMs()
+{
+  return (sim.clockUs - sim.trueUs) / 1000;
+}
+
+void setUp()
+{
+  clockModelReset(model);
+  sim.trueUs  = 1735689600LL * 1000000LL; // 2025-01-01
+  sim.clockUs = sim.trueUs;
+  sim.ppm     = 0;
+  sim.syncs   = 0;
+}
+
+void tearDown() {}
+
+void test_first_wake_syncs()
+{
+  TEST_ASSERT_FALSE(clockModelValid(model));
+  TEST_ASSERT_TRUE(clockModelNeedsSync(model, sim.clockUs, SYNC_INTERVAL,
+                                       MAX_ERROR_US));
+  TEST_ASSERT_TRUE(wake());
+  TEST_ASSERT_TRUE(clockModelValid(model));
+}
+
+void test_converges_on_drift()
+{
+  sim.ppm = 120;
+  for (int i = 0; i < 10 * SYNC_INTERVAL; ++i)
+  {
+    wake();
+    sleepFor(30 * MINUTE_US);
+  }
+  TEST_ASSERT_FLOAT_WITHIN(1.f, 120.f, clockModelDriftPpm(model));
+
+  // between synchronizations, the corrected clock follows the true time
+  for (int i = 0; i < SYNC_INTERVAL - 1; ++i)
+  {
+    if (!wake())
+    {
+      TEST_ASSERT_INT_WITHIN(5, 0, errorMs());
+    }
+    sleepFor(30 * MINUTE_US);
+  }
+}
+
+void test_converges_on_slow_clock()
+{
+  sim.ppm = -45;
+  for (int i = 0; i < 10 * SYNC_INTERVAL; ++i)
+  {
+    wake();
+    sleepFor(30 * MINUTE_US);
+  }
+  TEST_ASSERT_FLOAT_WITHIN(1.f, -45.f, clockModelDriftPpm(model));
+}
+
+void test_syncs_every_interval()
+{
+  sim.ppm = 80;
+  for (int i = 0; i < 4 * SYNC_INTERVAL; ++i)
+  {
+    wake(SYNC_INTERVAL, INT64_MAX);
+    sleepFor(30 * MINUTE_US);
+  }
+  TEST_ASSERT_EQUAL_INT(4, sim.syncs);
+}
+
+void test_predicted_error_forces_sync()
+{
+  sim.ppm = 200;
+  TEST_ASSERT_TRUE(wake());
+  // nothing measured yet, the drift is only known to DEFAULT_DRIFT_PPM
+  // (1500 ppm), so the predicted error passes MAX_ERROR_US after
+  // MAX_ERROR_US / 1500e-6 = 1333 s
+  const int64_t crossingUs = MAX_ERROR_US * 1000000LL / 1500;
+  const int64_t syncUs = sim.trueUs;
+  TEST_ASSERT_FALSE(clockModelNeedsSync(model, syncUs + crossingUs - MINUTE_US,
+                                        1000, MAX_ERROR_US));
+  TEST_ASSERT_TRUE(clockModelNeedsSync(model, syncUs + crossingUs + MINUTE_US,
+                                       1000, MAX_ERROR_US));
+
+  // once the drift is learned, its uncertainty settles on the minimum (20 ppm),
+  // and a sync is only needed after MAX_ERROR_US / 20e-6 = 27.8 h
+  for (int i = 0; i < 20; ++i)
+  {
+    sleepFor(6 * HOUR_US);
+    clockModelSynced(model, sim.clockUs, sim.trueUs);
+    sim.clockUs = sim.trueUs;
+  }
+  TEST_ASSERT_TRUE(clockModelPredictedErrorUs(model, sim.clockUs + 27 * HOUR_US)
+                   <= MAX_ERROR_US);
+  TEST_ASSERT_TRUE(clockModelPredictedErrorUs(model, sim.clockUs + 28 * HOUR_US)
+                   > MAX_ERROR_US);
+  TEST_ASSERT_FALSE(clockModelNeedsSync(model, sim.clockUs + 27 * HOUR_US,
+                                        1000, MAX_ERROR_US));
+  TEST_ASSERT_TRUE(clockModelNeedsSync(model, sim.clockUs + 28 * HOUR_US,
+                                       1000, MAX_ERROR_US));
+}
+
+void test_time_jump_forces_sync_without_learning_it()
+{
+  sim.ppm = 120;
+  for (int i = 0; i < 4 * SYNC_INTERVAL; ++i)
+  {
+    wake();
+    sleepFor(30 * MINUTE_US);
+  }
+  const float learnedPpm = clockModelDriftPpm(model);
+  const uint16_t samples = model.samples;
+
+  // the clock goes back before the last synchronization
+  sim.clockUs -= 24 * HOUR_US;
+  TEST_ASSERT_TRUE(wake());
+  // the jump is not taken for drift
+  TEST_ASSERT_EQUAL_INT(samples, model.samples);
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, learnedPpm, clockModelDriftPpm(model));
+  TEST_ASSERT_INT_WITHIN(0, 0, errorMs());
+}
+
+void test_reset_forgets_drift()
+{
+  sim.ppm = 120;
+  for (int i = 0; i < 4 * SYNC_INTERVAL; ++i)
+  {
+    wake();
+    sleepFor(30 * MINUTE_US);
+  }
+  clockModelReset(model);
+  TEST_ASSERT_FALSE(clockModelValid(model));
+  TEST_ASSERT_EQUAL_INT(0, clockModelCorrectionUs(model, sim.clockUs));
+  TEST_ASSERT_FLOAT_WITHIN(0.01f, 1500.f, clockModelDriftPpm(model));
+  TEST_ASSERT_TRUE(wake());
+}
+
+void test_parse_http_date()
+{
+  int64_t epochS = 0;
+  TEST_ASSERT_TRUE(parseHttpDate("Sun, 06 Nov 1994 08:49:37 GMT", epochS));
+  TEST_ASSERT_TRUE(epochS == 784111777);
+  TEST_ASSERT_TRUE(parseHttpDate("Thu, 29 Feb 2024 23:59:60 GMT", epochS));
+  TEST_ASSERT_TRUE(epochS == 1709251200);
+  TEST_ASSERT_FALSE(parseHttpDate("Sun, 06 Nov 1994 08:49:37 UTC", epochS));
+  TEST_ASSERT_FALSE(parseHttpDate("Sun, 06 Foo 1994 08:49:37 GMT", epochS));
+  TEST_ASSERT_FALSE(parseHttpDate("", epochS));
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_first_wake_syncs);
+  RUN_TEST(test_converges_on_drift);
+  RUN_TEST(test_converges_on_slow_clock);
+  RUN_TEST(test_syncs_every_interval);
+  RUN_TEST(test_predicted_error_forces_sync);
+  RUN_TEST(test_time_jump_forces_sync_without_learning_it);
+  RUN_TEST(test_reset_forgets_drift);
+  RUN_TEST(test_parse_http_date);
+  return UNITY_END();
+}
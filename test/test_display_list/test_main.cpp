@@ -0,0 +1,345 @@
+/* Display list tests for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Draws the same frame straight on a frame buffer, as the renderer drew on the
+ * display before the display list, and recorded on a DisplayList then replayed
+ * page by page with replayPage(), as drawFrame() does. Checks both frames are
+ * the same pixel for pixel, whether the pages are bands of rows or of columns
+ * (the rotation of the renderer), and that each page skips the commands that do
+ * not reach it.
+ *
+ * display_list.cpp is linked from src/, see build_src_filter in platformio.ini,
+ * and drawn through the stand-in for Adafruit_GFX of test/mocks, which draws
+ * lines, rounded rectangles and text as the library does.
+ */
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <unity.h>
+
+#include "display_list.h"
+#include "../../lib/esp32-weather-epd-assets/fonts/FreeSans/FreeSans_8pt8b.h"
+#include "../../lib/esp32-weather-epd-assets/fonts/FreeSans/FreeSans_10pt8b.h"
+#include "../../lib/esp32-weather-epd-assets/fonts/FreeSans/FreeSans_26pt8b.h"
+
+#define DISP_WIDTH  800
+#define DISP_HEIGHT 480
+#define GxEPD_BLACK 0x0000
+#define GxEPD_WHITE 0xFFFF
+#define GxEPD_RED   0xF800
+
+/*
+ * A frame of the display, drawn pixel by pixel and clipped to the page being
+ * drawn, as GxEPD2 clips what is drawn to its page buffer.
+ */
+class Frame : public Adafruit_GFX
+{
+public:
+  Frame() : Adafruit_GFX(DISP_WIDTH, DISP_HEIGHT) { setClip(); }
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color) override
+  {
+    if (x >= _x0 && x < _x1 && y >= _y0 && y < _y1
+        && x >= 0 && x < DISP_WIDTH && y >= 0 && y < DISP_HEIGHT)
+    {
+      pixels[y][x] = color;
+    }
+  }
+  // as GxEPD2_BW::drawInvertedBitmap()
+  void drawInvertedBitmap(int16_t x, int16_t y, const uint8_t bitmap[],
+                          int16_t w, int16_t h, uint16_t color)
+  {
+    const int16_t byteWidth = (w + 7) / 8;
+    for (int16_t j = 0; j < h; ++j)
+    {
+      for (int16_t i = 0; i < w; ++i)
+      {
+        if (!(bitmap[j * byteWidth + i / 8] & (0x80 >> (i & 7))))
+        {
+          drawPixel(x + i, y + j, color);
+        }
+      }
+    }
+  }
+  void setClip(int16_t x0 = INT16_MIN, int16_t y0 = INT16_MIN,
+               int16_t x1 = INT16_MAX, int16_t y1 = INT16_MAX)
+  {
+    _x0 = x0;
+    _y0 = y0;
+    _x1 = x1;
+    _y1 = y1;
+  }
+  void clear()
+  {
+    for (int y = 0; y < DISP_HEIGHT; ++y)
+    {
+      for (int x = 0; x < DISP_WIDTH; ++x)
+      {
+        pixels[y][x] = GxEPD_WHITE;
+      }
+    }
+  }
+
+  uint16_t pixels[DISP_HEIGHT][DISP_WIDTH];
+
+private:
+  int16_t _x0, _y0, _x1, _y1;
+};
+
+static Frame expected, frame;
+static DisplayList canvas(DISP_WIDTH, DISP_HEIGHT);
+
+static uint8_t bitmaps[4][96 * 96 / 8];
+
+static uint32_t seed;
+static int rnd(int n)
+{
+  seed = seed * 1664525 + 1013904223;
+  return (seed >> 8) % n;
+}
+
+/* Shades a bar a pixel at a time, as drawAlphaBar() did before the display
+ * list, or records it.
+ */
+static void alphaBar(Frame &gfx, int16_t x0, int16_t y0, int16_t x1,
+                     int16_t y1, uint16_t color)
+{
+  for (int y = y1 - 1; y > y0; y -= 2)
+  {
+    for (int x = x0 + (x0 % 2); x < x1; x += 2)
+    {
+      gfx.drawPixel(x, y, color);
+    }
+  }
+}
+
+static void alphaBar(DisplayList &gfx, int16_t x0, int16_t y0, int16_t x1,
+                     int16_t y1, uint16_t color)
+{
+  gfx.drawAlphaBar(x0, y0, x1, y1, color);
+}
+
+/* Draws a dotted line a pixel at a time, as the graphs did before the display
+ * list, or records it.
+ */
+static void dottedLine(Frame &gfx, int16_t x0, int16_t x1, int16_t y,
+                       int16_t step, uint16_t color)
+{
+  for (int x = x0; x <= x1; x += step)
+  {
+    gfx.drawPixel(x, y, color);
+  }
+}
+
+static void dottedLine(DisplayList &gfx, int16_t x0, int16_t x1, int16_t y,
+                       int16_t step, uint16_t color)
+{
+  gfx.drawDottedHLine(x0, x1, y, step, color);
+}
+
+static void text(Adafruit_GFX &gfx, int16_t x, int16_t y, const GFXfont *font,
+                 uint16_t color, const char *s)
+{
+  gfx.setFont(font);
+  gfx.setTextColor(color);
+  gfx.setCursor(x, y);
+  gfx.print(s);
+}
+
+/* Draws a frame with every kind of command, some across the edges of the
+ * display, then random ones from seed.
+ */
+template <typename GFX>
+static void drawScene(GFX &gfx, uint32_t sceneSeed)
+{
+  gfx.setTextWrap(false);
+  gfx.fillRect(0, 0, DISP_WIDTH, 40, GxEPD_BLACK);
+  gfx.drawFastHLine(10, 45, 780, GxEPD_BLACK);
+  gfx.drawFastVLine(400, 50, 420, GxEPD_RED);
+  gfx.drawLine(10, 470, 390, 60, GxEPD_BLACK);
+  gfx.drawLine(790, 60, 410, 75, GxEPD_RED);
+  gfx.drawLine(-20, 300, 30, 500, GxEPD_BLACK);
+  gfx.drawRoundRect(20, 60, 200, 120, 12, GxEPD_BLACK);
+  gfx.fillRoundRect(240, 60, 140, 90, 30, GxEPD_RED);
+  gfx.fillRoundRect(780, 460, 60, 60, 8, GxEPD_BLACK);
+  gfx.drawPixel(0, 0, GxEPD_WHITE);
+  gfx.drawPixel(799, 479, GxEPD_RED);
+  for (int i = 0; i < 4; ++i)
+  {
+    gfx.drawInvertedBitmap(413 + 97 * i, 101 + 61 * i, bitmaps[i], 96 - i * 17,
+                           96 - i * 11, i == 2 ? GxEPD_RED : GxEPD_BLACK);
+  }
+  gfx.drawInvertedBitmap(-30, 430, bitmaps[0], 96, 96, GxEPD_BLACK);
+  alphaBar(gfx, 21, 300, 61, 470, GxEPD_BLACK);
+  alphaBar(gfx, 70, 301, 110, 470, GxEPD_RED);
+  for (int16_t y = 300; y < 470; y += 34)
+  {
+    dottedLine(gfx, 20, 380, y + (y % 2), 3, GxEPD_BLACK);
+  }
+  text(gfx, 30, 30, &FreeSans_10pt8b, GxEPD_WHITE, "Paris, lundi 6 janvier");
+  text(gfx, 420, 380, &FreeSans_26pt8b, GxEPD_RED, "21.4\xB0" "C");
+  text(gfx, 420, 430, &FreeSans_8pt8b, GxEPD_BLACK,
+       "Jaune mardi\nArroser les plantes");
+  text(gfx, 740, 475, &FreeSans_26pt8b, GxEPD_BLACK, "Wg");
+  text(gfx, -15, 200, &FreeSans_10pt8b, GxEPD_BLACK, "bord");
+
+  seed = sceneSeed;
+  const uint16_t colors[] = {GxEPD_BLACK, GxEPD_WHITE, GxEPD_RED};
+  for (int i = 0; i < 40; ++i)
+  {
+    const int16_t x = rnd(DISP_WIDTH + 80) - 40;
+    const int16_t y = rnd(DISP_HEIGHT + 80) - 40;
+    const int16_t w = 1 + rnd(160), h = 1 + rnd(160);
+    const uint16_t color = colors[rnd(3)];
+    switch (rnd(7))
+    {
+      case 0: gfx.fillRect(x, y, w, h, color); break;
+      case 1: gfx.drawLine(x, y, x + rnd(300) - 150, y + rnd(300) - 150,
+                           color); break;
+      case 2: gfx.drawRoundRect(x, y, w, h, rnd(20), color); break;
+      case 3: gfx.fillRoundRect(x, y, w, h, rnd(20), color); break;
+      case 4: gfx.drawInvertedBitmap(x, y, bitmaps[rnd(4)], 96, 1 + rnd(96),
+                                     color); break;
+      case 5: alphaBar(gfx, x, y, x + w, y + h, color); break;
+      default: text(gfx, x, y, &FreeSans_8pt8b, color, "Pluie 3 mm"); break;
+    }
+  }
+}
+
+/* Replays canvas on frame in pages bands of rows, or of columns, and returns
+ * the number of commands drawn on all of them.
+ */
+static size_t replay(int pages, bool columns)
+{
+  frame.clear();
+  // as initCanvas() sets up the display
+  frame.setTextWrap(false);
+  const int16_t extent = columns ? DISP_WIDTH : DISP_HEIGHT;
+  size_t drawn = 0;
+  for (int page = 0; page < pages; ++page)
+  {
+    const int16_t p0 = extent * page / pages;
+    const int16_t p1 = extent * (page + 1) / pages;
+    size_t pageDrawn;
+    if (columns)
+    {
+      frame.setClip(p0, INT16_MIN, p1, INT16_MAX);
+      pageDrawn = replayPage(frame, canvas, p0, INT16_MIN, p1, INT16_MAX);
+    }
+    else
+    {
+      frame.setClip(INT16_MIN, p0, INT16_MAX, p1);
+      pageDrawn = replayPage(frame, canvas, INT16_MIN, p0, INT16_MAX, p1);
+    }
+    if (pages > 1)
+    {
+      // no command of the frame is on every page
+      TEST_ASSERT_TRUE(pageDrawn < canvas.size());
+    }
+    drawn += pageDrawn;
+  }
+  return drawn;
+}
+
+static void checkSame()
+{
+  for (int y = 0; y < DISP_HEIGHT; ++y)
+  {
+    TEST_ASSERT_EQUAL_MEMORY(expected.pixels[y], frame.pixels[y],
+                             sizeof(frame.pixels[y]));
+  }
+}
+
+void setUp()
+{
+  seed = 12345;
+  for (int i = 0; i < 4; ++i)
+  {
+    for (size_t b = 0; b < sizeof(bitmaps[i]); ++b)
+    {
+      bitmaps[i][b] = rnd(4) ? 0xFF : rnd(256);
+    }
+  }
+  canvas.clear();
+}
+
+void tearDown() {}
+
+void test_replay_matches_direct()
+{
+  for (uint32_t scene = 1; scene <= 5; ++scene)
+  {
+    expected.clear();
+    drawScene(expected, scene);
+    canvas.clear();
+    drawScene(canvas, scene);
+    // the pages of the 3-color and 7-color panels, then bands of a few pixels
+    // that cut through the bounding box of every command
+    for (int pages : {1, 2, 4, 60, 100})
+    {
+      for (bool columns : {false, true})
+      {
+        const size_t drawn = replay(pages, columns);
+        checkSame();
+        if (scene == 1)
+        {
+          printf("%3d pages of %s: %4u of %4u commands drawn per frame\n",
+                 pages, columns ? "columns" : "rows   ",
+                 static_cast<unsigned>(drawn),
+                 static_cast<unsigned>(canvas.size() * pages));
+        }
+      }
+    }
+  }
+}
+
+void test_text_advances_cursor()
+{
+  // text is measured and aligned on the recorder, its cursor must follow
+  const char *s = "Humidite 58 %\nVent 12 km/h";
+  text(expected, 100, 100, &FreeSans_10pt8b, GxEPD_BLACK, s);
+  text(canvas, 100, 100, &FreeSans_10pt8b, GxEPD_BLACK, s);
+  TEST_ASSERT_EQUAL_INT(expected.getCursorX(), canvas.getCursorX());
+  TEST_ASSERT_EQUAL_INT(expected.getCursorY(), canvas.getCursorY());
+  TEST_ASSERT_EQUAL_INT(1, canvas.size());
+}
+
+void test_empty_commands_skipped()
+{
+  canvas.fillRect(10, 10, 0, 5, GxEPD_BLACK);
+  canvas.drawFastHLine(10, 10, -3, GxEPD_BLACK);
+  canvas.drawRoundRect(10, 10, 5, 0, 2, GxEPD_BLACK);
+  canvas.drawInvertedBitmap(10, 10, bitmaps[0], 0, 8, GxEPD_BLACK);
+  // a space is a glyph of one blank pixel, a newline only moves the cursor
+  text(canvas, 10, 10, &FreeSans_8pt8b, GxEPD_BLACK, "\n\r");
+  TEST_ASSERT_EQUAL_INT(0, canvas.size());
+  canvas.drawPixel(3, 4, GxEPD_RED);
+  TEST_ASSERT_EQUAL_INT(1, canvas.size());
+  canvas.clear();
+  TEST_ASSERT_EQUAL_INT(0, canvas.size());
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_replay_matches_direct);
+  RUN_TEST(test_text_advances_cursor);
+  RUN_TEST(test_empty_commands_skipped);
+  return UNITY_END();
+}
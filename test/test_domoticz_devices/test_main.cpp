@@ -0,0 +1,213 @@
+/* Domoticz devices decoder tests for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Decodes getdevices responses with every field Domoticz sends for each
+ * device, with deserialize_Domoticz_API_IDX(), and checks they fit in the JSON
+ * arena. Run with the filters (pio test -e native) and without them
+ * (pio test -e native_unfiltered), where the whole response is stored; the
+ * arena peak of each is printed.
+ *
+ * api_response.cpp and config.cpp are linked from src/, see build_src_filter
+ * in platformio.ini, and built against ArduinoJson with the stand-ins of
+ * test/mocks for the Arduino core.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <unity.h>
+
+#include "api_response.h"
+#include "config.h"
+#include "fixture_stream.h"
+
+/*
+ * One device of the response, the fields that differ between devices.
+ */
+typedef struct fixture_device
+{
+  int idx;
+  const char *type;
+  const char *subType;
+  const char *name;
+  const char *data;
+} fixture_device_t;
+
+// as requested by DOMOTICZ_API_IDX
+static const fixture_device_t DEVICES[] = {
+  { 35, "General",  "Text",   "Poubelles", "Jaune mardi"},
+  {124, "General",  "Text",   "Pancakes",  "Samedi"},
+  {125, "General",  "Text",   "Memo",      "Arroser les plantes"},
+  { 13, "Temp",     "LaCrosse TX3", "Salon", "21.4 C"},
+  { 14, "Humidity", "LaCrosse WS2300", "Salle de bain", "Humidity 58 %"},
+};
+
+/* Returns the record of one device, with the fields Domoticz sends for every
+ * device and those it adds for its type, indented as Domoticz does.
+ */
+static std::string deviceRecord(const fixture_device_t &d, int n)
+{
+  const std::string idx = std::to_string(d.idx);
+  std::string json =
+    "      {\n"
+    "         \"AddjMulti\" : 1.0,\n"
+    "         \"AddjMulti2\" : 1.0,\n"
+    "         \"AddjValue\" : 0.0,\n"
+    "         \"AddjValue2\" : 0.0,\n"
+    "         \"BatteryLevel\" : 255,\n"
+    "         \"CustomImage\" : 0,\n"
+    "         \"Data\" : \"" + std::string(d.data) + "\",\n"
+    "         \"Description\" : \"\",\n"
+    "         \"Favorite\" : 1,\n"
+    "         \"HardwareDisabled\" : false,\n"
+    "         \"HardwareID\" : 3,\n"
+    "         \"HardwareName\" : \"Dummy\",\n"
+    "         \"HardwareType\" : \"Dummy (Does nothing, use for virtual "
+                                 "switches only)\",\n"
+    "         \"HardwareTypeVal\" : 15,\n"
+    "         \"HaveTimeout\" : false,\n"
+    "         \"ID\" : \"" + std::to_string(14000 + n) + "\",\n"
+    "         \"Image\" : \"Light\",\n"
+    "         \"LastUpdate\" : \"2025-01-06 07:" + std::to_string(10 + n)
+                                                 + ":00\",\n"
+    "         \"Name\" : \"" + std::string(d.name) + "\",\n"
+    "         \"Notifications\" : \"false\",\n"
+    "         \"PlanID\" : \"0\",\n"
+    "         \"PlanIDs\" : [ 0 ],\n"
+    "         \"Protected\" : false,\n"
+    "         \"ShowNotifications\" : true,\n"
+    "         \"SignalLevel\" : \"-\",\n"
+    "         \"SubType\" : \"" + std::string(d.subType) + "\",\n"
+    "         \"Timers\" : \"false\",\n"
+    "         \"Type\" : \"" + std::string(d.type) + "\",\n"
+    "         \"TypeImg\" : \"text\",\n"
+    "         \"Unit\" : 1,\n"
+    "         \"Used\" : 1,\n"
+    "         \"XOffset\" : \"0\",\n"
+    "         \"YOffset\" : \"0\",\n";
+  if (strcmp(d.type, "Temp") == 0)
+  {
+    json +=
+      "         \"Temp\" : 21.4,\n"
+      "         \"trend\" : 0,\n";
+  }
+  else if (strcmp(d.type, "Humidity") == 0)
+  {
+    json +=
+      "         \"Humidity\" : 58,\n"
+      "         \"HumidityStatus\" : \"Comfortable\",\n";
+  }
+  json += "         \"idx\" : \"" + idx + "\"\n"
+          "      }";
+  return json;
+}
+
+/* Returns a getdevices response with count devices: those of DEVICES, then
+ * copies of them.
+ */
+static std::string devicesFixture(int count)
+{
+  std::string json =
+    "{\n"
+    "   \"ActTime\" : 1736143260,\n"
+    "   \"AstrTwilightEnd\" : \"18:52\",\n"
+    "   \"AstrTwilightStart\" : \"06:42\",\n"
+    "   \"CivTwilightEnd\" : \"17:45\",\n"
+    "   \"CivTwilightStart\" : \"07:49\",\n"
+    "   \"DayLength\" : \"08:21\",\n"
+    "   \"NautTwilightEnd\" : \"18:19\",\n"
+    "   \"NautTwilightStart\" : \"07:15\",\n"
+    "   \"ServerTime\" : \"2025-01-06 07:01:00\",\n"
+    "   \"SunAtSouth\" : \"12:47\",\n"
+    "   \"Sunrise\" : \"08:36\",\n"
+    "   \"Sunset\" : \"16:57\",\n"
+    "   \"app_version\" : \"2024.7\",\n"
+    "   \"result\" : [\n";
+  const int n = sizeof(DEVICES) / sizeof(DEVICES[0]);
+  for (int i = 0; i < count; ++i)
+  {
+    json += deviceRecord(DEVICES[i % n], i);
+    json += i + 1 < count ? ",\n" : "\n";
+  }
+  json +=
+    "   ],\n"
+    "   \"status\" : \"OK\",\n"
+    "   \"title\" : \"Devices\"\n"
+    "}\n";
+  return json;
+}
+
+/* Decodes a response of count devices into r.
+ */
+static DeserializationError decode(int count, requested_data_t &r)
+{
+  const std::string json = devicesFixture(count);
+  printf("%2d devices, %5u B, JSON_FILTERS %d, JSON_ARENA_SIZE %d:\n", count,
+         static_cast<unsigned>(json.size()), JSON_FILTERS, JSON_ARENA_SIZE);
+  FixtureStream stream(json.data(), json.size());
+  return deserialize_Domoticz_API_IDX(stream, r);
+}
+
+static requested_data_t r;
+
+void setUp()
+{
+  r = {};
+}
+
+void tearDown() {}
+
+void test_decodes_devices()
+{
+  TEST_ASSERT_EQUAL_STRING("Ok", decode(5, r).c_str());
+  TEST_ASSERT_EQUAL_INT(1, r.data[0].icon);
+  TEST_ASSERT_EQUAL_STRING("Poubelles", r.data[0].description.c_str());
+  TEST_ASSERT_EQUAL_STRING("Jaune mardi", r.data[0].value.c_str());
+  TEST_ASSERT_EQUAL_INT(2, r.data[1].icon);
+  // the memo is kept apart, the next device takes its place
+  TEST_ASSERT_EQUAL_STRING("Arroser les plantes", r.memo.c_str());
+  TEST_ASSERT_EQUAL_INT(4, r.data[2].icon);
+  TEST_ASSERT_EQUAL_STRING("21.4 C", r.data[2].value.c_str());
+  TEST_ASSERT_EQUAL_INT(3, r.data[3].icon);
+  TEST_ASSERT_EQUAL_STRING("58 %", r.data[3].value.c_str());
+  TEST_ASSERT_EQUAL_STRING("Memoire", r.data[4].description.c_str());
+}
+
+void test_many_devices_fit()
+{
+  // more devices than are drawn, all stored when unfiltered
+  TEST_ASSERT_EQUAL_STRING("Ok", decode(16, r).c_str());
+  TEST_ASSERT_EQUAL_STRING("Poubelles", r.data[0].description.c_str());
+}
+
+void test_truncated_response()
+{
+  const std::string json = devicesFixture(5);
+  FixtureStream stream(json.data(), json.size() / 2);
+  TEST_ASSERT_EQUAL_STRING("IncompleteInput",
+                           deserialize_Domoticz_API_IDX(stream, r).c_str());
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_decodes_devices);
+  RUN_TEST(test_many_devices_fit);
+  RUN_TEST(test_truncated_response);
+  return UNITY_END();
+}
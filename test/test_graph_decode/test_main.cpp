@@ -0,0 +1,331 @@
+/* Domoticz graph decoder tests and benchmark for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Decodes Domoticz counter graphs with deserialize_Domoticz_API_GRAPH(), which
+ * streams them through JsonPullParser, and with the JsonDocument decoder it
+ * replaced, and checks both store the same r.graph. Then prints how long each
+ * takes and how much memory it uses, for a month and a year of records.
+ *
+ * api_response.cpp, json_pull.cpp and config.cpp are linked from src/, see
+ * build_src_filter in platformio.ini, and built against ArduinoJson with the
+ * stand-ins of test/mocks for the Arduino core.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unity.h>
+
+#include <ArduinoJson.h>
+#include "api_response.h"
+#include "fixture_stream.h"
+#include "json_pull.h"
+
+/*
+ * Heap allocator recording the peak memory of a JsonDocument.
+ */
+class CountingAllocator : public ArduinoJson::Allocator
+{
+public:
+  void *allocate(size_t size) override
+  {
+    uint8_t *block = static_cast<uint8_t *>(malloc(HEADER_SIZE + size));
+    if (block == NULL)
+    {
+      return NULL;
+    }
+    *reinterpret_cast<size_t *>(block) = size;
+    count(size, 0);
+    return block + HEADER_SIZE;
+  }
+
+  void deallocate(void *ptr) override
+  {
+    if (ptr == NULL)
+    {
+      return;
+    }
+    uint8_t *block = static_cast<uint8_t *>(ptr) - HEADER_SIZE;
+    _used -= *reinterpret_cast<size_t *>(block);
+    free(block);
+  }
+
+  void *reallocate(void *ptr, size_t newSize) override
+  {
+    if (ptr == NULL)
+    {
+      return allocate(newSize);
+    }
+    uint8_t *block = static_cast<uint8_t *>(ptr) - HEADER_SIZE;
+    const size_t oldSize = *reinterpret_cast<size_t *>(block);
+    block = static_cast<uint8_t *>(realloc(block, HEADER_SIZE + newSize));
+    if (block == NULL)
+    {
+      return NULL;
+    }
+    *reinterpret_cast<size_t *>(block) = newSize;
+    count(newSize, oldSize);
+    return block + HEADER_SIZE;
+  }
+
+  size_t peak() const
+  {
+    return _peak;
+  }
+
+private:
+  static const size_t HEADER_SIZE = 16;
+
+  void count(size_t added, size_t removed)
+  {
+    _used += added - removed;
+    _peak = std::max(_peak, _used);
+  }
+
+  size_t _used = 0;
+  size_t _peak = 0;
+};
+
+/* Marks every key of keys to be kept by a deserialization filter.
+ */
+template <size_t N>
+static void addFilterKeys(JsonObject filter, const char *(&keys)[N])
+{
+  for (const char *key : keys)
+  {
+    filter[key] = true;
+  }
+}
+
+static const char *GRAPH_RESULT_KEYS[] = {"d", "v1", "v2"};
+static const char *GRAPH_RESULTPREV_KEYS[] = {"v1", "v2"};
+
+/* The decoder deserialize_Domoticz_API_GRAPH() replaced: the filtered response
+ * is deserialized into a JsonDocument, then read. peak is set to the memory
+ * used by the document.
+ */
+static DeserializationError decodeGraphDocument(Stream &json,
+                                                requested_data_t &r,
+                                                size_t &peak)
+{
+  CountingAllocator allocator;
+  JsonDocument filter;
+  addFilterKeys(filter["result"].add<JsonObject>(), GRAPH_RESULT_KEYS);
+  addFilterKeys(filter["resultprev"].add<JsonObject>(), GRAPH_RESULTPREV_KEYS);
+
+  DeserializationError error;
+  {
+    JsonDocument doc(&allocator);
+    error = deserializeJson(doc, json, DeserializationOption::Filter(filter));
+    if (!error)
+    {
+      int i = 0;
+      for (JsonVariant v : doc["result"].as<JsonArray>())
+      {
+        const char *day = v["d"].as<const char *>();
+        r.graph[i].dt[0] = day[8];
+        r.graph[i].dt[1] = day[9];
+        r.graph[i].value = v["v1"].as<float>() + v["v2"].as<float>();
+        if (++i > 32)
+        {
+          break;
+        }
+      }
+      i = 0;
+      for (JsonVariant v : doc["resultprev"].as<JsonArray>())
+      {
+        r.graph[i].prev_value = v["v1"].as<float>() + v["v2"].as<float>();
+        if (++i > 32)
+        {
+          break;
+        }
+      }
+    }
+  }
+  peak = allocator.peak();
+  return error;
+}
+
+/* Appends the records of one period of a counter graph, as Domoticz sends
+ * them: numbers as strings, with counters the decoders skip.
+ */
+static void appendRecords(std::string &json, int records, int year,
+                          unsigned seed)
+{
+  char record[192];
+  for (int i = 0; i < records; ++i)
+  {
+    seed = seed * 1103515245 + 12345;
+    const int v1 = seed >> 16 & 0x3FFF;
+    const int v2 = seed >> 4 & 0x0FFF;
+    snprintf(record, sizeof(record),
+             "%s\n      {\n         \"c1\" : \"%d.%03d\",\n"
+             "         \"c3\" : \"%d.%03d\",\n"
+             "         \"d\" : \"%04d-%02d-%02d\",\n"
+             "         \"v1\" : \"%d.%03d\",\n"
+             "         \"v2\" : \"%d.%03d\"\n      }",
+             i ? "," : "", 123456 + i, v1 % 1000, 654321 + i, v2 % 1000,
+             year, 1 + i / 31 % 12, 1 + i % 31, v1 / 1000, v1 % 1000,
+             v2 / 1000, v2 % 1000);
+    json += record;
+  }
+}
+
+/* Returns a counter graph of records days, and as many of the period before.
+ */
+static std::string graphFixture(int records)
+{
+  std::string json = "{\n   \"result\" : [";
+  appendRecords(json, records, 2025, 1);
+  json += "\n   ],\n   \"resultprev\" : [";
+  appendRecords(json, records, 2024, 2);
+  json += "\n   ],\n   \"status\" : \"OK\",\n"
+          "   \"title\" : \"Graph counter month\"\n}\n";
+  return json;
+}
+
+static requested_data_t pulled, documented;
+
+/* Decodes json both ways, and checks they store the same graph.
+ */
+static void checkSame(const std::string &json)
+{
+  pulled = requested_data_t();
+  documented = requested_data_t();
+  FixtureStream a(json.data(), json.size());
+  FixtureStream b(json.data(), json.size());
+  size_t peak;
+  DeserializationError pullError = deserialize_Domoticz_API_GRAPH(a, pulled);
+  DeserializationError docError = decodeGraphDocument(b, documented, peak);
+  TEST_ASSERT_TRUE(pullError == DeserializationError::Ok);
+  TEST_ASSERT_TRUE(docError == DeserializationError::Ok);
+  for (size_t i = 0; i < sizeof(pulled.graph) / sizeof(pulled.graph[0]); ++i)
+  {
+    TEST_ASSERT_EQUAL_INT(documented.graph[i].value, pulled.graph[i].value);
+    TEST_ASSERT_EQUAL_INT(documented.graph[i].prev_value,
+                          pulled.graph[i].prev_value);
+    TEST_ASSERT_EQUAL_INT(documented.graph[i].dt[0], pulled.graph[i].dt[0]);
+    TEST_ASSERT_EQUAL_INT(documented.graph[i].dt[1], pulled.graph[i].dt[1]);
+  }
+}
+
+void setUp()
+{
+  Serial.muted = false;
+}
+
+void tearDown() {}
+
+void test_week()
+{
+  checkSame(graphFixture(7));
+}
+
+void test_month()
+{
+  checkSame(graphFixture(31));
+}
+
+void test_year()
+{
+  // more records than r.graph holds
+  checkSame(graphFixture(365));
+}
+
+void test_value_types()
+{
+  // numbers, strings, null and missing values, nested values to skip, and
+  // no previous period
+  checkSame("{\"result\":[{\"d\":\"2025-03-01\",\"v1\":12.5,\"v2\":\"0.5\"},"
+            "{\"d\":\"2025-03-02\",\"v1\":null,\"v2\":3,\"x\":{\"y\":[1,{}]}},"
+            "{\"v2\":\"7.25\",\"d\":\"2025-03-03\",\"v1\":\"1e1\"},"
+            "{\"d\":\"2025-03-04\"}],"
+            "\"resultprev\":null,\"status\":\"OK\"}");
+  checkSame("{\"status\":\"OK\",\"result\":[],\"resultprev\":[{\"v1\":\"2\"}]}");
+}
+
+void test_truncated()
+{
+  const std::string json = graphFixture(31);
+  const size_t cuts[] = {0, 1, 20, json.size() / 2, json.size() - 3};
+  for (size_t cut : cuts)
+  {
+    FixtureStream a(json.data(), cut);
+    FixtureStream b(json.data(), cut);
+    size_t peak;
+    TEST_ASSERT_TRUE(deserialize_Domoticz_API_GRAPH(a, pulled)
+                     != DeserializationError::Ok);
+    TEST_ASSERT_TRUE(decodeGraphDocument(b, documented, peak)
+                     != DeserializationError::Ok);
+  }
+}
+
+/* Returns the best time of a few runs of decode, in microseconds.
+ */
+template <typename F>
+static double bestUs(F decode)
+{
+  double best = 1e30;
+  for (int run = 0; run < 200; ++run)
+  {
+    const auto start = std::chrono::steady_clock::now();
+    decode();
+    const auto end = std::chrono::steady_clock::now();
+    best = std::min(best,
+                    std::chrono::duration<double, std::micro>(end - start)
+                    .count());
+  }
+  return best;
+}
+
+void test_benchmark()
+{
+  const int ranges[] = {31, 365};
+  for (int records : ranges)
+  {
+    const std::string json = graphFixture(records);
+    size_t peak = 0;
+    Serial.muted = true;
+    const double pullUs = bestUs([&] {
+      FixtureStream s(json.data(), json.size());
+      deserialize_Domoticz_API_GRAPH(s, pulled);
+    });
+    const double docUs = bestUs([&] {
+      FixtureStream s(json.data(), json.size());
+      decodeGraphDocument(s, documented, peak);
+    });
+    Serial.muted = false;
+    printf("graph of %3d days, %6zu B: JsonPullParser %7.1f us, %3zu B | "
+           "JsonDocument %7.1f us, %6zu B\n",
+           records, json.size(), pullUs, sizeof(JsonPullParser), docUs, peak);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_week);
+  RUN_TEST(test_month);
+  RUN_TEST(test_year);
+  RUN_TEST(test_value_types);
+  RUN_TEST(test_truncated);
+  RUN_TEST(test_benchmark);
+  return UNITY_END();
+}
@@ -0,0 +1,332 @@
+/* Open-Meteo decoder tests and benchmark for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Decodes the same Open-Meteo forecast requested as CSV, with
+ * deserialize_Meteo_CSV(), and as JSON, with deserialize_Meteo_API(), and
+ * checks both store the same values. Then prints the size of each response
+ * and how long each takes to decode.
+ *
+ * api_response.cpp, json_pull.cpp and config.cpp are linked from src/, see
+ * build_src_filter in platformio.ini, and built against ArduinoJson with the
+ * stand-ins of test/mocks for the Arduino core.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <unity.h>
+
+#include "api_response.h"
+#include "fixture_stream.h"
+
+/*
+ * One day of the forecast, the values of the columns requested.
+ */
+typedef struct fixture_day
+{
+  const char *time;
+  int   weather_code;
+  float temperature_2m_max;
+  float temperature_2m_min;
+  int   precipitation_probability_max;
+  float wind_speed_10m_max;
+  float uv_index_max;
+} fixture_day_t;
+
+static const fixture_day_t DAYS[] = {
+  {"2025-01-06", 61,  7.4f,  2.1f, 85, 21.6f, 0.65f},
+  {"2025-01-07",  3,  5.9f, -0.4f, 20, 14.2f, 0.9f},
+  {"2025-01-08", 71,  1.2f, -3.8f, 65, 27.0f, 0.5f},
+  {"2025-01-09",  0, -1.5f, -7.25f, 0,  8.3f, 1.15f},
+  {"2025-01-10", 45,  3.0f, -2.2f, 10,  5.4f, 0.4f},
+  {"2025-01-11", 80, 10.8f,  4.6f, 90, 35.9f, 0.75f},
+  {"2025-01-12", 95, 12.1f,  8.0f, 100, 48.6f, 0.3f},
+  {"2025-01-13",  2,  9.7f,  3.3f,  5, 12.0f, 1.2f},
+};
+
+/* Returns the time of day i, as an ISO 8601 date (the default) or as Unix
+ * time (timeformat=unixtime).
+ */
+static std::string dayTime(int i, bool unixTime)
+{
+  return unixTime ? std::to_string(1736118000 + i * 86400)
+                  : std::string(DAYS[i].time);
+}
+
+/* Returns the forecast of the first days, as Open-Meteo sends it for
+ * format=csv. columns lists the columns in the order of the table, time
+ * always comes first.
+ */
+static std::string csvFixture(int days, bool unixTime,
+                              const std::vector<std::string> &columns)
+{
+  std::string csv =
+    "latitude,longitude,elevation,utc_offset_seconds,timezone,"
+    "timezone_abbreviation\n"
+    "48.86,2.3399997,43.0,3600,Europe/Berlin,GMT+1\n"
+    "\n";
+  char cell[32];
+  for (size_t c = 0; c < columns.size(); ++c)
+  {
+    csv += c ? "," : "";
+    csv += columns[c];
+    csv += columns[c] == "time" ? ""
+         : columns[c] == "weather_code" ? " (wmo code)"
+         : columns[c].compare(0, 11, "temperature") == 0 ? " (\xc2\xb0" "C)"
+         : columns[c] == "precipitation_probability_max" ? " (%)"
+         : columns[c] == "wind_speed_10m_max" ? " (km/h)"
+         : " ()";
+  }
+  csv += "\n";
+  for (int i = 0; i < days; ++i)
+  {
+    const fixture_day_t &d = DAYS[i];
+    for (size_t c = 0; c < columns.size(); ++c)
+    {
+      const std::string &col = columns[c];
+      if (col == "time")
+        snprintf(cell, sizeof(cell), "%s", dayTime(i, unixTime).c_str());
+      else if (col == "weather_code")
+        snprintf(cell, sizeof(cell), "%d", d.weather_code);
+      else if (col == "temperature_2m_max")
+        snprintf(cell, sizeof(cell), "%g", d.temperature_2m_max);
+      else if (col == "temperature_2m_min")
+        snprintf(cell, sizeof(cell), "%g", d.temperature_2m_min);
+      else if (col == "precipitation_probability_max")
+        snprintf(cell, sizeof(cell), "%d", d.precipitation_probability_max);
+      else if (col == "wind_speed_10m_max")
+        snprintf(cell, sizeof(cell), "%g", d.wind_speed_10m_max);
+      else if (col == "uv_index_max")
+        snprintf(cell, sizeof(cell), "%g", d.uv_index_max);
+      else
+        snprintf(cell, sizeof(cell), "%d", i * 7);
+      csv += c ? "," : "";
+      csv += cell;
+    }
+    csv += "\n";
+  }
+  return csv;
+}
+
+/* Appends a daily array of the first days to a JSON response.
+ */
+template <typename F>
+static void appendColumn(std::string &json, const char *key, int days,
+                         F value)
+{
+  json += json.back() == '{' ? "\"" : ",\"";
+  json += key;
+  json += "\":[";
+  for (int i = 0; i < days; ++i)
+  {
+    json += i ? "," : "";
+    json += value(i);
+  }
+  json += "]";
+}
+
+static std::string number(float v)
+{
+  char buf[32];
+  snprintf(buf, sizeof(buf), "%g", v);
+  return buf;
+}
+
+/* Returns the forecast of the first days, as Open-Meteo sends it as JSON.
+ */
+static std::string jsonFixture(int days, bool unixTime)
+{
+  std::string json =
+    "{\"latitude\":48.86,\"longitude\":2.3399997,"
+    "\"generationtime_ms\":0.1360177993774414,\"utc_offset_seconds\":3600,"
+    "\"timezone\":\"Europe/Berlin\",\"timezone_abbreviation\":\"GMT+1\","
+    "\"elevation\":43.0,\"daily_units\":{";
+  json += unixTime ? "\"time\":\"unixtime\"" : "\"time\":\"iso8601\"";
+  json += ",\"weather_code\":\"wmo code\","
+          "\"temperature_2m_max\":\"\xc2\xb0" "C\","
+          "\"temperature_2m_min\":\"\xc2\xb0" "C\","
+          "\"precipitation_probability_max\":\"%\","
+          "\"wind_speed_10m_max\":\"km/h\",\"uv_index_max\":\"\"},"
+          "\"daily\":{";
+  appendColumn(json, "time", days, [&](int i) {
+    return unixTime ? dayTime(i, true) : "\"" + dayTime(i, false) + "\"";
+  });
+  appendColumn(json, "weather_code", days, [](int i) {
+    return std::to_string(DAYS[i].weather_code);
+  });
+  appendColumn(json, "temperature_2m_max", days, [](int i) {
+    return number(DAYS[i].temperature_2m_max);
+  });
+  appendColumn(json, "temperature_2m_min", days, [](int i) {
+    return number(DAYS[i].temperature_2m_min);
+  });
+  appendColumn(json, "precipitation_probability_max", days, [](int i) {
+    return std::to_string(DAYS[i].precipitation_probability_max);
+  });
+  appendColumn(json, "wind_speed_10m_max", days, [](int i) {
+    return number(DAYS[i].wind_speed_10m_max);
+  });
+  appendColumn(json, "uv_index_max", days, [](int i) {
+    return number(DAYS[i].uv_index_max);
+  });
+  json += "}}";
+  return json;
+}
+
+static const std::vector<std::string> COLUMNS = {
+  "time", "weather_code", "temperature_2m_max", "temperature_2m_min",
+  "precipitation_probability_max", "wind_speed_10m_max", "uv_index_max"
+};
+
+static requested_data_t fromCsv, fromJson;
+
+/* Decodes csv and json, and checks they store the same forecast.
+ */
+static void checkSame(const std::string &csv, const std::string &json)
+{
+  fromCsv = requested_data_t();
+  fromJson = requested_data_t();
+  FixtureStream csvStream(csv.data(), csv.size());
+  FixtureStream jsonStream(json.data(), json.size());
+  TEST_ASSERT_TRUE(deserialize_Meteo_CSV(csvStream, fromCsv)
+                   == DeserializationError::Ok);
+  TEST_ASSERT_TRUE(deserialize_Meteo_API(jsonStream, fromJson)
+                   == DeserializationError::Ok);
+
+  const meteo_current_t &a = fromCsv.current, &b = fromJson.current;
+  TEST_ASSERT_TRUE(a.dt == b.dt);
+  TEST_ASSERT_EQUAL_INT(b.weather_code, a.weather_code);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, b.temp_max, a.temp_max);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, b.temp_min, a.temp_min);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, b.pop, a.pop);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, b.wind_speed, a.wind_speed);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, b.uvi, a.uvi);
+  TEST_ASSERT_EQUAL_MEMORY(b.alert, a.alert, sizeof(a.alert));
+  for (int i = 0; i < METEO_NUM_DAILY; ++i)
+  {
+    const meteo_daily_t &c = fromCsv.daily[i], &d = fromJson.daily[i];
+    TEST_ASSERT_TRUE(c.dt == d.dt);
+    TEST_ASSERT_EQUAL_INT(d.weather_code, c.weather_code);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, d.temp_max, c.temp_max);
+    TEST_ASSERT_FLOAT_WITHIN(1e-4f, d.temp_min, c.temp_min);
+  }
+}
+
+void setUp()
+{
+  Serial.muted = false;
+}
+
+void tearDown() {}
+
+void test_forecast()
+{
+  checkSame(csvFixture(METEO_NUM_DAILY, false, COLUMNS),
+            jsonFixture(METEO_NUM_DAILY, false));
+  TEST_ASSERT_EQUAL_INT(61, fromCsv.current.weather_code);
+  TEST_ASSERT_FLOAT_WITHIN(1e-4f, -7.25f, fromCsv.daily[2].temp_min);
+}
+
+void test_unix_time()
+{
+  checkSame(csvFixture(METEO_NUM_DAILY, true, COLUMNS),
+            jsonFixture(METEO_NUM_DAILY, true));
+  TEST_ASSERT_TRUE(fromCsv.current.dt == 1736118000);
+}
+
+void test_fewer_days()
+{
+  checkSame(csvFixture(3, false, COLUMNS), jsonFixture(3, false));
+  TEST_ASSERT_TRUE(fromCsv.daily[2].temp_max == 0);
+}
+
+void test_columns_by_name()
+{
+  // reordered, with a column the decoder does not read
+  const std::vector<std::string> columns = {
+    "time", "uv_index_max", "sunrise", "temperature_2m_min", "weather_code",
+    "wind_speed_10m_max", "temperature_2m_max", "precipitation_probability_max"
+  };
+  checkSame(csvFixture(METEO_NUM_DAILY, false, columns),
+            jsonFixture(METEO_NUM_DAILY, false));
+}
+
+void test_invalid()
+{
+  const std::string notCsv = jsonFixture(METEO_NUM_DAILY, false);
+  FixtureStream json(notCsv.data(), notCsv.size());
+  TEST_ASSERT_TRUE(deserialize_Meteo_CSV(json, fromCsv)
+                   != DeserializationError::Ok);
+  FixtureStream empty("", 0);
+  TEST_ASSERT_TRUE(deserialize_Meteo_CSV(empty, fromCsv)
+                   != DeserializationError::Ok);
+  const std::string headerOnly = csvFixture(0, false, COLUMNS);
+  FixtureStream noRows(headerOnly.data(), headerOnly.size());
+  TEST_ASSERT_TRUE(deserialize_Meteo_CSV(noRows, fromCsv)
+                   != DeserializationError::Ok);
+}
+
+/* Returns the best time of a few runs of decode, in microseconds.
+ */
+template <typename F>
+static double bestUs(F decode)
+{
+  double best = 1e30;
+  for (int run = 0; run < 200; ++run)
+  {
+    const auto start = std::chrono::steady_clock::now();
+    decode();
+    const auto end = std::chrono::steady_clock::now();
+    best = std::min(best,
+                    std::chrono::duration<double, std::micro>(end - start)
+                    .count());
+  }
+  return best;
+}
+
+void test_benchmark()
+{
+  const std::string csv = csvFixture(METEO_NUM_DAILY, false, COLUMNS);
+  const std::string json = jsonFixture(METEO_NUM_DAILY, false);
+  Serial.muted = true;
+  const double csvUs = bestUs([&] {
+    FixtureStream s(csv.data(), csv.size());
+    deserialize_Meteo_CSV(s, fromCsv);
+  });
+  const double jsonUs = bestUs([&] {
+    FixtureStream s(json.data(), json.size());
+    deserialize_Meteo_API(s, fromJson);
+  });
+  Serial.muted = false;
+  printf("Open-Meteo, %d days: CSV %4zu B, %6.1f us | "
+         "JSON %4zu B, %6.1f us\n", METEO_NUM_DAILY, csv.size(), csvUs, json.size(), jsonUs);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_forecast);
+  RUN_TEST(test_unix_time);
+  RUN_TEST(test_fewer_days);
+  RUN_TEST(test_columns_by_name);
+  RUN_TEST(test_invalid);
+  RUN_TEST(test_benchmark);
+  return UNITY_END();
+}
@@ -0,0 +1,435 @@
+/* Page buffer tests and fill rate benchmark for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Draws the same rectangles, patterns and bitmaps a byte at a time and a pixel
+ * at a time through PageBuffer::drawPixel(), page by page as the renderer does,
+ * and checks the frames sent to the panel are the same bit for bit. Checks the
+ * bytes drawInvertedBitmap() blits into each plane against ones worked out by
+ * hand, in every rotation. Then prints how fast both fill.
+ *
+ * page_buffer.cpp is built here with the 3-color panel and a stand-in for
+ * GxEPD2 that assembles the pages into a whole frame.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <unity.h>
+
+#define __CONFIG_H__
+#define __RENDERER_H__
+#define DIRECT_PAGE_BUFFER 1
+#define DISP_3C_B
+#define DISP_WIDTH  800
+#define DISP_HEIGHT 480
+#define GxEPD_BLACK 0x0000
+#define GxEPD_WHITE 0xFFFF
+#define GxEPD_RED   0xF800
+
+static const int STRIDE = DISP_WIDTH / 8;
+static uint8_t frame[2][STRIDE * DISP_HEIGHT];
+
+struct MockEpd2
+{
+  static const bool hasPartialUpdate = true;
+  static const bool hasFastPartialUpdate = false;
+
+  void writeImage(const uint8_t *black, const uint8_t *color,
+                  int16_t x, int16_t y, int16_t w, int16_t h)
+  {
+    for (int16_t r = 0; r < h; ++r)
+    {
+      memcpy(frame[0] + (y + r) * STRIDE + x / 8, black + r * (w / 8), w / 8);
+      memcpy(frame[1] + (y + r) * STRIDE + x / 8, color + r * (w / 8), w / 8);
+    }
+  }
+  void refresh(int16_t x, int16_t y, int16_t w, int16_t h) {}
+  void refresh(bool partial) {}
+};
+
+static struct
+{
+  MockEpd2 epd2;
+} display;
+
+#include "../../src/page_buffer.cpp"
+
+static PageBuffer pb;
+
+static const uint8_t PATTERNS[][8] = {
+  {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF},
+  {0xAA, 0x55, 0xAA, 0x55, 0xAA, 0x55, 0xAA, 0x55},
+  {0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01},
+  {0x88, 0x00, 0x22, 0x00, 0x88, 0x00, 0x22, 0x00},
+  {0xF0, 0xE0, 0xC0, 0x80, 0x00, 0x00, 0x00, 0x01},
+  {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00},
+};
+static const int NUM_PATTERNS = sizeof(PATTERNS) / sizeof(PATTERNS[0]);
+static const uint16_t COLORS[] = {GxEPD_BLACK, GxEPD_WHITE, GxEPD_RED};
+
+typedef struct draw_op
+{
+  bool     bitmap;
+  int16_t  x, y, w, h;
+  int      pattern;
+  uint16_t color;
+  uint8_t  bits[300 * 300 / 8 + 300];
+} draw_op_t;
+
+static draw_op_t ops[64];
+static int numOps;
+
+static uint32_t seed;
+static int rnd(int n)
+{
+  seed = seed * 1664525 + 1013904223;
+  return (seed >> 8) % n;
+}
+
+/* Fills with fillPattern(), or the same pixels with drawPixel().
+ */
+static void fill(const draw_op_t &op, bool pixels)
+{
+  const uint8_t *pattern = PATTERNS[op.pattern];
+  if (!pixels)
+  {
+    pb.fillPattern(op.x, op.y, op.w, op.h, pattern, op.color);
+    return;
+  }
+  for (int16_t y = op.y; y < op.y + op.h; ++y)
+  {
+    for (int16_t x = op.x; x < op.x + op.w; ++x)
+    {
+      if (x >= 0 && y >= 0 && (pattern[y & 7] & (0x80 >> (x & 7))))
+      {
+        pb.drawPixel(x, y, op.color);
+      }
+    }
+  }
+}
+
+/* Draws with drawInvertedBitmap(), or the same pixels with drawPixel().
+ */
+static void blit(const draw_op_t &op, bool pixels)
+{
+  if (!pixels)
+  {
+    pb.drawInvertedBitmap(op.x, op.y, op.bits, op.w, op.h, op.color);
+    return;
+  }
+  const int16_t byteWidth = (op.w + 7) / 8;
+  for (int16_t j = 0; j < op.h; ++j)
+  {
+    for (int16_t i = 0; i < op.w; ++i)
+    {
+      if (!(op.bits[j * byteWidth + i / 8] & (0x80 >> (i & 7))))
+      {
+        pb.drawPixel(op.x + i, op.y + j, op.color);
+      }
+    }
+  }
+}
+
+/* Draws ops on every page of the window and sends them to the frame.
+ */
+static void render(int16_t wx, int16_t wy, int16_t ww, int16_t wh,
+                   bool pixels)
+{
+  memset(frame, 0x5A, sizeof(frame));
+  const int pages = pb.setWindow(wx, wy, ww, wh, true);
+  for (int page = 0; page < pages; ++page)
+  {
+    pb.setPage(page);
+    for (int i = 0; i < numOps; ++i)
+    {
+      if (ops[i].bitmap)
+      {
+        blit(ops[i], pixels);
+      }
+      else
+      {
+        fill(ops[i], pixels);
+      }
+    }
+    pb.writePage();
+  }
+}
+
+/* Renders ops both ways and checks the frames match.
+ */
+static void checkSame(int16_t wx, int16_t wy, int16_t ww, int16_t wh)
+{
+  static uint8_t expected[2][STRIDE * DISP_HEIGHT];
+  render(wx, wy, ww, wh, true);
+  memcpy(expected, frame, sizeof(frame));
+  render(wx, wy, ww, wh, false);
+  TEST_ASSERT_EQUAL_MEMORY(expected[0], frame[0], sizeof(frame[0]));
+  TEST_ASSERT_EQUAL_MEMORY(expected[1], frame[1], sizeof(frame[1]));
+}
+
+static void addFill(int16_t x, int16_t y, int16_t w, int16_t h, int pattern,
+                    uint16_t color)
+{
+  draw_op_t &op = ops[numOps++];
+  op.bitmap  = false;
+  op.x       = x;
+  op.y       = y;
+  op.w       = w;
+  op.h       = h;
+  op.pattern = pattern;
+  op.color   = color;
+}
+
+static void addBitmap(int16_t x, int16_t y, int16_t w, int16_t h,
+                      uint16_t color)
+{
+  draw_op_t &op = ops[numOps++];
+  op.bitmap = true;
+  op.x      = x;
+  op.y      = y;
+  op.w      = w;
+  op.h      = h;
+  op.color  = color;
+  for (int i = 0; i < (w + 7) / 8 * h; ++i)
+  {
+    op.bits[i] = rnd(4) ? 0xFF : rnd(256);
+  }
+}
+
+/* Returns the byte of plane (0 black, 1 color) the panel pixel px, py is in,
+ * as sent to the panel.
+ */
+static uint8_t panelByte(int plane, int16_t px, int16_t py)
+{
+  return frame[plane][py * STRIDE + px / 8];
+}
+
+/* Draws a single bitmap with drawInvertedBitmap() on a full window, at the
+ * given rotation.
+ */
+static void blitOnly(uint8_t rotation, int16_t x, int16_t y, int16_t w,
+                     int16_t h, const uint8_t *bits, uint16_t color)
+{
+  pb.setRotation(rotation);
+  numOps = 0;
+  draw_op_t &op = ops[numOps++];
+  op.bitmap = true;
+  op.x      = x;
+  op.y      = y;
+  op.w      = w;
+  op.h      = h;
+  op.color  = color;
+  memcpy(op.bits, bits, (w + 7) / 8 * h);
+  render(0, 0, pb.width(), pb.height(), false);
+}
+
+void setUp()
+{
+  numOps = 0;
+  seed = 12345;
+}
+
+void tearDown() {}
+
+void test_fill_edges()
+{
+  for (uint8_t rotation = 0; rotation < 4; ++rotation)
+  {
+    pb.setRotation(rotation);
+    const int16_t w = pb.width(), h = pb.height();
+    numOps = 0;
+    addFill(0, 0, w, h, 0, GxEPD_RED);
+    addFill(-5, -3, 20, 11, 0, GxEPD_BLACK);
+    addFill(w - 9, h - 4, 30, 30, 1, GxEPD_BLACK);
+    addFill(-100, 10, 50, 10, 0, GxEPD_BLACK);
+    addFill(w, 10, 50, 10, 0, GxEPD_BLACK);
+    addFill(10, h, 50, 10, 0, GxEPD_BLACK);
+    addFill(3, 5, 1, 1, 0, GxEPD_WHITE);
+    addFill(7, 9, 1, 200, 0, GxEPD_WHITE);
+    addFill(11, 13, 200, 1, 2, GxEPD_WHITE);
+    addFill(20, 20, 0, 10, 0, GxEPD_BLACK);
+    addFill(20, 20, 10, -1, 0, GxEPD_BLACK);
+    addFill(1, 2, 7, 7, 3, GxEPD_BLACK);
+    addFill(9, 10, 6, 300, 4, GxEPD_RED);
+    addFill(0, 0, w, h, 5, GxEPD_BLACK);
+    checkSame(0, 0, w, h);
+  }
+}
+
+void test_fill_random()
+{
+  for (uint8_t rotation = 0; rotation < 4; ++rotation)
+  {
+    pb.setRotation(rotation);
+    const int16_t w = pb.width(), h = pb.height();
+    for (int round = 0; round < 20; ++round)
+    {
+      numOps = 0;
+      for (int i = 0; i < 40; ++i)
+      {
+        addFill(rnd(w + 40) - 20, rnd(h + 40) - 20, rnd(w / 2), rnd(h / 2),
+                rnd(NUM_PATTERNS), COLORS[rnd(3)]);
+      }
+      checkSame(0, 0, w, h);
+    }
+  }
+}
+
+void test_fill_partial_window()
+{
+  for (uint8_t rotation = 0; rotation < 4; ++rotation)
+  {
+    pb.setRotation(rotation);
+    const int16_t w = pb.width(), h = pb.height();
+    for (int round = 0; round < 20; ++round)
+    {
+      numOps = 0;
+      for (int i = 0; i < 20; ++i)
+      {
+        addFill(rnd(w) - 10, rnd(h) - 10, rnd(120), rnd(120),
+                rnd(NUM_PATTERNS), COLORS[rnd(3)]);
+      }
+      // windows that do not start or end on a byte of the panel
+      const int16_t wx = rnd(w - 50), wy = rnd(h - 50);
+      checkSame(wx, wy, 1 + rnd(w - wx), 1 + rnd(h - wy));
+    }
+  }
+}
+
+void test_bitmap_random()
+{
+  for (uint8_t rotation = 0; rotation < 4; ++rotation)
+  {
+    pb.setRotation(rotation);
+    const int16_t w = pb.width(), h = pb.height();
+    for (int round = 0; round < 10; ++round)
+    {
+      numOps = 0;
+      for (int i = 0; i < 12; ++i)
+      {
+        // up to 300 pixels, past the longest row blitted a byte at a time
+        const int16_t bw = 1 + rnd(i < 10 ? 64 : 300);
+        const int16_t bh = 1 + rnd(i < 10 ? 64 : 300);
+        addBitmap(rnd(w + bw) - bw, rnd(h + bh) - bh, bw, bh, COLORS[rnd(3)]);
+      }
+      checkSame(0, 0, w, h);
+      const int16_t wx = rnd(w - 50), wy = rnd(h - 50);
+      checkSame(wx, wy, 1 + rnd(w - wx), 1 + rnd(h - wy));
+    }
+  }
+}
+
+void test_bitmap_panel_bytes()
+{
+  // byte-aligned: the bitmap lands as is, black in the black plane
+  const uint8_t aligned[] = {0x0F, 0xF0, 0xAA, 0x55};
+  blitOnly(0, 8, 3, 16, 2, aligned, GxEPD_BLACK);
+  TEST_ASSERT_EQUAL_HEX8(0x0F, panelByte(0, 8, 3));
+  TEST_ASSERT_EQUAL_HEX8(0xF0, panelByte(0, 16, 3));
+  TEST_ASSERT_EQUAL_HEX8(0xAA, panelByte(0, 8, 4));
+  TEST_ASSERT_EQUAL_HEX8(0x55, panelByte(0, 16, 4));
+  TEST_ASSERT_EQUAL_HEX8(0xFF, panelByte(0, 0, 3));
+  TEST_ASSERT_EQUAL_HEX8(0xFF, panelByte(0, 24, 3));
+  TEST_ASSERT_EQUAL_HEX8(0xFF, panelByte(1, 8, 3));
+  // the accent color clears the color plane only
+  blitOnly(0, 8, 3, 16, 2, aligned, GxEPD_RED);
+  TEST_ASSERT_EQUAL_HEX8(0xFF, panelByte(0, 8, 3));
+  TEST_ASSERT_EQUAL_HEX8(0x0F, panelByte(1, 8, 3));
+  TEST_ASSERT_EQUAL_HEX8(0x55, panelByte(1, 16, 4));
+
+  // shifted across two bytes of the panel
+  const uint8_t solid[] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
+  blitOnly(0, 13, 0, 8, 1, solid, GxEPD_BLACK);
+  TEST_ASSERT_EQUAL_HEX8(0xF8, panelByte(0, 8, 0));
+  TEST_ASSERT_EQUAL_HEX8(0x07, panelByte(0, 16, 0));
+  // the padding bits of a row are not drawn
+  blitOnly(0, 0, 0, 5, 1, solid, GxEPD_BLACK);
+  TEST_ASSERT_EQUAL_HEX8(0x07, panelByte(0, 0, 0));
+
+  // clipped at the left and right edges, nothing wraps to the next row
+  blitOnly(0, -4, 0, 8, 1, solid, GxEPD_BLACK);
+  TEST_ASSERT_EQUAL_HEX8(0x0F, panelByte(0, 0, 0));
+  blitOnly(0, DISP_WIDTH - 4, 0, 8, 1, solid, GxEPD_BLACK);
+  TEST_ASSERT_EQUAL_HEX8(0xF0, panelByte(0, DISP_WIDTH - 8, 0));
+  TEST_ASSERT_EQUAL_HEX8(0xFF, panelByte(0, 0, 1));
+
+  // across the two pages of the 3-color panel
+  blitOnly(0, 0, DISP_HEIGHT / 2 - 1, 8, 2, solid, GxEPD_BLACK);
+  TEST_ASSERT_EQUAL_HEX8(0x00, panelByte(0, 0, DISP_HEIGHT / 2 - 1));
+  TEST_ASSERT_EQUAL_HEX8(0x00, panelByte(0, 0, DISP_HEIGHT / 2));
+
+  // rotation 1, of the renderer: a row of the bitmap is a panel column,
+  // x, y is the panel pixel WIDTH - 1 - y, x
+  const uint8_t half[] = {0x0F};
+  blitOnly(1, 16, 0, 8, 1, half, GxEPD_BLACK);
+  TEST_ASSERT_EQUAL_HEX8(0xFE, panelByte(0, DISP_WIDTH - 1, 16));
+  TEST_ASSERT_EQUAL_HEX8(0xFE, panelByte(0, DISP_WIDTH - 1, 19));
+  TEST_ASSERT_EQUAL_HEX8(0xFF, panelByte(0, DISP_WIDTH - 1, 20));
+  // rotation 2, the row is reversed: WIDTH - 1 - x, HEIGHT - 1 - y
+  blitOnly(2, 0, 0, 8, 1, half, GxEPD_BLACK);
+  TEST_ASSERT_EQUAL_HEX8(0xF0, panelByte(0, DISP_WIDTH - 8, DISP_HEIGHT - 1));
+  // rotation 3, a column of the bitmap is a panel row: y, HEIGHT - 1 - x
+  const uint8_t column[] = {0x00, 0x80, 0x00, 0x80, 0x00, 0x80, 0x00, 0x80};
+  blitOnly(3, 0, 8, 1, 8, column, GxEPD_RED);
+  TEST_ASSERT_EQUAL_HEX8(0x55, panelByte(1, 8, DISP_HEIGHT - 1));
+  TEST_ASSERT_EQUAL_HEX8(0xFF, panelByte(0, 8, DISP_HEIGHT - 1));
+}
+
+/* Returns the megapixels per second of drawing ops on every page, the
+ * best of a few runs.
+ */
+static double fillRate(bool pixels)
+{
+  const int16_t w = pb.width(), h = pb.height();
+  double best = 0;
+  for (int run = 0; run < 5; ++run)
+  {
+    const auto start = std::chrono::steady_clock::now();
+    render(0, 0, w, h, pixels);
+    const auto end = std::chrono::steady_clock::now();
+    const double s = std::chrono::duration<double>(end - start).count();
+    best = std::max(best, static_cast<double>(w) * h * 2 / s / 1e6);
+  }
+  return best;
+}
+
+void test_fill_rate()
+{
+  // rotation of the renderer: a full screen, then a checkered one
+  pb.setRotation(1);
+  addFill(0, 0, pb.width(), pb.height(), 0, GxEPD_BLACK);
+  addFill(0, 0, pb.width(), pb.height(), 1, GxEPD_RED);
+  const double pixels = fillRate(true);
+  const double bytes = fillRate(false);
+  printf("fill rate: fillPattern %.0f Mpx/s, drawPixel %.0f Mpx/s (x%.1f)\n",
+         bytes, pixels, bytes / pixels);
+  TEST_ASSERT_TRUE(bytes > pixels);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_fill_edges);
+  RUN_TEST(test_fill_random);
+  RUN_TEST(test_fill_partial_window);
+  RUN_TEST(test_bitmap_random);
+  RUN_TEST(test_bitmap_panel_bytes);
+  RUN_TEST(test_fill_rate);
+  return UNITY_END();
+}
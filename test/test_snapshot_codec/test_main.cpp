@@ -0,0 +1,240 @@
+/* Snapshot encoding tests for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <unity.h>
+
+#include "snapshot_codec.h"
+
+/* Bitwise CRC-32, the same as the esp32's ROM crc32_le().
+ */
+static uint32_t crc32(uint32_t crc, const uint8_t *buf, size_t len)
+{
+  crc = ~crc;
+  while (len--)
+  {
+    crc ^= *buf++;
+    for (int k = 0; k < 8; ++k)
+    {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+static requested_data_t in, out;
+static uint8_t buf[IDX_SNAPSHOT_SIZE + GRAPH_SNAPSHOT_SIZE + METEO_SNAPSHOT_SIZE];
+
+static const size_t SIZE[API_ENDPOINT_COUNT] = {
+  METEO_SNAPSHOT_SIZE, IDX_SNAPSHOT_SIZE, GRAPH_SNAPSHOT_SIZE
+};
+
+/* Rewrites the header of the snapshot in buf, with a matching CRC.
+ */
+static void rewriteHeader(const snapshot_header_t &header)
+{
+  snapshot_header_t h = header;
+  const uint8_t *fields = reinterpret_cast<const uint8_t *>(&h.version);
+  h.crc = crc32(0, fields, sizeof(h) - offsetof(snapshot_header_t, version));
+  h.crc = crc32(h.crc, buf + sizeof(h), h.length);
+  memcpy(buf, &h, sizeof(h));
+}
+
+void setUp()
+{
+  memset(buf, 0xA5, sizeof(buf));
+  in  = requested_data_t();
+  out = requested_data_t();
+
+  in.current.dt = 1735689600;
+  in.current.temp_max = 21.5f;
+  in.current.weather_code = 61;
+  in.current.alert[3] = 7;
+  for (int i = 0; i < METEO_NUM_DAILY; ++i)
+  {
+    in.daily[i].dt = in.current.dt + i * 86400;
+    in.daily[i].temp_min = -3.25f + i;
+    in.daily[i].pop = 0.1f * i;
+  }
+  for (int i = 0; i < 7; ++i)
+  {
+    in.data[i].icon = i - 1;
+    in.data[i].description.assign("Salon");
+    in.data[i].value.assign(i % 2 ? "19.8 \xc2\xb0" "C" : "");
+  }
+  in.data[6].description.assign("a description longer than thirty two bytes");
+  in.memo.assign("Sortir les poubelles\nArroser les plantes");
+  for (int i = 0; i < 35; ++i)
+  {
+    in.graph[i].value = 100 + i;
+    in.graph[i].prev_value = 90 + i;
+    in.graph[i].dt[0] = '0' + i / 10;
+    in.graph[i].dt[1] = '0' + i % 10;
+  }
+}
+
+void tearDown() {}
+
+void test_crc()
+{
+  const uint8_t check[] = "123456789";
+  TEST_ASSERT_EQUAL_HEX32(0xCBF43926, crc32(0, check, 9));
+}
+
+void test_meteo_round_trip()
+{
+  size_t len = encodeSnapshot(API_METEO, in, 1234, buf, SIZE[API_METEO], crc32);
+  TEST_ASSERT_EQUAL_UINT32(METEO_SNAPSHOT_SIZE, len);
+  int64_t fetched = 0;
+  TEST_ASSERT_TRUE(decodeSnapshot(API_METEO, buf, len, out, &fetched, crc32));
+  TEST_ASSERT_TRUE(fetched == 1234);
+  TEST_ASSERT_EQUAL_MEMORY(&in.current, &out.current, sizeof(in.current));
+  TEST_ASSERT_EQUAL_MEMORY(in.daily, out.daily, sizeof(in.daily));
+}
+
+void test_idx_round_trip()
+{
+  size_t len = encodeSnapshot(API_DOMOTICZ_IDX, in, 5678, buf,
+                              SIZE[API_DOMOTICZ_IDX], crc32);
+  TEST_ASSERT_TRUE(len > sizeof(snapshot_header_t));
+  TEST_ASSERT_TRUE(len <= IDX_SNAPSHOT_SIZE);
+  TEST_ASSERT_TRUE(decodeSnapshot(API_DOMOTICZ_IDX, buf, len, out, NULL,
+                                  crc32));
+  for (int i = 0; i < 7; ++i)
+  {
+    TEST_ASSERT_EQUAL_INT(in.data[i].icon, out.data[i].icon);
+    TEST_ASSERT_EQUAL_STRING(in.data[i].description.c_str(),
+                             out.data[i].description.c_str());
+    TEST_ASSERT_EQUAL_STRING(in.data[i].value.c_str(),
+                             out.data[i].value.c_str());
+  }
+  TEST_ASSERT_EQUAL_STRING(in.memo.c_str(), out.memo.c_str());
+}
+
+void test_graph_round_trip()
+{
+  size_t len = encodeSnapshot(API_DOMOTICZ_GRAPH, in, 0, buf,
+                              SIZE[API_DOMOTICZ_GRAPH], crc32);
+  TEST_ASSERT_EQUAL_UINT32(GRAPH_SNAPSHOT_SIZE, len);
+  TEST_ASSERT_TRUE(decodeSnapshot(API_DOMOTICZ_GRAPH, buf, len, out, NULL,
+                                  crc32));
+  TEST_ASSERT_EQUAL_MEMORY(in.graph, out.graph, sizeof(in.graph));
+}
+
+void test_rejects_bad_crc()
+{
+  for (int e = 0; e < API_ENDPOINT_COUNT; ++e)
+  {
+    const api_endpoint_t endpoint = static_cast<api_endpoint_t>(e);
+    size_t len = encodeSnapshot(endpoint, in, 0, buf, SIZE[e], crc32);
+    // a flipped bit in the data, or in the header
+    buf[len - 1] ^= 0x10;
+    TEST_ASSERT_FALSE(decodeSnapshot(endpoint, buf, len, out, NULL, crc32));
+    buf[len - 1] ^= 0x10;
+    buf[offsetof(snapshot_header_t, fetched)] ^= 0x01;
+    TEST_ASSERT_FALSE(decodeSnapshot(endpoint, buf, len, out, NULL, crc32));
+    buf[offsetof(snapshot_header_t, fetched)] ^= 0x01;
+    TEST_ASSERT_TRUE(decodeSnapshot(endpoint, buf, len, out, NULL, crc32));
+  }
+}
+
+void test_rejects_wrong_version()
+{
+  size_t len = encodeSnapshot(API_METEO, in, 0, buf, SIZE[API_METEO], crc32);
+  snapshot_header_t header;
+  memcpy(&header, buf, sizeof(header));
+
+  // nothing kept
+  header.version = 0;
+  rewriteHeader(header);
+  TEST_ASSERT_FALSE(decodeSnapshot(API_METEO, buf, len, out, NULL, crc32));
+  // written by another firmware, with a valid CRC
+  header.version = 2;
+  rewriteHeader(header);
+  TEST_ASSERT_FALSE(decodeSnapshot(API_METEO, buf, len, out, NULL, crc32));
+
+  // zeroed memory
+  memset(buf, 0, len);
+  TEST_ASSERT_FALSE(decodeSnapshot(API_METEO, buf, len, out, NULL, crc32));
+}
+
+void test_rejects_truncated_buffer()
+{
+  for (int e = 0; e < API_ENDPOINT_COUNT; ++e)
+  {
+    const api_endpoint_t endpoint = static_cast<api_endpoint_t>(e);
+    size_t len = encodeSnapshot(endpoint, in, 0, buf, SIZE[e], crc32);
+    TEST_ASSERT_FALSE(decodeSnapshot(endpoint, buf, len - 1, out, NULL, crc32));
+    TEST_ASSERT_FALSE(decodeSnapshot(endpoint, buf, sizeof(snapshot_header_t),
+                                     out, NULL, crc32));
+    TEST_ASSERT_FALSE(decodeSnapshot(endpoint, buf, 3, out, NULL, crc32));
+    TEST_ASSERT_FALSE(decodeSnapshot(endpoint, buf, 0, out, NULL, crc32));
+  }
+}
+
+void test_rejects_length_past_data()
+{
+  // a header claiming more data than was encoded, with a matching CRC
+  size_t len = encodeSnapshot(API_DOMOTICZ_IDX, in, 0, buf,
+                              SIZE[API_DOMOTICZ_IDX], crc32);
+  snapshot_header_t header;
+  memcpy(&header, buf, sizeof(header));
+  header.length += 1;
+  rewriteHeader(header);
+  TEST_ASSERT_FALSE(decodeSnapshot(API_DOMOTICZ_IDX, buf, len + 1, out, NULL,
+                                   crc32));
+}
+
+void test_rejects_other_endpoint()
+{
+  size_t len = encodeSnapshot(API_METEO, in, 0, buf, SIZE[API_METEO], crc32);
+  TEST_ASSERT_FALSE(decodeSnapshot(API_DOMOTICZ_GRAPH, buf, len, out, NULL,
+                                   crc32));
+  TEST_ASSERT_FALSE(decodeSnapshot(API_DOMOTICZ_IDX, buf, len, out, NULL,
+                                   crc32));
+}
+
+void test_encode_does_not_overflow()
+{
+  for (int e = 0; e < API_ENDPOINT_COUNT; ++e)
+  {
+    const api_endpoint_t endpoint = static_cast<api_endpoint_t>(e);
+    size_t len = encodeSnapshot(endpoint, in, 0, buf, SIZE[e], crc32);
+    memset(buf, 0xA5, sizeof(buf));
+    TEST_ASSERT_EQUAL_UINT32(0, encodeSnapshot(endpoint, in, 0, buf, len - 1,
+                                               crc32));
+    TEST_ASSERT_EQUAL_UINT8(0xA5, buf[len - 1]);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_crc);
+  RUN_TEST(test_meteo_round_trip);
+  RUN_TEST(test_idx_round_trip);
+  RUN_TEST(test_graph_round_trip);
+  RUN_TEST(test_rejects_bad_crc);
+  RUN_TEST(test_rejects_wrong_version);
+  RUN_TEST(test_rejects_truncated_buffer);
+  RUN_TEST(test_rejects_length_past_data);
+  RUN_TEST(test_rejects_other_endpoint);
+  RUN_TEST(test_encode_does_not_overflow);
+  return UNITY_END();
+}
@@ -0,0 +1,291 @@
+/* Text metrics and line breaker tests for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Measures text with getTextWidth() and checks it against the bounds
+ * Adafruit_GFX::getTextBounds() gives, then breaks text with nextLine() the way
+ * drawMultiLnString() does and checks the lines. Then prints how long the memo
+ * takes to break.
+ *
+ * text_metrics.cpp is linked from src/, see build_src_filter in platformio.ini,
+ * and measures the FreeSans fonts the renderer draws with.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unity.h>
+
+#include "text_metrics.h"
+#include "../../lib/esp32-weather-epd-assets/fonts/FreeSans/FreeSans_6pt8b.h"
+#include "../../lib/esp32-weather-epd-assets/fonts/FreeSans/FreeSans_8pt8b.h"
+#include "../../lib/esp32-weather-epd-assets/fonts/FreeSans/FreeSans_10pt8b.h"
+#include "../../lib/esp32-weather-epd-assets/fonts/FreeSans/FreeSans_26pt8b.h"
+
+// the built-in 6x8 font is measured as font NULL
+static const GFXfont *const FONTS[] = {
+  &FreeSans_6pt8b, &FreeSans_8pt8b, &FreeSans_10pt8b, &FreeSans_26pt8b, NULL,
+};
+
+// as drawn by drawMultiLnString() in renderer.cpp
+static const char MEMO[] =
+  "Penser a sortir les poubelles jaunes mardi soir.<br>Rendez-vous chez le "
+  "dentiste jeudi a 14h30, ne pas oublier la carte vitale et l'ordonnance."
+  "<br>Arroser les plantes du balcon; appeler le plombier pour la fuite sous "
+  "l'evier de la cuisine avant le week-end prolonge.";
+static const uint16_t MEMO_WIDTH = 220;
+static const int MEMO_LINES = 6;
+
+/* Returns the width getTextBounds() gives for text at x = 0, with text size 1
+ * and no wrapping: the bounds of Adafruit_GFX::charBounds() for each
+ * character.
+ */
+static uint16_t boundsWidth(const GFXfont *font, const std::string &text)
+{
+  int16_t x = 0;
+  int16_t minx = INT16_MAX, maxx = -1;
+  for (unsigned char c : text)
+  {
+    if (c == '\n')
+    {
+      x = 0;
+      continue;
+    }
+    if (c == '\r')
+    {
+      continue;
+    }
+    if (font == NULL)
+    {
+      minx = std::min<int16_t>(minx, x);
+      maxx = std::max<int16_t>(maxx, x + 5);
+      x += 6;
+    }
+    else if (c >= font->first && c <= font->last)
+    {
+      const GFXglyph &g = font->glyph[c - font->first];
+      const int16_t x1 = x + g.xOffset, x2 = x1 + g.width - 1;
+      minx = std::min(minx, x1);
+      maxx = std::max(maxx, x2);
+      x += g.xAdvance;
+    }
+  }
+  return maxx >= minx ? maxx - minx + 1 : 0;
+}
+
+static uint16_t textWidth(const GFXfont *font, const std::string &text)
+{
+  return getTextWidth(font, text.data(), text.size());
+}
+
+/* Breaks text into at most maxLines lines, as drawMultiLnString() does.
+ */
+static std::vector<text_line_t> breakLines(const GFXfont *font,
+                                           const char *text, uint16_t width,
+                                           int maxLines)
+{
+  std::vector<text_line_t> lines;
+  const char *end = text + strlen(text);
+  text_line_t line;
+  while (static_cast<int>(lines.size()) < maxLines
+         && nextLine(font, text, end, width,
+                     static_cast<int>(lines.size()) == maxLines - 1, line))
+  {
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+/* Returns the line as drawn, with its ellipsis.
+ */
+static std::string drawn(const text_line_t &line)
+{
+  return std::string(line.text, line.len) + (line.ellipsis ? "..." : "");
+}
+
+void setUp() {}
+
+void tearDown() {}
+
+void test_width_matches_bounds()
+{
+  srand(3);
+  int mismatches = 0;
+  for (int n = 0; n < 20000; ++n)
+  {
+    std::string s;
+    const int len = rand() % 30;
+    for (int i = 0; i < len; ++i)
+    {
+      s += static_cast<char>(rand() % 4 == 0 ? ' ' : 32 + rand() % 224);
+    }
+    if (rand() % 20 == 0)
+    {
+      s += '\n';
+    }
+    for (const GFXfont *font : FONTS)
+    {
+      mismatches += textWidth(font, s) != boundsWidth(font, s);
+    }
+  }
+  TEST_ASSERT_EQUAL_INT(0, mismatches);
+}
+
+void test_spaces_measured()
+{
+  // spaces have no pixels but still extend the bounds, as in charBounds()
+  for (const char *s : {"", " ", "  ", " a", "a ", "a  b ", "-12.5\xB0"})
+  {
+    for (const GFXfont *font : FONTS)
+    {
+      TEST_ASSERT_EQUAL_UINT16(boundsWidth(font, s), textWidth(font, s));
+    }
+  }
+  TEST_ASSERT_TRUE(textWidth(&FreeSans_8pt8b, " a")
+                   > textWidth(&FreeSans_8pt8b, "a"));
+  TEST_ASSERT_EQUAL_UINT16(0, textWidth(&FreeSans_8pt8b, ""));
+}
+
+void test_fonts_cached()
+{
+  // more fonts than are kept, measured twice over
+  for (int round = 0; round < 2; ++round)
+  {
+    for (const GFXfont *font : FONTS)
+    {
+      TEST_ASSERT_EQUAL_PTR(font, getTextMetrics(font).font);
+      TEST_ASSERT_EQUAL_UINT16(boundsWidth(font, MEMO), textWidth(font, MEMO));
+    }
+  }
+}
+
+void test_breaks_at_br_and_newline()
+{
+  for (const char *text : {"Jaune<br>Mardi", "Jaune\nMardi"})
+  {
+    const std::vector<text_line_t> lines = breakLines(&FreeSans_8pt8b, text,
+                                                      MEMO_WIDTH, 3);
+    TEST_ASSERT_EQUAL_INT(2, lines.size());
+    TEST_ASSERT_EQUAL_STRING("Jaune", drawn(lines[0]).c_str());
+    TEST_ASSERT_EQUAL_STRING("Mardi", drawn(lines[1]).c_str());
+  }
+}
+
+void test_breaks_after_dash()
+{
+  const char *text = "serveur-domoticz";
+  const uint16_t width = textWidth(&FreeSans_8pt8b, "serveur-d");
+  std::vector<text_line_t> lines = breakLines(&FreeSans_8pt8b, text, width, 2);
+  TEST_ASSERT_EQUAL_INT(2, lines.size());
+  TEST_ASSERT_EQUAL_STRING("serveur-", drawn(lines[0]).c_str());
+  TEST_ASSERT_EQUAL_STRING("domoticz", drawn(lines[1]).c_str());
+  // not on the last line, where the word overflows
+  lines = breakLines(&FreeSans_8pt8b, text, width, 1);
+  TEST_ASSERT_EQUAL_INT(1, lines.size());
+  TEST_ASSERT_EQUAL_STRING(text, drawn(lines[0]).c_str());
+  TEST_ASSERT_TRUE(lines[0].width > width);
+}
+
+void test_last_line_ellipsis()
+{
+  const char *text = "Arroser les plantes du balcon";
+  const uint16_t width = textWidth(&FreeSans_8pt8b, "Arroser les plantes");
+  std::vector<text_line_t> lines = breakLines(&FreeSans_8pt8b, text, width, 1);
+  TEST_ASSERT_EQUAL_INT(1, lines.size());
+  TEST_ASSERT_TRUE(lines[0].ellipsis);
+  TEST_ASSERT_EQUAL_STRING("Arroser les...", drawn(lines[0]).c_str());
+  TEST_ASSERT_EQUAL_UINT16(boundsWidth(&FreeSans_8pt8b, drawn(lines[0])),
+                           lines[0].width);
+  // all of it fits, nothing is cut
+  lines = breakLines(&FreeSans_8pt8b, text, MEMO_WIDTH, 1);
+  TEST_ASSERT_FALSE(lines[0].ellipsis);
+  TEST_ASSERT_EQUAL_STRING(text, drawn(lines[0]).c_str());
+}
+
+void test_breaks_memo()
+{
+  const std::vector<text_line_t> lines = breakLines(&FreeSans_8pt8b, MEMO,
+                                                    MEMO_WIDTH, MEMO_LINES);
+  TEST_ASSERT_EQUAL_INT(MEMO_LINES, lines.size());
+  const char *expected = MEMO;
+  for (size_t i = 0; i < lines.size(); ++i)
+  {
+    const text_line_t &line = lines[i];
+    printf("%3u |%s|\n", line.width, drawn(line).c_str());
+    // lines follow each other, less the spaces and breaks between them
+    while (*expected == ' ' || strncmp(expected, "<br>", 4) == 0)
+    {
+      expected += *expected == ' ' ? 1 : 4;
+    }
+    TEST_ASSERT_EQUAL_PTR(expected, line.text);
+    expected = line.text + line.len;
+    // measured as drawn, and filled as far as the next word allows
+    TEST_ASSERT_EQUAL_UINT16(boundsWidth(&FreeSans_8pt8b, drawn(line)),
+                             line.width);
+    TEST_ASSERT_TRUE(line.width <= MEMO_WIDTH);
+    if (i + 1 < lines.size() && *expected == ' ')
+    {
+      const char *word = expected + 1;
+      const size_t wordLen = strcspn(word, " -<");
+      const std::string longer = std::string(line.text, line.len) + " "
+                                 + std::string(word, wordLen);
+      TEST_ASSERT_TRUE(boundsWidth(&FreeSans_8pt8b, longer) > MEMO_WIDTH);
+    }
+  }
+  // the memo does not fit in the lines, the last one is cut
+  TEST_ASSERT_TRUE(lines.back().ellipsis);
+}
+
+void test_break_time()
+{
+  double best = 1e9;
+  size_t numLines = 0;
+  for (int run = 0; run < 2000; ++run)
+  {
+    const auto start = std::chrono::steady_clock::now();
+    const std::vector<text_line_t> lines = breakLines(&FreeSans_8pt8b, MEMO,
+                                                      MEMO_WIDTH, MEMO_LINES);
+    const auto end = std::chrono::steady_clock::now();
+    best = std::min(best,
+                    std::chrono::duration<double, std::micro>(end - start)
+                    .count());
+    numLines = lines.size();
+  }
+  printf("memo of %u characters broken into %u lines in %.2f us\n",
+         static_cast<unsigned>(strlen(MEMO)), static_cast<unsigned>(numLines),
+         best);
+  TEST_ASSERT_TRUE(best < 100);
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_width_matches_bounds);
+  RUN_TEST(test_spaces_measured);
+  RUN_TEST(test_fonts_cached);
+  RUN_TEST(test_breaks_at_br_and_newline);
+  RUN_TEST(test_breaks_after_dash);
+  RUN_TEST(test_last_line_ellipsis);
+  RUN_TEST(test_breaks_memo);
+  RUN_TEST(test_break_time);
+  return UNITY_END();
+}
@@ -0,0 +1,233 @@
+/* Pipelined wake tests and benchmark for esp32-weather-epd.
+ * Copyright (C) 2025  Luke Marzen
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Simulates a wake the way setup() runs it, with delays standing in for WiFi
+ * association, the API requests and the power-up of the panel. The display is
+ * initialized either after the requests, on a background task started before
+ * WiFi as beginDisplayInit() does, or on a background task started once the
+ * content is known to have changed, which only initializes the panel while the
+ * frame is recorded, as beginPanelInit() does. Checks the frame is recorded the
+ * same way and the work is handed over as it should, then prints how long each
+ * sequence keeps the board awake.
+ *
+ * background_task.cpp is linked from src/, with FreeRTOS tasks run on threads
+ * by the stand-ins of test/mocks.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+#include <unity.h>
+
+#include <esp_timer.h>
+#include "background_task.h"
+
+/*
+ * Delays of one simulated wake, in milliseconds.
+ */
+typedef struct wake_delays
+{
+  int wifi;     // association
+  int fetch;    // API requests
+  int panel;    // power-up and initialization of the panel
+  int layout;   // recording of the static layout
+  int frame;    // recording of the rest of the frame
+} wake_delays_t;
+
+// what was recorded, in order, and whether it was recorded by its owner
+static std::vector<int> record;
+static bool handedBackInTask;
+static background_task_t task;
+static wake_delays_t delays;
+
+static const int LAYOUT = 1, FRAME = 2;
+
+typedef enum wake_mode
+{
+  WAKE_SEQUENTIAL, // PIPELINED_DISPLAY_INIT 0
+  WAKE_PIPELINED,  // beginDisplayInit() before WiFi
+  WAKE_DEFERRED,   // beginPanelInit() once the content is known to change
+  WAKE_MODE_COUNT
+} wake_mode_t;
+
+/* Initializes the panel and records the static layout, as displayInitTask()
+ * does.
+ */
+static void initAndLayout(void *arg)
+{
+  delay(delays.panel);
+  handedBackInTask = backgroundTaskHandedBack(task);
+  delay(delays.layout);
+  record.push_back(LAYOUT);
+}
+
+/* Initializes the panel only, as panelInitTask() does.
+ */
+static void initPanel(void *arg)
+{
+  delay(delays.panel);
+  handedBackInTask = backgroundTaskHandedBack(task);
+}
+
+/* Runs a wake in the given mode. waitUs is set to how long the main core
+ * waited for the display.
+ *
+ * Returns the time the wake took, in microseconds.
+ */
+static int64_t wake(wake_mode_t mode, int64_t &waitUs)
+{
+  record.clear();
+  const int64_t start = esp_timer_get_time();
+  bool started = false;
+  if (mode == WAKE_PIPELINED)
+  {
+    started = startBackgroundTask(task, initAndLayout, NULL, "epd_init", 8192);
+    TEST_ASSERT_TRUE(started);
+    TEST_ASSERT_FALSE(backgroundTaskHandedBack(task));
+  }
+  delay(delays.wifi);
+  delay(delays.fetch);
+  if (mode == WAKE_DEFERRED)
+  {
+    started = startBackgroundTask(task, initPanel, NULL, "epd_init", 8192);
+    TEST_ASSERT_TRUE(started);
+    // the layout is recorded by the main core while the panel powers up
+    delay(delays.layout);
+    record.push_back(LAYOUT);
+    delay(delays.frame);
+    record.push_back(FRAME);
+    waitUs = awaitBackgroundTask(task);
+    TEST_ASSERT_TRUE(backgroundTaskHandedBack(task));
+    return esp_timer_get_time() - start;
+  }
+  if (started)
+  {
+    waitUs = awaitBackgroundTask(task);
+  }
+  else
+  {
+    const int64_t initStart = esp_timer_get_time();
+    initAndLayout(NULL);
+    waitUs = esp_timer_get_time() - initStart;
+  }
+  TEST_ASSERT_TRUE(backgroundTaskHandedBack(task));
+  delay(delays.frame);
+  record.push_back(FRAME);
+  return esp_timer_get_time() - start;
+}
+
+void setUp()
+{
+  task = {};
+  delays = {60, 40, 30, 10, 10};
+}
+
+void tearDown() {}
+
+void test_layout_recorded_before_frame()
+{
+  int64_t waitUs;
+  for (int mode = 0; mode < WAKE_MODE_COUNT; ++mode)
+  {
+    wake(static_cast<wake_mode_t>(mode), waitUs);
+    TEST_ASSERT_EQUAL_INT(2, record.size());
+    TEST_ASSERT_EQUAL_INT(LAYOUT, record[0]);
+    TEST_ASSERT_EQUAL_INT(FRAME, record[1]);
+  }
+}
+
+void test_handed_over()
+{
+  int64_t waitUs;
+  wake(WAKE_PIPELINED, waitUs);
+  // the task owns its work while it runs, and the main core once awaited
+  TEST_ASSERT_TRUE(handedBackInTask);
+  TEST_ASSERT_FALSE(backgroundTaskPending(task));
+  TEST_ASSERT_TRUE(task.runUs >= (delays.panel + delays.layout) * 1000);
+  // awaiting again does nothing
+  TEST_ASSERT_EQUAL_INT(0, awaitBackgroundTask(task));
+}
+
+void test_waits_for_slow_panel()
+{
+  // the panel takes longer than WiFi and the requests together
+  delays = {20, 10, 80, 10, 0};
+  int64_t waitUs;
+  const int64_t wakeUs = wake(WAKE_PIPELINED, waitUs);
+  TEST_ASSERT_TRUE(waitUs >= 50 * 1000);
+  TEST_ASSERT_TRUE(wakeUs >= 90 * 1000);
+}
+
+void test_deferred_overlaps_frame()
+{
+  // the panel takes longer than recording the frame
+  delays = {20, 10, 60, 10, 10};
+  int64_t waitUs;
+  const int64_t wakeUs = wake(WAKE_DEFERRED, waitUs);
+  TEST_ASSERT_TRUE(handedBackInTask);
+  TEST_ASSERT_FALSE(backgroundTaskPending(task));
+  TEST_ASSERT_TRUE(waitUs >= 30 * 1000);
+  TEST_ASSERT_TRUE(wakeUs >= 90 * 1000);
+  TEST_ASSERT_TRUE(wakeUs < 110 * 1000);
+}
+
+void test_benchmark()
+{
+  // WiFi, requests, panel, layout, frame: a fast and a slow network, and a
+  // panel slower than the network
+  const wake_delays_t profiles[] = {
+    {150, 100, 60, 15, 20},
+    {600, 400, 60, 15, 20},
+    { 40,  30, 90, 15, 20},
+  };
+  for (const wake_delays_t &d : profiles)
+  {
+    delays = d;
+    int64_t sequentialWaitUs, pipelinedWaitUs, deferredWaitUs;
+    const int64_t sequentialUs = wake(WAKE_SEQUENTIAL, sequentialWaitUs);
+    const int64_t pipelinedUs = wake(WAKE_PIPELINED, pipelinedWaitUs);
+    const int64_t deferredUs = wake(WAKE_DEFERRED, deferredWaitUs);
+    printf("wifi %3d ms, fetch %3d ms, panel %2d ms, layout %2d ms: "
+           "sequential %4ld ms, pipelined %4ld ms (waited %2ld ms), "
+           "deferred %4ld ms (waited %2ld ms)\n",
+           d.wifi, d.fetch, d.panel, d.layout,
+           static_cast<long>(sequentialUs / 1000),
+           static_cast<long>(pipelinedUs / 1000),
+           static_cast<long>(pipelinedWaitUs / 1000),
+           static_cast<long>(deferredUs / 1000),
+           static_cast<long>(deferredWaitUs / 1000));
+    // the display costs the wake only what is left of it once the requests
+    // are done, give or take the scheduling of the threads
+    const int hidden = std::min(d.panel + d.layout, d.wifi + d.fetch);
+    TEST_ASSERT_TRUE(sequentialUs - pipelinedUs > (hidden - 10) * 1000);
+    // deferred, only the recording of the frame hides the panel
+    const int deferredHidden = std::min(d.panel, d.layout + d.frame);
+    TEST_ASSERT_TRUE(sequentialUs - deferredUs > (deferredHidden - 10) * 1000);
+  }
+}
+
+int main(int argc, char **argv)
+{
+  UNITY_BEGIN();
+  RUN_TEST(test_layout_recorded_before_frame);
+  RUN_TEST(test_handed_over);
+  RUN_TEST(test_waits_for_slow_panel);
+  RUN_TEST(test_deferred_overlaps_frame);
+  RUN_TEST(test_benchmark);
+  return UNITY_END();
+}
@@ -0,0 +1,257 @@
+#!/usr/bin/env python3
+# Mock Open-Meteo and Domoticz servers for esp32-weather-epd.
+# Copyright (C) 2025  Luke Marzen
+#
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 3 of the License, or
+# (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+"""Serves the three API requests of a wake with a fixed latency per endpoint,
+to compare CONCURRENT_FETCH 0 and 1 on the same network conditions.
+
+Point the firmware at the machine running it (USE_HTTP, METEO_API_ENDPOINT and
+DOMOTICZ_API_ENDPOINT in config.cpp, DEBUG_LEVEL >= 1), build it once with each
+value of CONCURRENT_FETCH, and compare the "[debug] API requests took" lines:
+
+  sudo ./tools/mock_api_server.py --meteo-ms 800 --idx-ms 300 --graph-ms 500
+
+Open-Meteo is served on --meteo-port (80, as the firmware uses with USE_HTTP)
+and Domoticz on --domoticz-port (8080). Each request is held for the latency of
+its endpoint before the response is sent. Connections are kept alive, as
+DOMOTICZ_KEEP_ALIVE expects, and each request is logged with the time it
+arrived, so overlapping requests show up.
+
+  ./tools/mock_api_server.py --compare
+
+makes the same three requests against the servers from this machine, one after
+another and then all at once, to check the harness itself.
+"""
+
+import argparse
+import gzip
+import json
+import random
+import threading
+import time
+import urllib.parse
+from http.client import HTTPConnection
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+START = time.monotonic()
+NUM_DAYS = 8
+
+# daily Open-Meteo fields and how to make up their values
+METEO_FIELDS = {
+    "weather_code": ("wmo code", lambda r: r.choice([0, 2, 3, 45, 61, 71, 95])),
+    "temperature_2m_max": ("°C", lambda r: round(r.uniform(5, 25), 1)),
+    "temperature_2m_min": ("°C", lambda r: round(r.uniform(-5, 10), 1)),
+    "precipitation_probability_max": ("%", lambda r: r.randrange(0, 101, 5)),
+    "wind_speed_10m_max": ("km/h", lambda r: round(r.uniform(3, 50), 1)),
+    "uv_index_max": ("", lambda r: round(r.uniform(0, 8), 2)),
+}
+
+
+def days():
+    today = time.gmtime(time.time())
+    t0 = time.mktime((today.tm_year, today.tm_mon, today.tm_mday,
+                      0, 0, 0, 0, 0, -1))
+    return [time.strftime("%Y-%m-%d", time.localtime(t0 + i * 86400))
+            for i in range(NUM_DAYS)]
+
+
+def meteo_columns(query):
+    rnd = random.Random(1)
+    names = query.get("daily", [""])[0].split(",")
+    columns = [(n, METEO_FIELDS.get(n, ("", lambda r: 0))) for n in names
+               if n and n != "time"]
+    return [(n, unit, [f(rnd) for _ in range(NUM_DAYS)])
+            for n, (unit, f) in columns]
+
+
+def meteo_json(query):
+    columns = meteo_columns(query)
+    daily = {"time": days()}
+    units = {"time": "iso8601"}
+    for name, unit, values in columns:
+        daily[name] = values
+        units[name] = unit
+    return json.dumps({
+        "latitude": 48.86, "longitude": 2.3399997,
+        "generationtime_ms": random.random(), "utc_offset_seconds": 3600,
+        "timezone": "Europe/Berlin", "timezone_abbreviation": "GMT+1",
+        "elevation": 43.0, "daily_units": units, "daily": daily,
+    }, separators=(",", ":")).encode()
+
+
+def meteo_csv(query):
+    columns = meteo_columns(query)
+    lines = [
+        "latitude,longitude,elevation,utc_offset_seconds,timezone,"
+        "timezone_abbreviation",
+        "48.86,2.3399997,43.0,3600,Europe/Berlin,GMT+1",
+        "",
+        ",".join(["time"] + ["%s (%s)" % (n, u) if u else n
+                             for n, u, _ in columns]),
+    ]
+    for i, day in enumerate(days()):
+        lines.append(",".join([day] + [str(v[i]) for _, _, v in columns]))
+    return ("\n".join(lines) + "\n").encode()
+
+
+def domoticz_devices(query):
+    # every field Domoticz sends for a device, most of which are not read
+    ids = query.get("rid", ["35,124,125,13,14"])[0].split(",")
+    result = []
+    for n, idx in enumerate(ids):
+        result.append({
+            "AddjMulti": 1.0, "AddjMulti2": 1.0, "AddjValue": 0.0,
+            "AddjValue2": 0.0, "BatteryLevel": 255, "CustomImage": 0,
+            "Data": "Device %s value %d" % (idx, 10 + n),
+            "Description": "", "Favorite": 1, "HardwareDisabled": False,
+            "HardwareID": 3, "HardwareName": "Dummy", "HardwareType":
+            "Dummy (Does nothing, use for virtual switches only)",
+            "HardwareTypeVal": 15, "HaveTimeout": False, "ID": "%08X" % n,
+            "LastUpdate": "2025-01-06 08:00:00", "Name": "Device %s" % idx,
+            "Notifications": "false", "PlanID": "0", "PlanIDs": [0],
+            "Protected": False, "ShowNotifications": True, "SignalLevel": "-",
+            "SubType": "Text", "Timers": "false", "Type": "General",
+            "TypeImg": "text", "Unit": 1, "Used": 1, "XOffset": "0",
+            "YOffset": "0", "idx": idx,
+        })
+    return json.dumps({"result": result, "status": "OK",
+                       "title": "Devices"}, indent=3).encode()
+
+
+def domoticz_graph(query):
+    rnd = random.Random(2)
+
+    def period(year):
+        return [{"c1": "%.3f" % rnd.uniform(1e5, 2e5),
+                 "c3": "%.3f" % rnd.uniform(1e5, 2e5),
+                 "d": "%04d-01-%02d" % (year, d + 1),
+                 "v1": "%.3f" % rnd.uniform(0, 10),
+                 "v2": "%.3f" % rnd.uniform(0, 10)} for d in range(31)]
+
+    return json.dumps({"result": period(2025), "resultprev": period(2024),
+                       "status": "OK", "title": "Graph counter month"},
+                      indent=3).encode()
+
+
+class Handler(BaseHTTPRequestHandler):
+    protocol_version = "HTTP/1.1"
+    latency = {}
+
+    def endpoint(self, url, query):
+        if url.path == "/v1/forecast":
+            if query.get("format", [""])[0] == "csv":
+                return "meteo", "text/csv", meteo_csv(query)
+            return "meteo", "application/json", meteo_json(query)
+        if url.path == "/json.htm":
+            param = query.get("param", [""])[0]
+            if param == "getdevices":
+                return "idx", "application/json", domoticz_devices(query)
+            if param == "graph":
+                return "graph", "application/json", domoticz_graph(query)
+        return None, None, None
+
+    def do_GET(self):
+        arrived = time.monotonic()
+        url = urllib.parse.urlsplit(self.path)
+        query = urllib.parse.parse_qs(url.query)
+        name, content_type, body = self.endpoint(url, query)
+        if name is None:
+            self.send_error(404)
+            return
+        time.sleep(self.latency[name] / 1000)
+        gzipped = "gzip" in self.headers.get("Accept-Encoding", "")
+        if gzipped:
+            body = gzip.compress(body)
+        self.send_response(200)
+        self.send_header("Content-Type", content_type)
+        self.send_header("Content-Length", str(len(body)))
+        if gzipped:
+            self.send_header("Content-Encoding", "gzip")
+        self.end_headers()
+        self.wfile.write(body)
+        print("%8.0f ms  %-5s  held %4d ms, %6d B%s" % (
+            (arrived - START) * 1000, name, self.latency[name], len(body),
+            " (gzip)" if gzipped else ""), flush=True)
+
+    def log_message(self, format, *args):
+        pass
+
+
+def fetch(host, port, path, conn=None):
+    conn = conn or HTTPConnection(host, port, timeout=30)
+    conn.request("GET", path)
+    conn.getresponse().read()
+    return conn
+
+
+def compare(args):
+    meteo = ("/v1/forecast?latitude=11&longitude=22&daily="
+             + ",".join(["time"] + list(METEO_FIELDS)))
+    idx = "/json.htm?type=command&param=getdevices&rid=35,124,125,13,14"
+    graph = ("/json.htm?type=command&param=graph&sensor=counter&idx=34"
+             "&range=month")
+
+    start = time.monotonic()
+    fetch(args.host, args.meteo_port, meteo)
+    conn = fetch(args.host, args.domoticz_port, idx)
+    fetch(args.host, args.domoticz_port, graph, conn)
+    sequential = time.monotonic() - start
+
+    start = time.monotonic()
+    threads = [threading.Thread(target=fetch, args=(args.host, port, path))
+               for port, path in ((args.meteo_port, meteo),
+                                  (args.domoticz_port, idx),
+                                  (args.domoticz_port, graph))]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    concurrent = time.monotonic() - start
+
+    print("sequential %4.0f ms, concurrent %4.0f ms" % (sequential * 1000,
+                                                       concurrent * 1000))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split("\n")[0])
+    parser.add_argument("--meteo-ms", type=int, default=800)
+    parser.add_argument("--idx-ms", type=int, default=300)
+    parser.add_argument("--graph-ms", type=int, default=500)
+    parser.add_argument("--meteo-port", type=int, default=80)
+    parser.add_argument("--domoticz-port", type=int, default=8080)
+    parser.add_argument("--host", default="127.0.0.1",
+                        help="server to make the requests to, for --compare")
+    parser.add_argument("--compare", action="store_true",
+                        help="make the requests of a wake both ways")
+    args = parser.parse_args()
+    if args.compare:
+        compare(args)
+        return
+
+    Handler.latency = {"meteo": args.meteo_ms, "idx": args.idx_ms,
+                       "graph": args.graph_ms}
+    servers = [ThreadingHTTPServer(("", port), Handler)
+               for port in (args.meteo_port, args.domoticz_port)]
+    for server in servers[1:]:
+        threading.Thread(target=server.serve_forever, daemon=True).start()
+    print("Open-Meteo on :%d, %d ms | Domoticz on :%d, getdevices %d ms, "
+          "graph %d ms" % (args.meteo_port, args.meteo_ms, args.domoticz_port,
+                           args.idx_ms, args.graph_ms), flush=True)
+    servers[0].serve_forever()
+
+
+if __name__ == "__main__":
+    main()